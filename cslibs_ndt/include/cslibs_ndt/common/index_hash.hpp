@@ -0,0 +1,27 @@
+#ifndef CSLIBS_NDT_COMMON_INDEX_HASH_HPP
+#define CSLIBS_NDT_COMMON_INDEX_HASH_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace cslibs_ndt {
+/**
+ * @brief Spatial hash for grid indices, allows to use std::array<int, Dim>
+ *        as key of std::unordered_map / std::unordered_set.
+ */
+template<std::size_t Dim>
+struct IndexHash
+{
+    inline std::size_t operator () (const std::array<int, Dim> &index) const
+    {
+        static constexpr std::size_t primes[3] = {73856093ul, 19349663ul, 83492791ul};
+
+        std::size_t h = 0;
+        for (std::size_t i = 0 ; i < Dim ; ++i)
+            h ^= static_cast<std::size_t>(index[i]) * primes[i % 3];
+        return h;
+    }
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_INDEX_HASH_HPP
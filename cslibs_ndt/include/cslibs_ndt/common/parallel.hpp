@@ -0,0 +1,31 @@
+#ifndef CSLIBS_NDT_COMMON_PARALLEL_HPP
+#define CSLIBS_NDT_COMMON_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace cslibs_ndt {
+/**
+ * @brief Run fn(begin, end) on chunks of [0, n), the first chunk on the calling thread.
+ *        Threads are only spawned for at least min_per_thread elements each.
+ */
+template <typename Fn>
+inline void parallel(const std::size_t n,
+                     const std::size_t min_per_thread,
+                     const Fn &fn)
+{
+    const std::size_t num_threads = std::max<std::size_t>(1ul, std::min<std::size_t>(std::thread::hardware_concurrency(),
+                                                                                     n / std::max<std::size_t>(1ul, min_per_thread)));
+    const std::size_t chunk_size  = (n + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1 ; t < num_threads ; ++t)
+        threads.emplace_back(fn, std::min(t * chunk_size, n), std::min((t + 1) * chunk_size, n));
+    fn(0ul, std::min(chunk_size, n));
+    for (std::thread &t : threads)
+        t.join();
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_PARALLEL_HPP
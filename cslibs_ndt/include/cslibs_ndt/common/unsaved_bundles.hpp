@@ -0,0 +1,94 @@
+#ifndef CSLIBS_NDT_COMMON_UNSAVED_BUNDLES_HPP
+#define CSLIBS_NDT_COMMON_UNSAVED_BUNDLES_HPP
+
+#include <cslibs_ndt/common/index_hash.hpp>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cslibs_ndt {
+/**
+ * @brief Changed bundles of a map for any number of independent consumers, e.g. a journal and an
+ *        asynchronous saver of the same map.
+ *
+ * Changes are stamped with the current revision. Every consumer keeps the revision returned by its last
+ * call of get() and only receives the bundles changed after it, get() advances the revision so that
+ * later changes are stamped higher. Marking a bundle again within a revision is a single lookup.
+ */
+template <std::size_t Dim>
+class UnsavedBundles
+{
+public:
+    using index_t     = std::array<int, Dim>;
+    using index_set_t = std::unordered_set<index_t, IndexHash<Dim>>;
+
+    inline void mark(const index_t &bi)
+    {
+        uint64_t &r = revisions_[bi];
+        if (r == revision_)
+            return;
+        if (r != 0)
+            remove(bi, r);
+        r = revision_;
+        bundles_[r].insert(bi);
+    }
+
+    inline void erase(const index_t &bi)
+    {
+        const auto it = revisions_.find(bi);
+        if (it == revisions_.end())
+            return;
+        remove(bi, it->second);
+        revisions_.erase(it);
+    }
+
+    /**
+     * @brief Regard all bundles as saved by every consumer, e.g. after loading the map.
+     */
+    inline void clear()
+    {
+        revisions_.clear();
+        bundles_.clear();
+    }
+
+    /**
+     * @brief Bundles changed after the given revision.
+     * @param saved revision returned by the previous call of the consumer, 0 initially
+     * @param bis   changed bundles
+     * @return revision to pass to the next call, once the bundles are saved
+     */
+    inline uint64_t get(const uint64_t saved,
+                        std::vector<index_t> &bis)
+    {
+        bis.clear();
+        for (auto it = bundles_.upper_bound(saved) ; it != bundles_.end() ; ++it)
+            bis.insert(bis.end(), it->second.begin(), it->second.end());
+        return revision_++;
+    }
+
+    inline bool has(const uint64_t saved) const
+    {
+        return !bundles_.empty() && bundles_.rbegin()->first > saved;
+    }
+
+private:
+    uint64_t                                                revision_ = 1;
+    std::unordered_map<index_t, uint64_t, IndexHash<Dim>>   revisions_;
+    std::map<uint64_t, index_set_t>                         bundles_;
+
+    inline void remove(const index_t &bi,
+                       const uint64_t revision)
+    {
+        const auto it = bundles_.find(revision);
+        it->second.erase(bi);
+        if (it->second.empty())
+            bundles_.erase(it);
+    }
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_UNSAVED_BUNDLES_HPP
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace cslibs_ndt {
+namespace matching {
+
+/**
+ * @brief More-Thuente line search (More and Thuente, 1994, following MINPACK-2 dcsrch)
+ *        for phi(stp) = f(x + stp * d), finds a step satisfying the strong Wolfe conditions
+ *        phi(stp) <= phi(0) + ftol * stp * phi'(0) and |phi'(stp)| <= gtol * |phi'(0)|.
+ *        Reverse communication: the caller evaluates phi and phi' at step() and reports them
+ *        by update(), therefore every trial costs exactly one evaluation of the objective.
+ */
+class MoreThuente
+{
+public:
+    enum class Status { SEARCHING, CONVERGED, WARNING };
+
+    inline explicit MoreThuente(const double ftol = 1e-4,
+                                const double gtol = 0.9,
+                                const double xtol = 0.1) :
+        ftol_(ftol),
+        gtol_(gtol),
+        xtol_(xtol)
+    {
+    }
+
+    /**
+     * @brief Start a new search.
+     * @param f0        phi(0)
+     * @param g0        phi'(0), has to be negative
+     * @param stp       initial trial step
+     * @param stpmin    lower bound of the step
+     * @param stpmax    upper bound of the step
+     * @return false if d is not a descent direction
+     */
+    inline bool start(const double f0,
+                      const double g0,
+                      const double stp,
+                      const double stpmin,
+                      const double stpmax)
+    {
+        if (!(g0 < 0.0) || stpmax < stpmin)
+            return false;
+
+        stpmin_ = stpmin;
+        stpmax_ = stpmax;
+        stp_    = std::max(stpmin, std::min(stp, stpmax));
+
+        brackt_ = false;
+        stage_  = 1;
+        finit_  = f0;
+        ginit_  = g0;
+        gtest_  = ftol_ * g0;
+        width_  = stpmax - stpmin;
+        width1_ = 2.0 * width_;
+
+        stx_ = 0.0; fx_ = f0; gx_ = g0;
+        sty_ = 0.0; fy_ = f0; gy_ = g0;
+        stmin_ = 0.0;
+        stmax_ = stp_ + XTRAPU * stp_;
+        return true;
+    }
+
+    /// current trial step
+    inline double step() const
+    {
+        return stp_;
+    }
+
+    /**
+     * @brief Report phi and phi' at step(), on SEARCHING step() holds the next trial.
+     */
+    inline Status update(const double f,
+                         const double g)
+    {
+        const double ftest = finit_ + stp_ * gtest_;
+        if (stage_ == 1 && f <= ftest && g >= 0.0)
+            stage_ = 2;
+
+        if (f <= ftest && std::abs(g) <= gtol_ * (-ginit_))
+            return Status::CONVERGED;
+
+        if ((brackt_ && (stp_ <= stmin_ || stp_ >= stmax_)) ||
+                (brackt_ && stmax_ - stmin_ <= xtol_ * stmax_) ||
+                (stp_ == stpmax_ && f <= ftest && g <= gtest_) ||
+                (stp_ == stpmin_ && (f > ftest || g >= gtest_)))
+            return Status::WARNING;
+
+        // in the first stage a modified function is used as long as no step with sufficient decrease was found
+        if (stage_ == 1 && f <= fx_ && f > ftest) {
+            double fm  = f   - stp_ * gtest_;
+            double fxm = fx_ - stx_ * gtest_;
+            double fym = fy_ - sty_ * gtest_;
+            double gm  = g   - gtest_;
+            double gxm = gx_ - gtest_;
+            double gym = gy_ - gtest_;
+            cstep(stx_, fxm, gxm, sty_, fym, gym, stp_, fm, gm);
+            fx_ = fxm + stx_ * gtest_;
+            fy_ = fym + sty_ * gtest_;
+            gx_ = gxm + gtest_;
+            gy_ = gym + gtest_;
+        } else {
+            double fp = f;
+            double gp = g;
+            cstep(stx_, fx_, gx_, sty_, fy_, gy_, stp_, fp, gp);
+        }
+
+        // enforce a sufficient reduction of the interval of uncertainty
+        if (brackt_) {
+            if (std::abs(sty_ - stx_) >= 0.66 * width1_)
+                stp_ = stx_ + 0.5 * (sty_ - stx_);
+            width1_ = width_;
+            width_  = std::abs(sty_ - stx_);
+        }
+
+        if (brackt_) {
+            stmin_ = std::min(stx_, sty_);
+            stmax_ = std::max(stx_, sty_);
+        } else {
+            stmin_ = stp_ + XTRAPL * (stp_ - stx_);
+            stmax_ = stp_ + XTRAPU * (stp_ - stx_);
+        }
+
+        stp_ = std::max(stpmin_, std::min(stp_, stpmax_));
+        if ((brackt_ && (stp_ <= stmin_ || stp_ >= stmax_)) ||
+                (brackt_ && stmax_ - stmin_ <= xtol_ * stmax_))
+            stp_ = stx_;
+
+        return Status::SEARCHING;
+    }
+
+private:
+    static constexpr double XTRAPL = 1.1;
+    static constexpr double XTRAPU = 4.0;
+
+    const double ftol_;
+    const double gtol_;
+    const double xtol_;
+
+    double stpmin_ = 0.0;
+    double stpmax_ = 0.0;
+    double stp_    = 0.0;
+
+    bool   brackt_ = false;
+    int    stage_  = 1;
+    double finit_  = 0.0;
+    double ginit_  = 0.0;
+    double gtest_  = 0.0;
+    double width_  = 0.0;
+    double width1_ = 0.0;
+
+    double stx_ = 0.0, fx_ = 0.0, gx_ = 0.0;
+    double sty_ = 0.0, fy_ = 0.0, gy_ = 0.0;
+    double stmin_ = 0.0;
+    double stmax_ = 0.0;
+
+    /**
+     * @brief Safeguarded cubic / quadratic step (MINPACK-2 dcstep), updates the interval
+     *        of uncertainty [stx, sty] and computes the next trial step.
+     */
+    inline void cstep(double &stx, double &fx, double &dx,
+                      double &sty, double &fy, double &dy,
+                      double &stp, const double fp, const double dp)
+    {
+        const double stpmin = stmin_;
+        const double stpmax = stmax_;
+        const double sgnd   = dp * (dx / std::abs(dx));
+
+        double stpf;
+        if (fp > fx) {
+            // higher function value, the minimum is bracketed
+            const double theta = 3.0 * (fx - fp) / (stp - stx) + dx + dp;
+            const double s     = std::max(std::abs(theta), std::max(std::abs(dx), std::abs(dp)));
+            double gamma       = s * std::sqrt(std::max(0.0, (theta / s) * (theta / s) - (dx / s) * (dp / s)));
+            if (stp < stx)
+                gamma = -gamma;
+            const double p    = (gamma - dx) + theta;
+            const double q    = ((gamma - dx) + gamma) + dp;
+            const double r    = p / q;
+            const double stpc = stx + r * (stp - stx);
+            const double stpq = stx + ((dx / ((fx - fp) / (stp - stx) + dx)) / 2.0) * (stp - stx);
+            stpf = std::abs(stpc - stx) < std::abs(stpq - stx) ? stpc : stpc + (stpq - stpc) / 2.0;
+            brackt_ = true;
+        } else if (sgnd < 0.0) {
+            // derivatives of opposite sign, the minimum is bracketed
+            const double theta = 3.0 * (fx - fp) / (stp - stx) + dx + dp;
+            const double s     = std::max(std::abs(theta), std::max(std::abs(dx), std::abs(dp)));
+            double gamma       = s * std::sqrt(std::max(0.0, (theta / s) * (theta / s) - (dx / s) * (dp / s)));
+            if (stp > stx)
+                gamma = -gamma;
+            const double p    = (gamma - dp) + theta;
+            const double q    = ((gamma - dp) + gamma) + dx;
+            const double r    = p / q;
+            const double stpc = stp + r * (stx - stp);
+            const double stpq = stp + (dp / (dp - dx)) * (stx - stp);
+            stpf = std::abs(stpc - stp) > std::abs(stpq - stp) ? stpc : stpq;
+            brackt_ = true;
+        } else if (std::abs(dp) < std::abs(dx)) {
+            // derivative decreases in magnitude
+            const double theta = 3.0 * (fx - fp) / (stp - stx) + dx + dp;
+            const double s     = std::max(std::abs(theta), std::max(std::abs(dx), std::abs(dp)));
+            double gamma       = s * std::sqrt(std::max(0.0, (theta / s) * (theta / s) - (dx / s) * (dp / s)));
+            if (stp > stx)
+                gamma = -gamma;
+            const double p = (gamma - dp) + theta;
+            const double q = (gamma + (dx - dp)) + gamma;
+            const double r = p / q;
+            double stpc;
+            if (r < 0.0 && gamma != 0.0)
+                stpc = stp + r * (stx - stp);
+            else
+                stpc = stp > stx ? stpmax : stpmin;
+            const double stpq = stp + (dp / (dp - dx)) * (stx - stp);
+
+            if (brackt_) {
+                stpf = std::abs(stpc - stp) < std::abs(stpq - stp) ? stpc : stpq;
+                stpf = stp > stx ? std::min(stp + 0.66 * (sty - stp), stpf)
+                                 : std::max(stp + 0.66 * (sty - stp), stpf);
+            } else {
+                stpf = std::abs(stpc - stp) > std::abs(stpq - stp) ? stpc : stpq;
+                stpf = std::max(stpmin, std::min(stpf, stpmax));
+            }
+        } else {
+            // derivative does not decrease in magnitude
+            if (brackt_) {
+                const double theta = 3.0 * (fp - fy) / (sty - stp) + dy + dp;
+                const double s     = std::max(std::abs(theta), std::max(std::abs(dy), std::abs(dp)));
+                double gamma       = s * std::sqrt(std::max(0.0, (theta / s) * (theta / s) - (dy / s) * (dp / s)));
+                if (stp > sty)
+                    gamma = -gamma;
+                const double p = (gamma - dp) + theta;
+                const double q = ((gamma - dp) + gamma) + dy;
+                const double r = p / q;
+                stpf = stp + r * (sty - stp);
+            } else {
+                stpf = stp > stx ? stpmax : stpmin;
+            }
+        }
+
+        // update the interval of uncertainty
+        if (fp > fx) {
+            sty = stp;
+            fy  = fp;
+            dy  = dp;
+        } else {
+            if (sgnd < 0.0) {
+                sty = stx;
+                fy  = fx;
+                dy  = dx;
+            }
+            stx = stp;
+            fx  = fp;
+            dx  = dp;
+        }
+        stp = stpf;
+    }
+};
+
+}
+}
@@ -1,18 +1,105 @@
 #pragma once
 
-#include <cslibs_ndt_3d/matching/gridmap_match_traits.hpp>
 #include <cslibs_ndt/matching/match_traits.hpp>
 #include <cslibs_ndt/matching/parameter.hpp>
 #include <cslibs_ndt/matching/result.hpp>
+#include <cslibs_ndt/matching/step_control.hpp>
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/common/parallel.hpp>
+
+#include <Eigen/Eigen>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
 
 namespace cslibs_ndt {
 namespace matching {
 
-template<typename iterator_t, typename ndt_t, typename traits_t = MatchTraits<ndt_t>>
-auto match(const iterator_t& points_begin,
-           const iterator_t& points_end,
+template<typename ndt_t>
+using point_buffer_t = std::vector<typename ndt_t::point_t, Eigen::aligned_allocator<typename ndt_t::point_t>>;
+
+namespace impl {
+/**
+ * @brief Order of the points for subsampling. Points are grouped by the map cell they fall into,
+ *        shuffled within their cell and then drawn round robin over the shuffled cells, therefore
+ *        every prefix of the order is a random sample stratified over space.
+ */
+template<typename ndt_t>
+inline void stratify(const point_buffer_t<ndt_t>& points,
+                     const double resolution,
+                     std::vector<std::size_t>& order)
+{
+    using index_t               = typename ndt_t::index_t;
+    static constexpr std::size_t Dim = std::tuple_size<index_t>::value;
+    using cells_t               = std::unordered_map<index_t, std::vector<std::size_t>, IndexHash<Dim>>;
+
+    const double resolution_inv = 1.0 / resolution;
+    cells_t cells;
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        index_t index;
+        for (std::size_t d = 0; d < Dim; ++d)
+            index[d] = static_cast<int>(std::floor(points[i](d) * resolution_inv));
+        cells[index].emplace_back(i);
+    }
+
+    /// fixed seed, matching the same data twice gives the same result
+    std::mt19937 rng(0u);
+    std::vector<std::vector<std::size_t>*> strata;
+    strata.reserve(cells.size());
+    for (auto& cell : cells)
+    {
+        std::shuffle(cell.second.begin(), cell.second.end(), rng);
+        strata.emplace_back(&cell.second);
+    }
+    std::shuffle(strata.begin(), strata.end(), rng);
+
+    order.clear();
+    order.reserve(points.size());
+    for (std::size_t round = 0; order.size() < points.size(); ++round)
+        for (const std::vector<std::size_t>* stratum : strata)
+            if (round < stratum->size())
+                order.emplace_back((*stratum)[round]);
+}
+
+/**
+ * @brief Per call preparation of the parameters. Traits may provide
+ *        `static parameter_t prepare(map, points_prime, param)` to precompute
+ *        data which only depends on the map and the cloud, e.g. an occupancy mask.
+ */
+template<typename traits_t, typename ndt_t, typename points_t>
+inline auto prepare(const ndt_t& map,
+                    const points_t& points_prime,
+                    const typename traits_t::parameter_t& param,
+                    int)
+-> decltype(traits_t::prepare(map, points_prime, param))
+{
+    return traits_t::prepare(map, points_prime, param);
+}
+
+template<typename traits_t, typename ndt_t, typename points_t>
+inline typename traits_t::parameter_t prepare(const ndt_t&,
+                                              const points_t&,
+                                              const typename traits_t::parameter_t& param,
+                                              long)
+{
+    return param;
+}
+
+/**
+ * @brief Point to distribution matching on points which are already transformed
+ *        by the initial transform, the buffer is owned by the caller and can be reused.
+ */
+template<typename ndt_t, typename traits_t = MatchTraits<ndt_t>>
+auto match(const point_buffer_t<ndt_t>& points_prime,
            const ndt_t& map,
-           const typename traits_t::parameter_t& param,
+           const typename traits_t::parameter_t& parameter,
            const typename ndt_t::transform_t& initial_transform)
 -> Result<typename ndt_t::transform_t>
 {
@@ -29,33 +116,30 @@ auto match(const iterator_t& points_begin,
     using gradient_t    = Eigen::Matrix<double, DIMS, 1>;
     using hessian_t     = Eigen::Matrix<double, DIMS, DIMS>;
 
-    // todo: pre transform points, should be externalized or made completely optional...
-    std::vector<point_t> points_prime;
-    points_prime.reserve(std::distance(points_begin, points_end));
-    std::transform(points_begin, points_end, std::back_inserter(points_prime),
-                   [&](const point_t& point) { return initial_transform * point; });
-
-    // initialize result
-    double max_score        = std::numeric_limits<double>::lowest();
-    std::size_t iteration   = 0;
-
-    linear_t  linear    = linear_t::Zero();
-    angular_t angular   = angular_t::Zero();
+    const typename traits_t::parameter_t param = prepare<traits_t>(map, points_prime, parameter, 0);
 
     // initialize state
-    linear_t  linear_old    = linear_t::Zero();
-    angular_t angular_old   = angular_t::Zero();
-    linear_t  linear_delta  = linear_t::Constant(std::numeric_limits<double>::max());
-    angular_t angular_delta = angular_t::Constant(std::numeric_limits<double>::max());
-
-    double lambda = 1.0;
+    StepControl<DIMS> step(param);
+    std::size_t iteration        = 0;
     std::size_t step_adjustments = 0;
 
+    // subsampling, every iteration evaluates a growing prefix of the stratified order,
+    // a fraction which does not grow would never reach all points
+    const std::size_t size      = points_prime.size();
+    const bool        subsample = param.subsamplingStart() < 1.0 && param.subsamplingGrowth() > 1.0 && size > 0;
+    std::vector<std::size_t> order;
+    if (subsample)
+        stratify<ndt_t>(points_prime, map.getResolution(), order);
+
+    double      fraction = subsample ? param.subsamplingStart() : 1.0;
+    std::size_t active   = 0;
+
     // termination criteria
     const auto test_eps = [&]()
     {
-        return (linear_delta.array().abs() < param.translationEpsilon()).all()
-                && (angular_delta.array().abs() < param.rotationEpsilon()).all();
+        const gradient_t& delta = step.delta();
+        return (delta.template head<traits_t::LINEAR_DIMS>().array().abs() < param.translationEpsilon()).all()
+                && (delta.template tail<traits_t::ANGULAR_DIMS>().array().abs() < param.rotationEpsilon()).all();
     };
 
     const auto test_readjustments = [&]()
@@ -63,11 +147,20 @@ auto match(const iterator_t& points_begin,
         return step_adjustments > 0 && step_adjustments > param.maxStepReadjustments();
     };
 
+    const auto start = std::chrono::steady_clock::now();
+    const auto test_time_budget = [&]()
+    {
+        return param.timeBudget() > 0.0 &&
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= param.timeBudget();
+    };
+
     // termination
-    const auto terminate = [&](Termination reason)
+    const auto terminate = [&](const gradient_t& x, Termination reason)
     {
+        const linear_t  linear  = x.template head<traits_t::LINEAR_DIMS>();
+        const angular_t angular = x.template tail<traits_t::ANGULAR_DIMS>();
         return result_t{
-            max_score,
+            step.bestScore(),
                     iteration,
                     traits_t::makeTransform(linear, angular) * initial_transform,
                     reason };
@@ -77,8 +170,23 @@ auto match(const iterator_t& points_begin,
     for (iteration = 0; iteration < param.maxIterations(); ++iteration)
     {
         if (test_readjustments())
-            return terminate(Termination::MAX_STEP_READJUSTMENTS);
+            return terminate(step.best(), Termination::MAX_STEP_READJUSTMENTS);
+
+        // the best evaluated state so far
+        if (iteration > 0 && test_time_budget())
+            return terminate(step.best(), Termination::TIME_BUDGET);
+
+        // scores of differently sized subsets are not comparable, restart the comparison
+        const std::size_t next_active = std::min(size, std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(fraction * size))));
+        if (next_active != active)
+        {
+            active = next_active;
+            step.reset();
+        }
+        fraction = std::min(1.0, fraction * param.subsamplingGrowth());
 
+        const linear_t  linear  = step.x().template head<traits_t::LINEAR_DIMS>();
+        const angular_t angular = step.x().template tail<traits_t::ANGULAR_DIMS>();
         const auto t = traits_t::makeTransform(linear, angular);
 
         JacobianCompute J;
@@ -91,48 +199,65 @@ auto match(const iterator_t& points_begin,
 
         double score = 0.0;
         // todo: reimplement parallelization
-        for (const point_t& point_prime : points_prime)
+        for (std::size_t i = 0; i < active; ++i)
         {
+            const point_t& point_prime = points_prime[subsample ? order[i] : i];
             const point_t point = t * point_prime;
-            traits_t::computeGradient(map, point, J, H, param, score, g, h);
+            traits_t::computeGradient(map, point_prime, point, J, H, param, score, g, h);
         }
 
-        if (score < max_score)
+        switch (step.update(score, g, h))
         {
-            lambda *= param.alpha();
-            linear = linear_old;
-            angular = angular_old;
+        case StepResult::REJECTED:
             ++step_adjustments;
             continue;
+        case StepResult::SEARCHING:
+            continue;
+        case StepResult::FAILED:
+            // no improvement along the search direction
+            if (active < size)
+            {
+                fraction = 1.0;
+                continue;
+            }
+            return terminate(step.best(), Termination::MAX_STEP_READJUSTMENTS);
+        default:
+            step_adjustments = 0;
+            break;
         }
 
-        if (score > max_score)
+        if (test_eps())
         {
-            max_score = score;
-            lambda = std::max(1.0, lambda / param.alpha());
-            step_adjustments = 0;
+            // converged on a subset, continue on all points
+            if (active < size)
+            {
+                fraction = 1.0;
+                continue;
+            }
+            return terminate(step.solution(), Termination::DELTA_EPSILON);
         }
+    }
 
-        /// limit H
-        // cslibs_math::statistics::LimitEigenValuesByZero<DIMS>::apply(h);
-        gradient_t dp = h.fullPivLu().solve(g);
-        dp *= lambda;
-
-        linear_old = linear;
-        angular_old = angular;
-
-        linear_delta = dp.template head<traits_t::LINEAR_DIMS>();
-        linear += linear_delta;
+    return terminate(step.solution(), Termination::MAX_ITERATIONS);
+}
+}
 
-        // todo: verify if we have to normalize here
-        angular_delta = dp.template tail<traits_t::ANGULAR_DIMS>();
-        angular += angular_delta;
+template<typename iterator_t, typename ndt_t, typename traits_t = MatchTraits<ndt_t>>
+auto match(const iterator_t& points_begin,
+           const iterator_t& points_end,
+           const ndt_t& map,
+           const typename traits_t::parameter_t& param,
+           const typename ndt_t::transform_t& initial_transform)
+-> Result<typename ndt_t::transform_t>
+{
+    using point_t = typename ndt_t::point_t;
 
-        if (test_eps())
-            return terminate(Termination::DELTA_EPSILON);
-    }
+    point_buffer_t<ndt_t> points_prime;
+    points_prime.reserve(std::distance(points_begin, points_end));
+    std::transform(points_begin, points_end, std::back_inserter(points_prime),
+                   [&](const point_t& point) { return initial_transform * point; });
 
-    return terminate(Termination::MAX_ITERATIONS);
+    return impl::match<ndt_t, traits_t>(points_prime, map, param, initial_transform);
 }
 
 template<typename ndt_t, typename traits_t = MatchTraits<ndt_t>>
@@ -154,27 +279,35 @@ auto match(const ndt_t& src,
     using gradient_t    = Eigen::Matrix<double, DIMS, 1>;
     using hessian_t     = Eigen::Matrix<double, DIMS, DIMS>;
 
-    // initialize result
-    double max_score        = std::numeric_limits<double>::lowest();
-    std::size_t iteration   = 0;
+    using source_distributions_t = typename traits_t::source_distributions_t;
+    using transformed_t          = typename traits_t::TransformedSourceDistribution;
 
-    linear_t  linear    = initial_transform.translation().data();
-    angular_t angular   = initial_transform.euler();
+    // the source map does not change, its distributions are collected only once
+    source_distributions_t sources;
+    traits_t::getSourceDistributions(src, sources);
 
-    // initialize state
-    linear_t  linear_old    = linear;
-    angular_t angular_old   = angular;
-    linear_t  linear_delta  = linear_t::Constant(std::numeric_limits<double>::max());
-    angular_t angular_delta = angular_t::Constant(std::numeric_limits<double>::max());
+    // sources are evaluated in fixed blocks, so that the sums do not depend on the number of threads
+    static constexpr std::size_t SOURCES_PER_BLOCK = 64;
+    const std::size_t size       = sources.size();
+    const std::size_t num_blocks = (size + SOURCES_PER_BLOCK - 1) / SOURCES_PER_BLOCK;
 
-    double lambda = 1.0;
+    std::vector<double>                                             block_scores(num_blocks);
+    std::vector<gradient_t, Eigen::aligned_allocator<gradient_t>>   block_gradients(num_blocks);
+    std::vector<hessian_t, Eigen::aligned_allocator<hessian_t>>     block_hessians(num_blocks);
+
+    // initialize state
+    gradient_t x0;
+    x0 << initial_transform.translation().data(), initial_transform.euler();
+    StepControl<DIMS> step(param, x0);
+    std::size_t iteration        = 0;
     std::size_t step_adjustments = 0;
 
     // termination criteria
     const auto test_eps = [&]()
     {
-        return (linear_delta.array().abs() < param.translationEpsilon()).all()
-                && (angular_delta.array().abs() < param.rotationEpsilon()).all();
+        const gradient_t& delta = step.delta();
+        return (delta.template head<traits_t::LINEAR_DIMS>().array().abs() < param.translationEpsilon()).all()
+                && (delta.template tail<traits_t::ANGULAR_DIMS>().array().abs() < param.rotationEpsilon()).all();
     };
 
     const auto test_readjustments = [&]()
@@ -182,23 +315,37 @@ auto match(const ndt_t& src,
         return step_adjustments > 0 && step_adjustments > param.maxStepReadjustments();
     };
 
+    const auto start = std::chrono::steady_clock::now();
+    const auto test_time_budget = [&]()
+    {
+        return param.timeBudget() > 0.0 &&
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= param.timeBudget();
+    };
+
     // termination
-    const auto terminate = [&](Termination reason)
+    const auto terminate = [&](const gradient_t& x, Termination reason)
     {
+        const linear_t  linear  = x.template head<traits_t::LINEAR_DIMS>();
+        const angular_t angular = x.template tail<traits_t::ANGULAR_DIMS>();
         return result_t{
-            max_score,
+            step.bestScore(),
                     iteration,
-                    traits_t::makeTransform(linear, angular) * initial_transform,
+                    traits_t::makeTransform(linear, angular),
                     reason };
     };
 
-
     // iterations
     for (iteration = 0; iteration < param.maxIterations(); ++iteration)
     {
         if (test_readjustments())
-            return terminate(Termination::MAX_STEP_READJUSTMENTS);
+            return terminate(step.best(), Termination::MAX_STEP_READJUSTMENTS);
+
+        // the best evaluated state so far
+        if (iteration > 0 && test_time_budget())
+            return terminate(step.best(), Termination::TIME_BUDGET);
 
+        const linear_t  linear  = step.x().template head<traits_t::LINEAR_DIMS>();
+        const angular_t angular = step.x().template tail<traits_t::ANGULAR_DIMS>();
         const auto t = traits_t::makeTransform(linear, angular);
 
         JacobianCompute J;
@@ -209,54 +356,54 @@ auto match(const ndt_t& src,
         gradient_t  g = gradient_t::Zero();
         hessian_t   h = hessian_t::Zero();
 
-        double score = 0.0;
-        auto process_bundle = [&dst, &J, &H, &t, &score, &g, &h](const typename ndt_t::index_t &, const typename ndt_t::distribution_bundle_t &b)
+        // evaluate the source distributions in parallel, every block has its own accumulators
+        cslibs_ndt::parallel(num_blocks, 1, [&](const std::size_t blocks_begin, const std::size_t blocks_end)
         {
-            traits_t::computeGradient(dst, b, J, H, t, score, g, h);
-        };
-        src.traverse(process_bundle);
+            transformed_t ts;
+            for (std::size_t b = blocks_begin; b < blocks_end; ++b)
+            {
+                double      &block_score    = block_scores[b];
+                gradient_t  &block_gradient = block_gradients[b];
+                hessian_t   &block_hessian  = block_hessians[b];
+                block_score    = 0.0;
+                block_gradient = gradient_t::Zero();
+                block_hessian  = hessian_t::Zero();
+
+                const std::size_t end = std::min((b + 1) * SOURCES_PER_BLOCK, size);
+                for (std::size_t i = b * SOURCES_PER_BLOCK; i < end; ++i)
+                    traits_t::computeGradient(dst, sources[i], J, H, t, ts,
+                                              block_score, block_gradient, block_hessian);
+            }
+        });
 
-        if (score < max_score)
+        double score = 0.0;
+        for (std::size_t b = 0; b < num_blocks; ++b)
         {
-            lambda *= param.alpha();
-            linear = linear_old;
-            angular = angular_old;
-            ++step_adjustments;
-            continue;
+            score += block_scores[b];
+            g     += block_gradients[b];
+            h     += block_hessians[b];
         }
 
-        std::cout << "linear: " << linear << "\n";
-        std::cout << "angular:" << angular << "\n";
-        std::cout << "score:  " << score << "\n";
-        std::cout << "lambda: " << lambda << "\n";
-
-        if (score > max_score)
+        switch (step.update(score, g, h))
         {
-            max_score = score;
-            lambda = std::max(1.0, lambda / param.alpha());
+        case StepResult::REJECTED:
+            ++step_adjustments;
+            continue;
+        case StepResult::SEARCHING:
+            continue;
+        case StepResult::FAILED:
+            // no improvement along the search direction
+            return terminate(step.best(), Termination::MAX_STEP_READJUSTMENTS);
+        default:
             step_adjustments = 0;
+            break;
         }
 
-        /// limit H
-        // cslibs_math::statistics::LimitEigenValuesByZero<DIMS>::apply(h);
-        gradient_t dp = h.fullPivLu().solve(g);
-        dp *= lambda;
-
-        linear_old = linear;
-        angular_old = angular;
-
-        linear_delta = dp.template head<traits_t::LINEAR_DIMS>();
-        linear += linear_delta;
-
-        // todo: verify if we have to normalize here
-        angular_delta = dp.template tail<traits_t::ANGULAR_DIMS>();
-        angular += angular_delta;
-
         if (test_eps())
-            return terminate(Termination::DELTA_EPSILON);
+            return terminate(step.solution(), Termination::DELTA_EPSILON);
     }
 
-    return terminate(Termination::MAX_ITERATIONS);
+    return terminate(step.solution(), Termination::MAX_ITERATIONS);
 }
 
 
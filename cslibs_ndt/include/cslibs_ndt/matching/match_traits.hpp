@@ -5,6 +5,10 @@ namespace matching {
 
 template<typename MapT, typename Enable = void>
 struct MatchTraits;
+
+/// planar (x, y, yaw) matching against maps of higher dimension, pass as traits_t to match()
+template<typename MapT, typename Enable = void>
+struct PlanarMatchTraits;
 /*
 Required Interface:
 - "void"-usings have to be adjusted
@@ -21,17 +25,28 @@ Required Interface:
 
     using point_t       = void;
     using transform_t   = void;
+    using parameter_t   = void;
 
     static transform_t makeTransform(const Eigen::Matrix<double, LINEAR_DIMS, 1>& linear,
                                      const Eigen::Matrix<double, ANGULAR_DIMS, 1>& angular);
 
+    // point_prime: point before, point: point after applying the current estimate
     static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
                                 const point_t& point,
                                 const Jacobian& J,
                                 const Hessian& H,
+                                const parameter_t& param,
                                 double& score,
                                 gradient_t& g,
                                 hessian_t& h);
+
+    // optional: called once per match call on the initially transformed points,
+    // the returned parameters are passed to computeGradient
+    template<typename points_t>
+    static parameter_t prepare(const MapT& map,
+                               const points_t& points_prime,
+                               const parameter_t& param);
 };
 */
 }
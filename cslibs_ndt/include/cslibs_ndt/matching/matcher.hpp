@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cslibs_ndt/matching/match.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cslibs_ndt {
+namespace matching {
+namespace impl {
+/**
+ * @brief Whether scans can be inserted by insert(points_begin, points_end, origin), static and
+ *        mapped maps are read only.
+ */
+template<typename ndt_t, typename iterator_t, typename = void>
+struct IsInsertable : std::false_type {};
+
+template<typename ndt_t, typename iterator_t>
+struct IsInsertable<ndt_t, iterator_t,
+                    decltype(void(std::declval<ndt_t&>().insert(std::declval<iterator_t>(),
+                                                                std::declval<iterator_t>(),
+                                                                std::declval<typename ndt_t::transform_t>())))>
+        : std::true_type {};
+}
+
+/**
+ * @brief Stateful scan to map matcher. The point buffer is kept between calls,
+ *        subsequent scans are warm started by a constant velocity prediction and,
+ *        in incremental mode, converged scans are inserted into the target map.
+ */
+template<typename ndt_t, typename traits_t = MatchTraits<ndt_t>>
+class EIGEN_ALIGN16 Matcher
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr           = std::shared_ptr<Matcher>;
+    using map_t         = ndt_t;
+    using map_ptr_t     = typename ndt_t::Ptr;
+    using point_t       = typename ndt_t::point_t;
+    using transform_t   = typename ndt_t::transform_t;
+    using parameter_t   = typename traits_t::parameter_t;
+    using result_t      = Result<transform_t>;
+
+    inline explicit Matcher(const parameter_t &param,
+                            const map_ptr_t   &map         = nullptr,
+                            const bool         incremental = false) :
+        param_(param),
+        map_(map),
+        incremental_(incremental),
+        has_pose_(false),
+        has_velocity_(false)
+    {
+    }
+
+    inline const parameter_t& getParameter() const
+    {
+        return param_;
+    }
+
+    inline parameter_t& getParameter()
+    {
+        return param_;
+    }
+
+    inline void setMap(const map_ptr_t &map)
+    {
+        map_ = map;
+    }
+
+    inline const map_ptr_t& getMap() const
+    {
+        return map_;
+    }
+
+    /**
+     * @brief In incremental mode every converged scan is inserted into the target map,
+     *        an empty map has to be seeded with insert() first. Read only maps are not updated.
+     */
+    inline void setIncremental(const bool incremental)
+    {
+        incremental_ = incremental;
+    }
+
+    inline bool isIncremental() const
+    {
+        return incremental_;
+    }
+
+    /**
+     * @brief Drop the motion model and restart at the given pose.
+     */
+    inline void reset(const transform_t &pose = transform_t())
+    {
+        pose_         = pose;
+        velocity_     = transform_t();
+        has_pose_     = true;
+        has_velocity_ = false;
+    }
+
+    inline const transform_t& getPose() const
+    {
+        return pose_;
+    }
+
+    /**
+     * @brief Constant velocity prediction of the pose of the next scan.
+     */
+    inline transform_t predict() const
+    {
+        return has_velocity_ ? pose_ * velocity_ : pose_;
+    }
+
+    /**
+     * @brief Insert a scan at a known pose into the target map, e.g. to seed an empty map.
+     *        The pose becomes the reference of the motion model.
+     */
+    template<typename iterator_t>
+    inline void insert(const iterator_t  &points_begin,
+                       const iterator_t  &points_end,
+                       const transform_t &pose)
+    {
+        static_assert(impl::IsInsertable<ndt_t, iterator_t>::value,
+                      "[Matcher]: scans cannot be inserted into a read only map.");
+        if (!map_)
+            throw std::runtime_error("[Matcher]: no target map set.");
+
+        map_->insert(points_begin, points_end, pose);
+        update(pose);
+    }
+
+    template<typename iterator_t>
+    inline result_t match(const iterator_t &points_begin,
+                          const iterator_t &points_end)
+    {
+        return match(points_begin, points_end, predict());
+    }
+
+    template<typename iterator_t>
+    inline result_t match(const iterator_t    &points_begin,
+                          const iterator_t    &points_end,
+                          const transform_t   &initial_transform)
+    {
+        if (!map_)
+            throw std::runtime_error("[Matcher]: no target map set.");
+
+        points_prime_.clear();
+        points_prime_.reserve(static_cast<std::size_t>(std::distance(points_begin, points_end)));
+        for (iterator_t it = points_begin ; it != points_end ; ++it)
+            points_prime_.emplace_back(initial_transform * *it);
+
+        const result_t r = impl::match<ndt_t, traits_t>(points_prime_, *map_, param_, initial_transform);
+
+        /// scans without any correspondence do not update the motion model
+        if (r.score() > 0.0) {
+            update(r.transform());
+            if (incremental_ && r.termination() == Termination::DELTA_EPSILON)
+                insertScan(points_begin, points_end, r.transform(), impl::IsInsertable<ndt_t, iterator_t>());
+        }
+        return r;
+    }
+
+private:
+    parameter_t                 param_;
+    map_ptr_t                   map_;
+    bool                        incremental_;
+
+    transform_t                 pose_;
+    transform_t                 velocity_;
+    bool                        has_pose_;
+    bool                        has_velocity_;
+
+    point_buffer_t<ndt_t>       points_prime_;
+
+    inline void update(const transform_t &pose)
+    {
+        if (has_pose_) {
+            velocity_     = pose_.inverse() * pose;
+            has_velocity_ = true;
+        }
+        pose_     = pose;
+        has_pose_ = true;
+    }
+
+    template<typename iterator_t>
+    inline void insertScan(const iterator_t  &points_begin,
+                           const iterator_t  &points_end,
+                           const transform_t &pose,
+                           std::true_type)
+    {
+        map_->insert(points_begin, points_end, pose);
+    }
+
+    template<typename iterator_t>
+    inline void insertScan(const iterator_t  &,
+                           const iterator_t  &,
+                           const transform_t &,
+                           std::false_type)
+    {
+    }
+
+};
+
+}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cslibs_ndt/common/index_hash.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace matching {
+
+/**
+ * @brief Hashed occupancy states of the bundles touched by a point cloud, the memory only
+ *        depends on the number of distinct bundles, not on the extent of the cloud.
+ *        Every touched bundle is classified once, afterwards a lookup is a single hash probe.
+ *        Bundles which were not classified, e.g. because the cloud moved into them during
+ *        optimization, are reported as UNKNOWN.
+ */
+template<std::size_t Dim>
+class OccupancyMask
+{
+public:
+    using Ptr       = std::shared_ptr<OccupancyMask>;
+    using ConstPtr  = std::shared_ptr<const OccupancyMask>;
+    using index_t   = std::array<int, Dim>;
+
+    enum State : std::uint8_t { UNKNOWN = 0, FREE = 1, OCCUPIED = 2 };
+
+    /**
+     * @brief Classify the bundles touched by a cloud.
+     * @param indices   bundle indices of the cloud, may contain duplicates
+     * @param occupancy evaluated once per distinct bundle index
+     * @param threshold bundles with lower occupancy are FREE
+     * @return false if there are no indices, the mask is empty then
+     */
+    template<typename occupancy_fn_t>
+    inline bool build(const std::vector<index_t> &indices,
+                      const occupancy_fn_t       &occupancy,
+                      const double                threshold)
+    {
+        cells_.clear();
+        if (indices.empty())
+            return false;
+
+        for (const index_t &bi : indices) {
+            std::uint8_t &c = cells_[bi];
+            if (c == UNKNOWN)
+                c = occupancy(bi) < threshold ? FREE : OCCUPIED;
+        }
+        return true;
+    }
+
+    inline std::uint8_t get(const index_t &bi) const
+    {
+        const auto c = cells_.find(bi);
+        return c != cells_.end() ? c->second : static_cast<std::uint8_t>(UNKNOWN);
+    }
+
+    inline bool empty() const
+    {
+        return cells_.empty();
+    }
+
+    inline std::size_t size() const
+    {
+        return cells_.size();
+    }
+
+    /// approximate, nodes hold the key, the state and the chaining pointer
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) +
+               cells_.bucket_count() * sizeof(void*) +
+               cells_.size() * (sizeof(index_t) + sizeof(void*) + sizeof(std::size_t));
+    }
+
+private:
+    std::unordered_map<index_t, std::uint8_t, IndexHash<Dim>> cells_;
+};
+
+}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cslibs_ndt/matching/parameter.hpp>
+#include <cslibs_ndt/matching/occupancy_mask.hpp>
 
 namespace cslibs_ndt {
 namespace matching {
@@ -8,11 +9,14 @@ namespace matching {
 class OccupancyParameter : public Parameter
 {
 public:
+    using occupancy_mask_t = OccupancyMask<3>;
+
     explicit OccupancyParameter(const Parameter& parameter,
                                 const cslibs_gridmaps::utility::InverseModel& inverse_model,
                                 double occupancy_threshold = 0.0) :
             Parameter(parameter),
-            inverse_model_(inverse_model)
+            inverse_model_(inverse_model),
+            occupancy_threshold_(occupancy_threshold)
     {}
 
     cslibs_gridmaps::utility::InverseModel& inverseModel() { return inverse_model_; }
@@ -21,9 +25,14 @@ public:
     double& occupancyThreshold() { return occupancy_threshold_; }
     double occupancyThreshold() const { return occupancy_threshold_; }
 
+    /// bundle classification of the current match call, set by the 3d occupancy match traits
+    occupancy_mask_t::ConstPtr& occupancyMask() { return occupancy_mask_; }
+    const occupancy_mask_t::ConstPtr& occupancyMask() const { return occupancy_mask_; }
+
 private:
     cslibs_gridmaps::utility::InverseModel inverse_model_;
     double occupancy_threshold_;
+    occupancy_mask_t::ConstPtr occupancy_mask_;
 };
 
 }
@@ -5,6 +5,8 @@
 namespace cslibs_ndt {
 namespace matching {
 
+enum class StepPolicy { HEURISTIC, LEVENBERG_MARQUARDT, MORE_THUENTE };
+
 class Parameter
 {
 public:
@@ -13,7 +15,12 @@ public:
         translation_epsilon_(1e-3),
         rotation_epsilon_(1e-3),
         max_step_readjustments_(5),
-        alpha_(1.1)
+        alpha_(1.1),
+        time_budget_(0.0),
+        subsampling_start_(1.0),
+        subsampling_growth_(2.0),
+        step_policy_(StepPolicy::HEURISTIC),
+        max_line_search_iterations_(10)
     {
     }
 
@@ -21,12 +28,22 @@ public:
                        double translation_epsilon,
                        double rotation_epsilon,
                        std::size_t max_step_readjustments,
-                       double alpha) :
+                       double alpha,
+                       double time_budget = 0.0,
+                       double subsampling_start = 1.0,
+                       double subsampling_growth = 2.0,
+                       StepPolicy step_policy = StepPolicy::HEURISTIC,
+                       std::size_t max_line_search_iterations = 10) :
             max_iterations_(max_iterations),
             translation_epsilon_(translation_epsilon),
             rotation_epsilon_(rotation_epsilon),
             max_step_readjustments_(max_step_readjustments),
-            alpha_(alpha)
+            alpha_(alpha),
+            time_budget_(time_budget),
+            subsampling_start_(subsampling_start),
+            subsampling_growth_(subsampling_growth),
+            step_policy_(step_policy),
+            max_line_search_iterations_(max_line_search_iterations)
     {}
 
     std::size_t maxIterations() const { return max_iterations_; }
@@ -34,12 +51,27 @@ public:
     double rotationEpsilon() const { return rotation_epsilon_; }
     std::size_t maxStepReadjustments() const { return max_step_readjustments_; }
     double alpha() const { return alpha_; }
+    /// wall time limit in seconds, checked between iterations, <= 0 disables it
+    double timeBudget() const { return time_budget_; }
+    /// fraction of points evaluated in the first iteration, 1 disables subsampling
+    double subsamplingStart() const { return subsampling_start_; }
+    /// factor the evaluated fraction grows by per iteration, <= 1 disables subsampling
+    double subsamplingGrowth() const { return subsampling_growth_; }
+    /// step control of the optimizer, see StepControl
+    StepPolicy stepPolicy() const { return step_policy_; }
+    /// evaluations per line search before the best trial is taken, only used by MORE_THUENTE
+    std::size_t maxLineSearchIterations() const { return max_line_search_iterations_; }
 
     std::size_t& maxIterations() { return max_iterations_; }
     double& translationEpsilon() { return translation_epsilon_; }
     double& rotationEpsilon() { return rotation_epsilon_; }
     std::size_t& maxStepReadjustments() { return max_step_readjustments_; }
     double& alpha() { return alpha_; }
+    double& timeBudget() { return time_budget_; }
+    double& subsamplingStart() { return subsampling_start_; }
+    double& subsamplingGrowth() { return subsampling_growth_; }
+    StepPolicy& stepPolicy() { return step_policy_; }
+    std::size_t& maxLineSearchIterations() { return max_line_search_iterations_; }
 
 
 private:
@@ -48,6 +80,11 @@ private:
     double rotation_epsilon_;
     std::size_t max_step_readjustments_;
     double alpha_;
+    double time_budget_;
+    double subsampling_start_;
+    double subsampling_growth_;
+    StepPolicy step_policy_;
+    std::size_t max_line_search_iterations_;
 };
 
 }
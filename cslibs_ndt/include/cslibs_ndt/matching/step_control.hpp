@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cslibs_ndt/matching/line_search.hpp>
+#include <cslibs_ndt/matching/parameter.hpp>
+
+#include <Eigen/Eigen>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cslibs_ndt {
+namespace matching {
+
+enum class StepResult { ACCEPTED, REJECTED, SEARCHING, FAILED };
+
+/**
+ * @brief Step control of the NDT optimizers. Every call of update() consumes one evaluation
+ *        of the score, its gradient g and its hessian h at x() and moves x() to the next state
+ *        which has to be evaluated. Following the optimizers, g is the negative gradient of the
+ *        score and -h is used as curvature of the negative score.
+ *        - HEURISTIC:            newton step scaled by lambda, lambda grows by alpha on score decrease
+ *                                and the optimizer returns to the last accepted state
+ *        - LEVENBERG_MARQUARDT:  damped newton step, the damping follows the ratio of actual to predicted
+ *                                score gain, rejected steps reuse the last accepted evaluation
+ *        - MORE_THUENTE:         line search along the (convexified) newton direction, accepted trial
+ *                                evaluations directly become the next linearization point
+ */
+template<int Dims>
+class EIGEN_ALIGN16 StepControl
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using vector_t = Eigen::Matrix<double, Dims, 1>;
+    using matrix_t = Eigen::Matrix<double, Dims, Dims>;
+
+    inline explicit StepControl(const Parameter &param,
+                                const vector_t  &x = vector_t::Zero()) :
+        policy_(param.stepPolicy()),
+        alpha_(param.alpha()),
+        max_line_search_iterations_(std::max<std::size_t>(1, param.maxLineSearchIterations())),
+        x_(x),
+        delta_(vector_t::Constant(std::numeric_limits<double>::max())),
+        best_x_(x),
+        best_score_(std::numeric_limits<double>::lowest()),
+        lambda_(1.0),
+        has_reference_(false),
+        mu_(0.0),
+        nu_(2.0),
+        predicted_(0.0),
+        searching_(false),
+        trials_(0),
+        dphi0_(0.0),
+        trial_score_(std::numeric_limits<double>::lowest())
+    {
+    }
+
+    /**
+     * @brief Scores evaluated so far are not comparable anymore, e.g. because the evaluated subset changed.
+     *        The next evaluation is accepted unconditionally.
+     */
+    inline void reset()
+    {
+        best_score_    = std::numeric_limits<double>::lowest();
+        has_reference_ = false;
+        searching_     = false;
+    }
+
+    /// next state to evaluate
+    inline const vector_t& x() const
+    {
+        return x_;
+    }
+
+    /// last accepted step
+    inline const vector_t& delta() const
+    {
+        return delta_;
+    }
+
+    /// best evaluated state
+    inline const vector_t& best() const
+    {
+        return best_x_;
+    }
+
+    inline double bestScore() const
+    {
+        return best_score_;
+    }
+
+    /// state to report on convergence, the heuristic reports the last step without evaluating it
+    inline const vector_t& solution() const
+    {
+        return policy_ == StepPolicy::HEURISTIC ? x_ : best_x_;
+    }
+
+    inline StepResult update(const double    score,
+                             const vector_t &g,
+                             const matrix_t &h)
+    {
+        switch (policy_) {
+        case StepPolicy::LEVENBERG_MARQUARDT:
+            return updateLevenbergMarquardt(score, g, h);
+        case StepPolicy::MORE_THUENTE:
+            return updateMoreThuente(score, g, h);
+        default:
+            return updateHeuristic(score, g, h);
+        }
+    }
+
+private:
+    const StepPolicy    policy_;
+    const double        alpha_;
+    const std::size_t   max_line_search_iterations_;
+
+    vector_t            x_;
+    vector_t            delta_;
+    vector_t            best_x_;
+    double              best_score_;
+
+    /// heuristic
+    double              lambda_;
+
+    /// an evaluation was accepted since the last reset
+    bool                has_reference_;
+
+    /// levenberg marquardt, g_ and h_ are the evaluation at best_x_
+    vector_t            g_;
+    matrix_t            h_;
+    double              mu_;
+    double              nu_;
+    double              predicted_;
+
+    /// more thuente
+    MoreThuente         line_search_;
+    bool                searching_;
+    std::size_t         trials_;
+    vector_t            direction_;
+    double              dphi0_;
+    vector_t            trial_x_;
+    double              trial_score_;
+    vector_t            trial_g_;
+    matrix_t            trial_h_;
+
+    inline StepResult updateHeuristic(const double    score,
+                                      const vector_t &g,
+                                      const matrix_t &h)
+    {
+        if (score < best_score_) {
+            lambda_ *= alpha_;
+            x_ = best_x_;
+            return StepResult::REJECTED;
+        }
+
+        if (score > best_score_) {
+            best_score_ = score;
+            lambda_ = std::max(1.0, lambda_ / alpha_);
+        }
+
+        /// limit H
+        // cslibs_math::statistics::LimitEigenValuesByZero<DIMS>::apply(h);
+        best_x_ = x_;
+        delta_  = lambda_ * h.fullPivLu().solve(g);
+        x_     += delta_;
+        return StepResult::ACCEPTED;
+    }
+
+    inline StepResult updateLevenbergMarquardt(const double    score,
+                                               const vector_t &g,
+                                               const matrix_t &h)
+    {
+        if (has_reference_) {
+            const double rho = predicted_ > 0.0 ? (score - best_score_) / predicted_ : -1.0;
+            if (!(rho > 0.0)) {
+                mu_ *= nu_;
+                nu_ *= 2.0;
+                dampedStep();
+                return StepResult::REJECTED;
+            }
+            mu_ *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+            nu_  = 2.0;
+        } else {
+            mu_ = 1e-3 * (-h).diagonal().cwiseAbs().maxCoeff();
+            nu_ = 2.0;
+        }
+
+        has_reference_ = true;
+        best_x_        = x_;
+        best_score_    = score;
+        g_             = g;
+        h_             = h;
+        dampedStep();
+        return StepResult::ACCEPTED;
+    }
+
+    /// solve (A + mu I) dx = -g with A = -h, mu is raised until A + mu I is positive definite
+    inline void dampedStep()
+    {
+        const Eigen::SelfAdjointEigenSolver<matrix_t> eigen(-h_);
+        const vector_t &lambda = eigen.eigenvalues();
+        const matrix_t &V      = eigen.eigenvectors();
+
+        mu_ = std::max(mu_, std::max(-2.0 * lambda.minCoeff(), 1e-12 * (1.0 + lambda.cwiseAbs().maxCoeff())));
+
+        const vector_t dx = -V * ((V.transpose() * g_).array() / (lambda.array() + mu_)).matrix();
+        predicted_ = -g_.dot(dx) - 0.5 * dx.dot(-h_ * dx);
+        delta_     = dx;
+        x_         = best_x_ + dx;
+    }
+
+    inline StepResult updateMoreThuente(const double    score,
+                                        const vector_t &g,
+                                        const matrix_t &h)
+    {
+        if (!searching_) {
+            if (has_reference_)
+                delta_ = x_ - best_x_;
+            else
+                delta_ = vector_t::Constant(std::numeric_limits<double>::max());
+            return startLineSearch(x_, score, g, h);
+        }
+
+        // phi(stp) = -score(x + stp d), phi'(stp) = g^T d
+        ++trials_;
+        if (score > trial_score_) {
+            trial_x_     = x_;
+            trial_score_ = score;
+            trial_g_     = g;
+            trial_h_     = h;
+        }
+
+        const MoreThuente::Status status = line_search_.update(-score, g.dot(direction_));
+        if (status == MoreThuente::Status::CONVERGED) {
+            delta_ = x_ - best_x_;
+            return startLineSearch(x_, score, g, h);
+        }
+
+        if (status == MoreThuente::Status::WARNING || trials_ >= max_line_search_iterations_) {
+            if (trial_score_ > best_score_) {
+                delta_ = trial_x_ - best_x_;
+                const vector_t x = trial_x_;
+                const vector_t g_trial = trial_g_;
+                const matrix_t h_trial = trial_h_;
+                return startLineSearch(x, trial_score_, g_trial, h_trial);
+            }
+            x_ = best_x_;
+            searching_ = false;
+            return StepResult::FAILED;
+        }
+
+        x_ = best_x_ + line_search_.step() * direction_;
+        return StepResult::SEARCHING;
+    }
+
+    inline StepResult startLineSearch(const vector_t &x,
+                                      const double    score,
+                                      const vector_t &g,
+                                      const matrix_t &h)
+    {
+        has_reference_ = true;
+        best_x_        = x;
+        best_score_    = score;
+
+        // newton direction on the absolute eigenvalues of A = -h is a descent direction of -score
+        const Eigen::SelfAdjointEigenSolver<matrix_t> eigen(-h);
+        const vector_t &lambda = eigen.eigenvalues();
+        const matrix_t &V      = eigen.eigenvectors();
+        const double    floor  = 1e-6 * lambda.cwiseAbs().maxCoeff() + std::numeric_limits<double>::min();
+        direction_ = -V * ((V.transpose() * g).array() / lambda.array().abs().max(floor)).matrix();
+        dphi0_     = g.dot(direction_);
+
+        trials_      = 0;
+        trial_score_ = std::numeric_limits<double>::lowest();
+        searching_   = line_search_.start(-score, dphi0_, 1.0, 0.0, 4.0);
+        if (!searching_) {
+            // vanishing gradient, the current state is stationary
+            delta_.setZero();
+            x_ = best_x_;
+            return StepResult::ACCEPTED;
+        }
+
+        x_ = best_x_ + line_search_.step() * direction_;
+        return StepResult::ACCEPTED;
+    }
+};
+
+}
+}
@@ -2,10 +2,17 @@
 #define CSLIBS_NDT_3D_VOXEL_HPP
 
 #include <cslibs_math_3d/linear/pointcloud.hpp>
+#include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_indexed_storage/storage.hpp>
 #include <cslibs_indexed_storage/backend/kdtree/kdtree.hpp>
 #include <cslibs_indexed_storage/backend/array/array.hpp>
 
+#include <cslibs_ndt/common/index_hash.hpp>
+
+#include <unordered_map>
+#include <thread>
+#include <vector>
+
 namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt {
@@ -35,23 +42,31 @@ public:
     inline virtual ~Voxel() = default;
 
     inline Voxel(const Voxel &other) :
+        n_(other.n_),
+        n_1_(other.n_1_),
         mean_(other.mean_)
     {
     }
 
    inline  Voxel(Voxel &&other) :
+        n_(other.n_),
+        n_1_(other.n_1_),
         mean_(std::move(other.mean_))
     {
     }
 
     inline Voxel& operator = (const Voxel &other)
     {
+        n_    = other.n_;
+        n_1_  = other.n_1_;
         mean_ = other.mean_;
         return *this;
     }
 
     inline Voxel& operator = (Voxel &&other)
     {
+        n_    = other.n_;
+        n_1_  = other.n_1_;
         mean_ = std::move(other.mean_);
         return *this;
     }
@@ -61,9 +76,17 @@ public:
         return mean_;
     }
 
+    inline std::size_t getN() const
+    {
+        return n_1_;
+    }
+
     inline void merge(const Voxel &other)
     {
         const std::size_t   _n  = n_1_ + other.n_1_;
+        if (_n == 0)
+            return;
+
         const point_t       _pt = (mean_ * static_cast<double>(n_1_) + other.mean_ * static_cast<double>(other.n_1_)) / static_cast<double>(_n);
         n_                      = _n + 1;
         n_1_                    = _n;
@@ -92,6 +115,112 @@ struct VoxelGrid
     using type = cis::Storage<Voxel<Dim>, typename Voxel<Dim>::index_t, cis::backend::array::Array>;
     using Ptr = std::shared_ptr<type>;
 };
+
+/**
+ * @brief Sparse voxel grid downsampling filter, replaces all points falling into
+ *        the same voxel by their centroid. Voxels are hashed, therefore memory only
+ *        depends on the number of occupied voxels and not on the bounding volume.
+ *        Points are accumulated chunk-wise per thread into one map per partition of the
+ *        hash space, every partition is then reduced by its own thread.
+ */
+template<std::size_t Dim>
+class VoxelFilter
+{
+public:
+    using voxel_t       = Voxel<Dim>;
+    using index_t       = typename voxel_t::index_t;
+    using point_t       = typename voxel_t::point_t;
+    using hash_t        = IndexHash<Dim>;
+    using pointcloud_t  = cslibs_math::linear::Pointcloud<point_t>;
+    using voxel_map_t   = std::unordered_map<index_t, voxel_t, hash_t, std::equal_to<index_t>,
+                                             Eigen::aligned_allocator<std::pair<const index_t, voxel_t>>>;
+
+    inline explicit VoxelFilter(const double      resolution,
+                                const std::size_t num_threads = std::thread::hardware_concurrency()) :
+        resolution_inv_(1.0 / resolution),
+        num_threads_(std::max(1ul, num_threads))
+    {
+    }
+
+    inline typename pointcloud_t::Ptr apply(const typename pointcloud_t::ConstPtr &src) const
+    {
+        return apply(src->begin(), src->end());
+    }
+
+    template<typename iterator_t>
+    inline typename pointcloud_t::Ptr apply(const iterator_t &points_begin,
+                                            const iterator_t &points_end) const
+    {
+        const std::size_t size        = static_cast<std::size_t>(std::distance(points_begin, points_end));
+        const std::size_t num_threads = std::max(1ul, std::min(num_threads_, size));
+        const std::size_t chunk_size  = (size + num_threads - 1) / num_threads;
+
+        std::vector<std::thread> threads(num_threads);
+
+        /// step one: accumulate the chunks, already split into the partitions of step two
+        std::vector<std::vector<voxel_map_t>> chunks(num_threads, std::vector<voxel_map_t>(num_threads));
+        for (std::size_t t = 0 ; t < num_threads ; ++t) {
+            threads[t] = std::thread([this, &chunks, &points_begin, size, chunk_size, num_threads, t]() {
+                const hash_t hash;
+                const std::size_t begin = std::min(t * chunk_size, size);
+                const std::size_t end   = std::min(begin + chunk_size, size);
+                std::vector<voxel_map_t> &partitions = chunks[t];
+                const iterator_t chunk_end = std::next(points_begin, end);
+                for (auto itr = std::next(points_begin, begin) ; itr != chunk_end ; ++itr) {
+                    const point_t &p = *itr;
+                    if (!p.isNormal())
+                        continue;
+
+                    const index_t i = voxel_t::getIndex(p, resolution_inv_);
+                    voxel_map_t &voxels = partitions[hash(i) % num_threads];
+                    auto v = voxels.find(i);
+                    if (v == voxels.end())
+                        voxels.emplace(i, voxel_t(p));
+                    else
+                        v->second.merge(voxel_t(p));
+                }
+            });
+        }
+        for (std::size_t t = 0 ; t < num_threads ; ++t)
+            threads[t].join();
+
+        /// step two: reduce, every thread only merges its own partition of all chunks
+        std::vector<voxel_map_t> partitions(num_threads);
+        for (std::size_t t = 0 ; t < num_threads ; ++t) {
+            threads[t] = std::thread([&chunks, &partitions, t]() {
+                voxel_map_t &voxels = partitions[t];
+                for (std::vector<voxel_map_t> &chunk : chunks) {
+                    voxel_map_t &partition = chunk[t];
+                    if (voxels.empty()) {
+                        voxels.swap(partition);
+                        continue;
+                    }
+                    for (const auto &entry : partition) {
+                        auto v = voxels.find(entry.first);
+                        if (v == voxels.end())
+                            voxels.emplace(entry.first, entry.second);
+                        else
+                            v->second.merge(entry.second);
+                    }
+                }
+            });
+        }
+        for (std::size_t t = 0 ; t < num_threads ; ++t)
+            threads[t].join();
+
+        /// step three: collect the centroids
+        typename pointcloud_t::Ptr dst(new pointcloud_t);
+        for (const voxel_map_t &voxels : partitions)
+            for (const auto &entry : voxels)
+                dst->insert(entry.second.mean());
+
+        return dst;
+    }
+
+private:
+    const double      resolution_inv_;
+    const std::size_t num_threads_;
+};
 }
 }
 
@@ -0,0 +1,142 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_ASYNC_SAVER_HPP
+#define CSLIBS_NDT_SERIALIZATION_ASYNC_SAVER_HPP
+
+#include <cslibs_ndt/serialization/storage.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * @brief Saves a dynamic map in the background while the map keeps being modified.
+ *
+ * The saver keeps a private copy of the map, the snapshot. save() brings the snapshot up to date with the
+ * bundles changed since the previous call, which costs O(changed cells) except for the first call, and
+ * writes the snapshot in a background thread. Only the snapshot is read by that thread, the map is never
+ * touched outside of save().
+ *
+ * Changes are taken from the unsaved bundles of the map (see getUnsavedBundles()) after the revision of
+ * the previous save(), the map may be journaled at the same time. Bundles erased from the map are kept in
+ * the snapshot.
+ */
+template <typename map_t>
+class AsyncSaver
+{
+public:
+    using Ptr                          = std::shared_ptr<AsyncSaver>;
+    using map_ptr_t                    = typename map_t::Ptr;
+    using index_t                      = typename map_t::index_t;
+    using distribution_t               = typename map_t::distribution_t;
+    using distribution_storage_t       = typename map_t::distribution_storage_t;
+    using distribution_storage_array_t = typename map_t::distribution_storage_array_t;
+    using record_t                     = cslibs_ndt::impl::Record<distribution_t>;
+    using write_t                      = std::function<bool(const map_ptr_t &)>;
+
+    inline AsyncSaver() = default;
+    AsyncSaver(const AsyncSaver &other) = delete;
+    AsyncSaver& operator = (const AsyncSaver &other) = delete;
+
+    inline virtual ~AsyncSaver()
+    {
+        wait();
+    }
+
+    /**
+     * @brief Take a snapshot of the map and write it in the background, to be called by the thread
+     *        owning the map. Waits for the previous write to finish, as it reads the snapshot.
+     * @param write     writes the snapshot, e.g. saveBinary() of the map type
+     * @return future of the result of write
+     */
+    inline std::shared_future<bool> save(map_t &map,
+                                         const write_t &write)
+    {
+        wait();
+        update(map);
+
+        const map_ptr_t snapshot = snapshot_;
+        pending_ = std::async(std::launch::async, [snapshot, write]() -> bool {
+            return write(snapshot);
+        }).share();
+        return pending_;
+    }
+
+    /**
+     * @brief Wait for the background write, if any.
+     * @return result of the last write, true if nothing was written yet
+     */
+    inline bool wait() const
+    {
+        return pending_.valid() ? pending_.get() : true;
+    }
+
+    inline bool busy() const
+    {
+        return pending_.valid() &&
+               pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    }
+
+    /**
+     * @brief Revision of the unsaved bundles of the map covered by the snapshot, see getUnsavedBundles().
+     */
+    inline uint64_t getSavedRevision() const
+    {
+        return saved_revision_;
+    }
+
+    /**
+     * @brief The snapshot taken by the last call of save(), must not be modified.
+     */
+    inline map_ptr_t getSnapshot() const
+    {
+        wait();
+        return snapshot_;
+    }
+
+private:
+    map_ptr_t                snapshot_;
+    std::shared_future<bool> pending_;
+    uint64_t                 saved_revision_ = 0;
+
+    inline void update(map_t &map)
+    {
+        std::vector<index_t> bis;
+        saved_revision_ = map.getUnsavedBundles(saved_revision_, bis);
+        if (!snapshot_) {
+            snapshot_.reset(new map_t(map.getInitialOrigin(), map.getResolution()));
+            bis.clear();
+            map.getBundleIndices(bis);
+        }
+
+        /// allocate missing bundles, then copy the cells, records also copy data shared between distributions
+        distribution_storage_array_t empty;
+        for (auto &s : empty)
+            s.reset(new distribution_storage_t);
+        snapshot_->insertBundles(bis, empty);
+
+        std::unordered_set<const distribution_t*> copied;
+        char record[record_t::size];
+        for (const index_t &bi : bis) {
+            const auto *src = map.getDistributionBundle(bi);
+            auto       *dst = snapshot_->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < empty.size() ; ++i) {
+                const distribution_t *d = src->at(i);
+                if (d && copied.insert(d).second) {
+                    record_t::encode(*d, record);
+                    record_t::decode(record, *(dst->at(i)));
+                }
+            }
+        }
+        snapshot_->clearDirtyBundles();
+        snapshot_->clearUnsavedBundles();
+    }
+};
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_ASYNC_SAVER_HPP
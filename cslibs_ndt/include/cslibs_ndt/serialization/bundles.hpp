@@ -0,0 +1,43 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_BUNDLES_HPP
+#define CSLIBS_NDT_SERIALIZATION_BUNDLES_HPP
+
+#include <cslibs_ndt/common/parallel.hpp>
+#include <cslibs_ndt/serialization/indices.hpp>
+
+#include <array>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * @brief Rebuild the bundles of a loaded map from its storages. The cell lookups only read the storages
+ *        and run in parallel, bundles are constructed and inserted sequentially, as neither the bundle
+ *        storage nor the bundle ids are thread safe.
+ */
+template <typename bundle_t, std::size_t Dim, typename storage_array_t, typename bundle_storage_t>
+inline void allocateBundles(const std::vector<std::array<int, Dim>> &indices,
+                            const storage_array_t                   &storages,
+                            bundle_storage_t                        &bundles)
+{
+    /// lookups are cheap, threads only pay off for larger chunks
+    static constexpr std::size_t MIN_BUNDLES_PER_THREAD = 4096;
+
+    std::vector<typename bundle_t::data_t> cells(indices.size());
+    cslibs_ndt::parallel(indices.size(), MIN_BUNDLES_PER_THREAD,
+                         [&indices, &storages, &cells](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin ; i < end ; ++i)
+            for (std::size_t j = 0 ; j < (1ul << Dim) ; ++j)
+                cells[i][j] = storages[j]->get(indices::storageIndex<Dim>(indices[i], j));
+    });
+
+    bundle_t b;
+    for (std::size_t i = 0 ; i < indices.size() ; ++i) {
+        for (std::size_t j = 0 ; j < (1ul << Dim) ; ++j)
+            b[j] = cells[i][j];
+        bundles.insert(indices[i], b);
+    }
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_BUNDLES_HPP
@@ -0,0 +1,106 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_CHUNK_HPP
+#define CSLIBS_NDT_SERIALIZATION_CHUNK_HPP
+
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/serialization/indices.hpp>
+#include <cslibs_ndt/serialization/storage.hpp>
+
+#include <array>
+#include <cstring>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * A set of bundles together with all distributions they refer to, e.g. a map tile or a journal entry:
+ *
+ *  | bundle indices : encoding (see indices.hpp) | per storage: uint64 count | (index, record)[count] |
+ */
+namespace chunk {
+/**
+ * @brief Append the given bundles of the map, bundles are sorted in Morton order.
+ */
+template <typename map_t, std::size_t Dim>
+inline bool encode(const map_t &map,
+                   std::vector<std::array<int, Dim>> bis,
+                   std::vector<char> &buffer)
+{
+    using index_t        = std::array<int, Dim>;
+    using index_set_t    = std::unordered_set<index_t, IndexHash<Dim>>;
+    using distribution_t = typename map_t::distribution_t;
+    using record_t       = cslibs_ndt::impl::Record<distribution_t>;
+
+    if (!indices::encode<Dim>(bis, buffer))
+        return false;
+
+    const std::size_t record_size = Dim * sizeof(int) + record_t::size;
+    for (std::size_t i = 0 ; i < (1ul << Dim) ; ++i) {
+        index_set_t written;
+        std::vector<std::pair<index_t, const distribution_t*>> cells;
+        for (const index_t &bi : bis) {
+            const distribution_t *d = map.getDistributionBundle(bi)->at(i);
+            const index_t index = indices::storageIndex<Dim>(bi, i);
+            if (d && written.insert(index).second)
+                cells.emplace_back(index, d);
+        }
+
+        const uint64_t count = cells.size();
+        std::size_t pos = buffer.size();
+        buffer.resize(pos + sizeof(uint64_t) + count * record_size);
+        std::memcpy(buffer.data() + pos, &count, sizeof(uint64_t));
+        pos += sizeof(uint64_t);
+        for (const auto &c : cells) {
+            std::memcpy(buffer.data() + pos, c.first.data(), Dim * sizeof(int));
+            record_t::encode(*(c.second), buffer.data() + pos + Dim * sizeof(int));
+            pos += record_size;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a chunk written by encode() into fresh storages, advances pos behind the chunk.
+ */
+template <typename map_t, std::size_t Dim>
+inline bool decode(const char *&pos,
+                   const char *end,
+                   std::vector<std::array<int, Dim>> &bis,
+                   typename map_t::distribution_storage_array_t &storages)
+{
+    using index_t                = std::array<int, Dim>;
+    using distribution_t         = typename map_t::distribution_t;
+    using distribution_storage_t = typename map_t::distribution_storage_t;
+    using record_t               = cslibs_ndt::impl::Record<distribution_t>;
+
+    if (!indices::decode<Dim>(pos, end, bis))
+        return false;
+
+    const std::size_t record_size = Dim * sizeof(int) + record_t::size;
+    for (std::size_t i = 0 ; i < (1ul << Dim) ; ++i) {
+        uint64_t count;
+        if (static_cast<std::size_t>(end - pos) < sizeof(uint64_t))
+            return false;
+        std::memcpy(&count, pos, sizeof(uint64_t));
+        pos += sizeof(uint64_t);
+        if (count > static_cast<uint64_t>(end - pos) / record_size)
+            return false;
+
+        storages[i].reset(new distribution_storage_t);
+        for (uint64_t j = 0 ; j < count ; ++j) {
+            index_t index;
+            distribution_t d;
+            std::memcpy(index.data(), pos, Dim * sizeof(int));
+            record_t::decode(pos + Dim * sizeof(int), d);
+            storages[i]->insert(index, d);
+            pos += record_size;
+        }
+    }
+    return true;
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_CHUNK_HPP
@@ -0,0 +1,319 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_INDICES_HPP
+#define CSLIBS_NDT_SERIALIZATION_INDICES_HPP
+
+#include <cslibs_ndt/common/index_hash.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Compact encoding of grid indices, no external compression involved:
+ *
+ *  | count : uint64 | min : int32[Dim] | Morton code deltas : varint[count] |
+ *
+ * Indices are shifted by the minimum index, interleaved to Morton codes and sorted,
+ * consecutive codes are stored as differences in LEB128 variable length encoding.
+ * Indices of neighbouring cells end up close to each other, so that most differences fit into a single byte.
+ */
+namespace indices {
+template<std::size_t Dim>
+struct Morton
+{
+    using index_t = std::array<int, Dim>;
+
+    /// bits per axis available in a 64 bit code
+    static constexpr std::size_t BITS = 64 / Dim;
+
+    static constexpr uint64_t maxExtent()
+    {
+        return BITS >= 32 ? static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) :
+                            (uint64_t(1) << BITS) - 1;
+    }
+
+    inline static uint64_t encode(const index_t &index,
+                                  const index_t &min)
+    {
+        uint64_t code = 0;
+        for (std::size_t i = 0 ; i < Dim ; ++i) {
+            const uint64_t c = static_cast<uint64_t>(static_cast<int64_t>(index[i]) - min[i]);
+            for (std::size_t b = 0 ; b < BITS ; ++b)
+                code |= ((c >> b) & 1ul) << (b * Dim + i);
+        }
+        return code;
+    }
+
+    inline static index_t decode(const uint64_t code,
+                                 const index_t &min)
+    {
+        index_t index;
+        for (std::size_t i = 0 ; i < Dim ; ++i) {
+            uint64_t c = 0;
+            for (std::size_t b = 0 ; b < BITS ; ++b)
+                c |= ((code >> (b * Dim + i)) & 1ul) << b;
+            index[i] = static_cast<int>(static_cast<int64_t>(min[i]) + static_cast<int64_t>(c));
+        }
+        return index;
+    }
+};
+
+template<std::size_t Dim>
+constexpr std::size_t Morton<Dim>::BITS;
+
+inline void writeVarint(uint64_t v,
+                        std::vector<char> &buffer)
+{
+    while (v >= 0x80) {
+        buffer.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    buffer.push_back(static_cast<char>(v));
+}
+
+inline bool readVarint(const char *&pos,
+                       const char *end,
+                       uint64_t &v)
+{
+    v = 0;
+    for (std::size_t shift = 0 ; pos < end && shift < 64 ; shift += 7) {
+        const uint8_t b = static_cast<uint8_t>(*pos++);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Sort the indices in Morton order and append their encoding to the buffer.
+ * @return false if the indices span more than a Morton code can represent
+ */
+template<std::size_t Dim>
+inline bool encode(std::vector<std::array<int, Dim>> &indices,
+                   std::vector<char> &buffer)
+{
+    using index_t  = std::array<int, Dim>;
+    using morton_t = Morton<Dim>;
+
+    index_t min;
+    index_t max;
+    min.fill(std::numeric_limits<int>::max());
+    max.fill(std::numeric_limits<int>::min());
+    for (const index_t &index : indices) {
+        for (std::size_t i = 0 ; i < Dim ; ++i) {
+            min[i] = std::min(min[i], index[i]);
+            max[i] = std::max(max[i], index[i]);
+        }
+    }
+    if (indices.empty())
+        min.fill(0);
+    for (std::size_t i = 0 ; i < Dim ; ++i) {
+        if (!indices.empty() &&
+                static_cast<uint64_t>(static_cast<int64_t>(max[i]) - min[i]) > morton_t::maxExtent()) {
+            std::cerr << "[Indices]: index range exceeds " << morton_t::BITS << " bits per axis\n";
+            return false;
+        }
+    }
+
+    std::vector<uint64_t> codes(indices.size());
+    for (std::size_t i = 0 ; i < indices.size() ; ++i)
+        codes[i] = morton_t::encode(indices[i], min);
+    std::sort(codes.begin(), codes.end());
+
+    const uint64_t count = codes.size();
+    const std::size_t header = sizeof(uint64_t) + Dim * sizeof(int32_t);
+    const std::size_t offset = buffer.size();
+    buffer.resize(offset + header);
+    std::memcpy(buffer.data() + offset, &count, sizeof(uint64_t));
+    for (std::size_t i = 0 ; i < Dim ; ++i) {
+        const int32_t m = min[i];
+        std::memcpy(buffer.data() + offset + sizeof(uint64_t) + i * sizeof(int32_t), &m, sizeof(int32_t));
+    }
+
+    buffer.reserve(buffer.size() + codes.size());
+    uint64_t last = 0;
+    for (std::size_t i = 0 ; i < codes.size() ; ++i) {
+        writeVarint(codes[i] - last, buffer);
+        last = codes[i];
+        indices[i] = morton_t::decode(codes[i], min);
+    }
+    return true;
+}
+
+/**
+ * @brief Decode indices written by encode(), advances pos behind the encoding.
+ */
+template<std::size_t Dim>
+inline bool decode(const char *&pos,
+                   const char *end,
+                   std::vector<std::array<int, Dim>> &indices)
+{
+    using index_t = std::array<int, Dim>;
+
+    const std::size_t header = sizeof(uint64_t) + Dim * sizeof(int32_t);
+    if (static_cast<std::size_t>(end - pos) < header)
+        return false;
+
+    uint64_t count;
+    index_t  min;
+    std::memcpy(&count, pos, sizeof(uint64_t));
+    for (std::size_t i = 0 ; i < Dim ; ++i) {
+        int32_t m;
+        std::memcpy(&m, pos + sizeof(uint64_t) + i * sizeof(int32_t), sizeof(int32_t));
+        min[i] = m;
+    }
+    pos += header;
+
+    /// every code takes at least one byte
+    if (count > static_cast<uint64_t>(end - pos))
+        return false;
+
+    indices.resize(count);
+    uint64_t code = 0;
+    for (uint64_t i = 0 ; i < count ; ++i) {
+        uint64_t delta;
+        if (!readVarint(pos, end, delta))
+            return false;
+        code += delta;
+        indices[i] = Morton<Dim>::decode(code, min);
+    }
+    return true;
+}
+
+/**
+ * @brief Index of the cell of the i-th storage, which is covered by the given bundle.
+ */
+template<std::size_t Dim>
+inline std::array<int, Dim> storageIndex(const std::array<int, Dim> &bi,
+                                         const std::size_t i)
+{
+    std::array<int, Dim> index;
+    for (std::size_t j = 0 ; j < Dim ; ++j) {
+        const int div = bi[j] >= 0 ? bi[j] / 2 : (bi[j] - 1) / 2;
+        const int mod = bi[j] - 2 * div;
+        index[j] = div + (((i >> j) & 1ul) ? mod : 0);
+    }
+    return index;
+}
+
+/**
+ * @brief All bundles, whose cells are all present in the storages given by their cell indices.
+ *        Every bundle covers a cell of the first storage, so these are the only candidates.
+ */
+template<std::size_t Dim>
+inline void derive(const std::array<std::vector<std::array<int, Dim>>, (1ul << Dim)> &cells,
+                   std::vector<std::array<int, Dim>> &bundles)
+{
+    using index_t = std::array<int, Dim>;
+    using set_t   = std::unordered_set<index_t, IndexHash<Dim>>;
+
+    std::array<set_t, (1ul << Dim)> sets;
+    for (std::size_t i = 1 ; i < (1ul << Dim) ; ++i)
+        sets[i].insert(cells[i].begin(), cells[i].end());
+
+    for (const index_t &c : cells[0]) {
+        for (std::size_t m = 0 ; m < (1ul << Dim) ; ++m) {
+            index_t bi;
+            for (std::size_t j = 0 ; j < Dim ; ++j)
+                bi[j] = 2 * c[j] + static_cast<int>((m >> j) & 1ul);
+
+            bool complete = true;
+            for (std::size_t i = 1 ; i < (1ul << Dim) && complete ; ++i)
+                complete = sets[i].count(storageIndex<Dim>(bi, i)) > 0;
+            if (complete)
+                bundles.emplace_back(bi);
+        }
+    }
+}
+
+/**
+ * @brief Bundle list stored relative to the bundles derivable from the storages:
+ *        | derivable, but not allocated : encoding | allocated, but not derivable : encoding |
+ *        Both are usually empty or tiny, so the bundle list is implicit.
+ */
+template<std::size_t Dim>
+inline bool saveBundles(const std::array<std::vector<std::array<int, Dim>>, (1ul << Dim)> &cells,
+                        const std::vector<std::array<int, Dim>> &bundles,
+                        const boost::filesystem::path &path)
+{
+    using index_t = std::array<int, Dim>;
+    using set_t   = std::unordered_set<index_t, IndexHash<Dim>>;
+
+    std::vector<index_t> derived;
+    derive<Dim>(cells, derived);
+
+    const set_t derived_set(derived.begin(), derived.end());
+    const set_t bundle_set(bundles.begin(), bundles.end());
+    std::vector<index_t> excluded;
+    std::vector<index_t> included;
+    for (const index_t &bi : derived)
+        if (bundle_set.count(bi) == 0)
+            excluded.emplace_back(bi);
+    for (const index_t &bi : bundles)
+        if (derived_set.count(bi) == 0)
+            included.emplace_back(bi);
+
+    std::vector<char> buffer;
+    if (!encode<Dim>(excluded, buffer) || !encode<Dim>(included, buffer))
+        return false;
+
+    std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Could not open '" << path.string() << "'\n";
+        return false;
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(out);
+}
+
+template<std::size_t Dim>
+inline bool loadBundles(const boost::filesystem::path &path,
+                        const std::array<std::vector<std::array<int, Dim>>, (1ul << Dim)> &cells,
+                        std::vector<std::array<int, Dim>> &bundles)
+{
+    using index_t = std::array<int, Dim>;
+    using set_t   = std::unordered_set<index_t, IndexHash<Dim>>;
+
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Could not open '" << path.string() << "'\n";
+        return false;
+    }
+    const std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<index_t> excluded;
+    std::vector<index_t> included;
+    const char *pos = buffer.data();
+    const char *end = buffer.data() + buffer.size();
+    if (!decode<Dim>(pos, end, excluded) || !decode<Dim>(pos, end, included) || pos != end) {
+        std::cerr << "Faild reading file '" << path.string() << "'\n";
+        return false;
+    }
+
+    std::vector<index_t> derived;
+    derive<Dim>(cells, derived);
+
+    const set_t excluded_set(excluded.begin(), excluded.end());
+    bundles.reserve(bundles.size() + derived.size() + included.size());
+    for (const index_t &bi : derived)
+        if (excluded_set.count(bi) == 0)
+            bundles.emplace_back(bi);
+    bundles.insert(bundles.end(), included.begin(), included.end());
+    return true;
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_INDICES_HPP
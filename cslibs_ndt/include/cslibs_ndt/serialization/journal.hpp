@@ -0,0 +1,373 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_JOURNAL_HPP
+#define CSLIBS_NDT_SERIALIZATION_JOURNAL_HPP
+
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/serialization/chunk.hpp>
+#include <cslibs_ndt/serialization/filesystem.hpp>
+
+#include <cslibs_math/serialization/array.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Journaled map layout, a snapshot of the whole map and an append-only journal of the bundles changed since:
+ *
+ *  journal.yaml : origin and resolution
+ *  snapshot.bin : | magic | generation : uint64 | all bundles : chunk (see chunk.hpp) |
+ *  journal.bin  : entries | magic | generation : uint64 | size : uint64 | changed bundles : chunk | checksum : uint64 |
+ *
+ * Checkpoints append the bundles allocated or updated since the last checkpoint, so their cost is proportional
+ * to the change volume. Compaction writes a fresh snapshot with the next generation and empties the journal,
+ * entries of another generation than the snapshot are left over by an interrupted compaction and ignored.
+ * A torn entry at the end of the journal, e.g. after a crash while appending, is dropped on restore.
+ * The journal keeps its own revision of the unsaved bundles of the map, other consumers like an
+ * asynchronous saver may save the same map.
+ */
+namespace journal {
+template <typename map_t, std::size_t Dim>
+class Journal
+{
+public:
+    using Ptr                          = std::shared_ptr<Journal>;
+    using index_t                      = std::array<int, Dim>;
+    using index_set_t                  = std::unordered_set<index_t, IndexHash<Dim>>;
+    using origin_t                     = std::array<double, 6>;
+    using distribution_t               = typename map_t::distribution_t;
+    using distribution_storage_array_t = typename map_t::distribution_storage_array_t;
+
+    /**
+     * @brief Start a journal with a snapshot of the map.
+     * @param origin            initial origin of the map, see encodeOrigin()
+     * @param compaction_ratio  a checkpoint compacts, once the journal would exceed the snapshot size times this ratio
+     */
+    inline static Ptr create(map_t &map,
+                             const origin_t &origin,
+                             const std::string &path,
+                             const double compaction_ratio = 1.0)
+    {
+        using path_t = boost::filesystem::path;
+
+        path_t path_root(path);
+        if (!cslibs_ndt::common::serialization::create_directory(path_root))
+            return Ptr();
+
+        {
+            std::ofstream out((path_root / path_t("journal.yaml")).string(), std::fstream::trunc);
+            YAML::Emitter yaml(out);
+            YAML::Node n;
+            n["origin"]     = origin;
+            n["resolution"] = map.getResolution();
+            yaml << n;
+            if (!out)
+                return Ptr();
+        }
+
+        Ptr journal(new Journal(path_root, origin, map.getResolution(), compaction_ratio));
+        return journal->compact(map) ? journal : Ptr();
+    }
+
+    /**
+     * @brief Open an existing journal, the map is recovered by restore().
+     */
+    inline static Ptr open(const std::string &path,
+                           const double compaction_ratio = 1.0)
+    {
+        using path_t = boost::filesystem::path;
+
+        path_t path_root(path);
+        if (!cslibs_ndt::common::serialization::check_directory(path_root) ||
+                !cslibs_ndt::common::serialization::check_file(path_root / path_t("journal.yaml")))
+            return Ptr();
+
+        YAML::Node n = YAML::LoadFile((path_root / path_t("journal.yaml")).string());
+        return Ptr(new Journal(path_root,
+                               n["origin"].as<origin_t>(),
+                               n["resolution"].as<double>(),
+                               compaction_ratio));
+    }
+
+    inline const origin_t& getOrigin() const
+    {
+        return origin_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline uint64_t getGeneration() const
+    {
+        return generation_;
+    }
+
+    inline std::size_t getSnapshotSize() const
+    {
+        return snapshot_size_;
+    }
+
+    inline std::size_t getJournalSize() const
+    {
+        return journal_size_;
+    }
+
+    /**
+     * @brief Revision of the unsaved bundles of the map covered by the journal, see getUnsavedBundles().
+     */
+    inline uint64_t getSavedRevision() const
+    {
+        return saved_revision_;
+    }
+
+    /**
+     * @brief Recover the map from the snapshot and the journal, the map should be empty.
+     */
+    inline bool restore(map_t &map)
+    {
+        std::vector<char> buffer;
+        if (!read(snapshotPath(), buffer))
+            return false;
+
+        const char *pos = buffer.data() + sizeof(SNAPSHOT_MAGIC) + sizeof(uint64_t);
+        const char *end = buffer.data() + buffer.size();
+        std::vector<index_t>         bis;
+        distribution_storage_array_t storages;
+        if (buffer.size() < sizeof(SNAPSHOT_MAGIC) + sizeof(uint64_t) ||
+                std::memcmp(buffer.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+                !chunk::decode<map_t, Dim>(pos, end, bis, storages) ||
+                pos != end) {
+            std::cerr << "Faild reading file '" << snapshotPath().string() << "'\n";
+            return false;
+        }
+        std::memcpy(&generation_, buffer.data() + sizeof(SNAPSHOT_MAGIC), sizeof(uint64_t));
+        snapshot_size_ = buffer.size();
+
+        index_set_t bundles(bis.begin(), bis.end());
+        journal_size_ = 0;
+        if (boost::filesystem::exists(journalPath())) {
+            if (!read(journalPath(), buffer))
+                return false;
+
+            const std::size_t header = sizeof(JOURNAL_MAGIC) + 2 * sizeof(uint64_t);
+            pos = buffer.data();
+            end = buffer.data() + buffer.size();
+            while (static_cast<std::size_t>(end - pos) >= header + sizeof(uint64_t)) {
+                uint64_t generation;
+                uint64_t size;
+                std::memcpy(&generation, pos + sizeof(JOURNAL_MAGIC), sizeof(uint64_t));
+                std::memcpy(&size, pos + sizeof(JOURNAL_MAGIC) + sizeof(uint64_t), sizeof(uint64_t));
+                if (std::memcmp(pos, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+                        generation != generation_ ||
+                        size > static_cast<uint64_t>(end - pos) - header - sizeof(uint64_t))
+                    break;
+
+                const char *entry = pos + header;
+                uint64_t sum;
+                std::memcpy(&sum, entry + size, sizeof(uint64_t));
+                std::vector<index_t>         entry_bis;
+                distribution_storage_array_t entry_storages;
+                if (sum != checksum(entry, size) ||
+                        !chunk::decode<map_t, Dim>(entry, entry + size, entry_bis, entry_storages) ||
+                        entry != pos + header + size)
+                    break;
+
+                /// newer distributions replace the ones of the snapshot and earlier entries
+                for (std::size_t i = 0 ; i < storages.size() ; ++i) {
+                    const auto &s = storages[i];
+                    entry_storages[i]->traverse([&s](const index_t &index, const distribution_t &d) {
+                        distribution_t *prev = s->get(index);
+                        if (prev)
+                            *prev = d;
+                        else
+                            s->insert(index, d);
+                    });
+                }
+                bundles.insert(entry_bis.begin(), entry_bis.end());
+                pos = entry + sizeof(uint64_t);
+            }
+
+            journal_size_ = static_cast<std::size_t>(pos - buffer.data());
+            if (journal_size_ != buffer.size()) {
+                std::cerr << "Dropping " << buffer.size() - journal_size_ << " bytes of incomplete or outdated entries of '"
+                          << journalPath().string() << "'\n";
+                boost::filesystem::resize_file(journalPath(), journal_size_);
+            }
+        }
+
+        map.insertBundles(std::vector<index_t>(bundles.begin(), bundles.end()), storages);
+        saved_revision_ = map.getUnsavedBundles(saved_revision_, bis);
+        return true;
+    }
+
+    /**
+     * @brief Append the bundles changed since the last checkpoint, compacts if the journal grew too large.
+     */
+    inline bool checkpoint(map_t &map)
+    {
+        if (!map.hasUnsavedBundles(saved_revision_))
+            return true;
+
+        std::vector<index_t> bis;
+        const uint64_t revision = map.getUnsavedBundles(saved_revision_, bis);
+
+        std::vector<char> buffer(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+        buffer.resize(buffer.size() + 2 * sizeof(uint64_t));
+        const std::size_t header = buffer.size();
+        if (!chunk::encode<map_t, Dim>(map, bis, buffer))
+            return false;
+
+        if (static_cast<double>(journal_size_ + buffer.size() + sizeof(uint64_t)) >
+                compaction_ratio_ * static_cast<double>(snapshot_size_))
+            return compact(map);
+
+        const uint64_t size = buffer.size() - header;
+        const uint64_t sum  = checksum(buffer.data() + header, size);
+        std::memcpy(buffer.data() + sizeof(JOURNAL_MAGIC), &generation_, sizeof(uint64_t));
+        std::memcpy(buffer.data() + sizeof(JOURNAL_MAGIC) + sizeof(uint64_t), &size, sizeof(uint64_t));
+        buffer.insert(buffer.end(), reinterpret_cast<const char*>(&sum), reinterpret_cast<const char*>(&sum) + sizeof(uint64_t));
+
+        std::ofstream out(journalPath().string(), std::ios::binary | std::ios::app);
+        if (!out.is_open()) {
+            std::cerr << "Could not open '" << journalPath().string() << "'\n";
+            return false;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        out.flush();
+        if (!out)
+            return false;
+
+        journal_size_  += buffer.size();
+        saved_revision_ = revision;
+        return true;
+    }
+
+    /**
+     * @brief Replace the snapshot by the current map and empty the journal.
+     */
+    inline bool compact(map_t &map)
+    {
+        using path_t = boost::filesystem::path;
+
+        const uint64_t generation = generation_ + 1;
+        std::vector<char> buffer(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+        buffer.insert(buffer.end(), reinterpret_cast<const char*>(&generation), reinterpret_cast<const char*>(&generation) + sizeof(uint64_t));
+
+        std::vector<index_t> bis;
+        const uint64_t revision = map.getUnsavedBundles(saved_revision_, bis);
+        bis.clear();
+        map.getBundleIndices(bis);
+        if (!chunk::encode<map_t, Dim>(map, bis, buffer))
+            return false;
+
+        /// the snapshot is replaced atomically, entries of the old generation are ignored until the journal is emptied
+        const path_t tmp = path_ / path_t("snapshot.bin.tmp");
+        {
+            std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Could not open '" << tmp.string() << "'\n";
+                return false;
+            }
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            out.flush();
+            if (!out)
+                return false;
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp, snapshotPath(), ec);
+        if (ec) {
+            std::cerr << "Could not replace '" << snapshotPath().string() << "': " << ec.message() << "\n";
+            return false;
+        }
+        std::ofstream(journalPath().string(), std::ios::binary | std::ios::trunc);
+
+        generation_     = generation;
+        snapshot_size_  = buffer.size();
+        journal_size_   = 0;
+        saved_revision_ = revision;
+        return true;
+    }
+
+private:
+    static constexpr char SNAPSHOT_MAGIC[8] = {'C', 'S', 'N', 'D', 'T', 'S', 'N', 'P'};
+    static constexpr char JOURNAL_MAGIC[8]  = {'C', 'S', 'N', 'D', 'T', 'J', 'R', 'N'};
+
+    const boost::filesystem::path path_;
+    const origin_t                origin_;
+    const double                  resolution_;
+    const double                  compaction_ratio_;
+    uint64_t                      generation_;
+    std::size_t                   snapshot_size_;
+    std::size_t                   journal_size_;
+    uint64_t                      saved_revision_;
+
+    inline Journal(const boost::filesystem::path &path,
+                   const origin_t &origin,
+                   const double resolution,
+                   const double compaction_ratio) :
+        path_(path),
+        origin_(origin),
+        resolution_(resolution),
+        compaction_ratio_(compaction_ratio),
+        generation_(0),
+        snapshot_size_(0),
+        journal_size_(0),
+        saved_revision_(0)
+    {
+    }
+
+    inline boost::filesystem::path snapshotPath() const
+    {
+        return path_ / boost::filesystem::path("snapshot.bin");
+    }
+
+    inline boost::filesystem::path journalPath() const
+    {
+        return path_ / boost::filesystem::path("journal.bin");
+    }
+
+    inline static bool read(const boost::filesystem::path &path,
+                            std::vector<char> &buffer)
+    {
+        std::ifstream in(path.string(), std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Could not open '" << path.string() << "'\n";
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    /// FNV-1a
+    inline static uint64_t checksum(const char *data,
+                                    const std::size_t size)
+    {
+        uint64_t h = 14695981039346656037ul;
+        for (std::size_t i = 0 ; i < size ; ++i) {
+            h ^= static_cast<uint8_t>(data[i]);
+            h *= 1099511628211ul;
+        }
+        return h;
+    }
+};
+
+template <typename map_t, std::size_t Dim>
+constexpr char Journal<map_t, Dim>::SNAPSHOT_MAGIC[8];
+template <typename map_t, std::size_t Dim>
+constexpr char Journal<map_t, Dim>::JOURNAL_MAGIC[8];
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_JOURNAL_HPP
@@ -0,0 +1,205 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_LAZY_MAP_HPP
+#define CSLIBS_NDT_SERIALIZATION_LAZY_MAP_HPP
+
+#include <cslibs_ndt/serialization/bundles.hpp>
+#include <cslibs_ndt/serialization/filesystem.hpp>
+#include <cslibs_ndt/serialization/indices.hpp>
+
+#include <array>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * @brief Dynamic map written by saveBinary(), of which only the meta data is read when opening.
+ *        Each storage file is read on first access by getStorage() or in the background after
+ *        prefetch(), the map itself is assembled by getMap() once all storages are read.
+ *
+ * Storages are shared with the map returned by getMap() and must not be modified before.
+ */
+template <typename map_t, typename binary_t, std::size_t Dim>
+class LazyMap
+{
+public:
+    using Ptr                          = std::shared_ptr<LazyMap>;
+    using map_ptr_t                    = typename map_t::Ptr;
+    using pose_t                       = typename map_t::pose_t;
+    using index_t                      = std::array<int, Dim>;
+    using distribution_storage_ptr_t   = typename map_t::distribution_storage_ptr_t;
+    using distribution_storage_array_t = typename map_t::distribution_storage_array_t;
+    using bundle_storage_t             = typename map_t::distribution_bundle_storage_t;
+    using bundle_t                     = typename map_t::distribution_bundle_t;
+
+    static constexpr std::size_t NUM_STORAGES = 1ul << Dim;
+
+    /**
+     * @brief Check the storage files, nothing is read yet.
+     * @param bundles   bundle indices from the meta data, empty for the compact encoding
+     */
+    inline static Ptr open(const boost::filesystem::path &path_root,
+                           const pose_t &origin,
+                           const double resolution,
+                           const index_t &min_index,
+                           const index_t &max_index,
+                           const bool compact,
+                           const std::vector<index_t> &bundles)
+    {
+        std::array<boost::filesystem::path, NUM_STORAGES> paths;
+        for (std::size_t i = 0 ; i < NUM_STORAGES ; ++i) {
+            paths[i] = path_root / boost::filesystem::path("store_" + std::to_string(i) + ".bin");
+            if (!cslibs_ndt::common::serialization::check_file(paths[i]))
+                return Ptr();
+        }
+        return Ptr(new LazyMap(path_root, paths, origin, resolution, min_index, max_index, compact, bundles));
+    }
+
+    LazyMap(const LazyMap &other) = delete;
+    LazyMap& operator = (const LazyMap &other) = delete;
+
+    inline virtual ~LazyMap()
+    {
+        /// background reads refer to this, deferred ones were never started
+        for (const auto &l : loads_)
+            if (l.valid() && l.wait_for(std::chrono::seconds(0)) != std::future_status::deferred)
+                l.wait();
+    }
+
+    inline const pose_t& getInitialOrigin() const
+    {
+        return origin_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline const index_t& getMinBundleIndex() const
+    {
+        return min_index_;
+    }
+
+    inline const index_t& getMaxBundleIndex() const
+    {
+        return max_index_;
+    }
+
+    /**
+     * @brief Read all storages not requested yet in background threads.
+     */
+    inline void prefetch()
+    {
+        for (std::size_t i = 0 ; i < NUM_STORAGES ; ++i)
+            request(i, std::launch::async);
+    }
+
+    inline bool isLoaded(const std::size_t i) const
+    {
+        lock_t l(mutex_);
+        return loads_[i].valid() && loads_[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /**
+     * @brief The i-th storage, read now unless prefetched, can be called from any thread.
+     * @return nullptr if the storage could not be read
+     */
+    inline distribution_storage_ptr_t getStorage(const std::size_t i)
+    {
+        return request(i, std::launch::deferred).get() ? storages_[i] : distribution_storage_ptr_t();
+    }
+
+    /**
+     * @brief Read the remaining storages in parallel and assemble the map, to be called by
+     *        the thread owning the map as bundles are allocated.
+     * @return nullptr if a storage could not be read
+     */
+    inline map_ptr_t getMap()
+    {
+        if (map_)
+            return map_;
+
+        prefetch();
+        distribution_storage_array_t storages;
+        for (std::size_t i = 0 ; i < NUM_STORAGES ; ++i) {
+            storages[i] = getStorage(i);
+            if (!storages[i])
+                return map_ptr_t();
+        }
+
+        std::vector<index_t> bundles = bundles_;
+        if (compact_ && !indices::loadBundles<Dim>(path_root_ / boost::filesystem::path("bundles.bin"), cells_, bundles))
+            return map_ptr_t();
+
+        std::shared_ptr<bundle_storage_t> bundle_storage(new bundle_storage_t);
+        allocateBundles<bundle_t>(bundles, storages, *bundle_storage);
+
+        map_.reset(new map_t(origin_, resolution_, min_index_, max_index_, bundle_storage, storages));
+        bundles_.clear();
+        for (auto &c : cells_)
+            std::vector<index_t>().swap(c);
+        return map_;
+    }
+
+private:
+    using mutex_t = std::mutex;
+    using lock_t  = std::unique_lock<mutex_t>;
+
+    const boost::filesystem::path                           path_root_;
+    const std::array<boost::filesystem::path, NUM_STORAGES> paths_;
+    const pose_t                                            origin_;
+    const double                                            resolution_;
+    const index_t                                           min_index_;
+    const index_t                                           max_index_;
+    const bool                                              compact_;
+    std::vector<index_t>                                    bundles_;
+
+    mutable mutex_t                                         mutex_;
+    std::array<std::shared_future<bool>, NUM_STORAGES>      loads_;
+    distribution_storage_array_t                            storages_;
+    std::array<std::vector<index_t>, NUM_STORAGES>          cells_;
+    map_ptr_t                                               map_;
+
+    inline LazyMap(const boost::filesystem::path &path_root,
+                   const std::array<boost::filesystem::path, NUM_STORAGES> &paths,
+                   const pose_t &origin,
+                   const double resolution,
+                   const index_t &min_index,
+                   const index_t &max_index,
+                   const bool compact,
+                   const std::vector<index_t> &bundles) :
+        path_root_(path_root),
+        paths_(paths),
+        origin_(origin),
+        resolution_(resolution),
+        min_index_(min_index),
+        max_index_(max_index),
+        compact_(compact),
+        bundles_(bundles)
+    {
+    }
+
+    /// storages_[i] and cells_[i] are only written by the i-th read, and read after waiting for it
+    inline std::shared_future<bool> request(const std::size_t i,
+                                            const std::launch policy)
+    {
+        lock_t l(mutex_);
+        if (!loads_[i].valid())
+            loads_[i] = std::async(policy, [this, i]() -> bool {
+                return compact_ ? binary_t::loadCompact(paths_[i], storages_[i], cells_[i]) :
+                                  binary_t::load(paths_[i], storages_[i]);
+            }).share();
+        return loads_[i];
+    }
+};
+
+template <typename map_t, typename binary_t, std::size_t Dim>
+constexpr std::size_t LazyMap<map_t, binary_t, Dim>::NUM_STORAGES;
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_LAZY_MAP_HPP
@@ -0,0 +1,629 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_MAP_FILE_HPP
+#define CSLIBS_NDT_SERIALIZATION_MAP_FILE_HPP
+
+#include <cslibs_ndt/common/distribution.hpp>
+#include <cslibs_ndt/common/occupancy_distribution.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Single file map format, which can be memory mapped and served without deserialization:
+ *
+ *  | Header | Bundle records, sorted by index | Cell records of storage 0, sorted by index | ... | storage 2^Dim - 1 |
+ *
+ * All records are plain data in native byte order with a size divisible by 8, sections
+ * are aligned accordingly. Bundle records refer to their cells by slot in the storage sections,
+ * cell records carry the moments for decoding as well as the information matrix and normalizer
+ * for sampling.
+ */
+namespace map_file {
+static constexpr uint32_t VERSION    = 1;
+static constexpr uint32_t ENDIANNESS = 0x01020304;
+static constexpr uint32_t NO_SLOT    = 0xFFFFFFFF;
+
+enum MapType : uint32_t { GRIDMAP = 0, OCCUPANCY_GRIDMAP = 1 };
+
+inline const char* magic()
+{
+    return "CSNDTMAP";
+}
+
+struct Header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t dim;
+    uint32_t map_type;
+    double   resolution;
+    double   origin[6];         /// 2D: x, y, yaw - 3D: x, y, z, roll, pitch, yaw
+    int32_t  min_index[4];
+    int32_t  max_index[4];
+    uint64_t bundle_count;
+    uint64_t bundle_offset;
+    uint64_t cell_count[8];
+    uint64_t cell_offset[8];
+    uint64_t file_size;
+};
+
+template<std::size_t Dim>
+struct Cell
+{
+    int32_t  index[4];
+    uint64_t n;
+    uint64_t n_free;            /// free observations of occupancy maps
+    double   mean[Dim];
+    double   correlated[Dim * Dim];
+    double   information[Dim * Dim];
+    double   normalizer;        /// zero if the distribution cannot be sampled, i.e. n < 3
+};
+
+template<std::size_t Dim>
+struct Bundle
+{
+    int32_t  index[4];
+    uint32_t cells[1 << Dim];   /// slot per storage, NO_SLOT if not allocated
+};
+
+static_assert(sizeof(Header)    % 8 == 0, "header size must be a multiple of 8");
+static_assert(sizeof(Cell<2>)   % 8 == 0, "cell size must be a multiple of 8");
+static_assert(sizeof(Cell<3>)   % 8 == 0, "cell size must be a multiple of 8");
+static_assert(sizeof(Bundle<2>) % 8 == 0, "bundle size must be a multiple of 8");
+static_assert(sizeof(Bundle<3>) % 8 == 0, "bundle size must be a multiple of 8");
+static_assert(std::is_trivially_copyable<Cell<3>>::value, "cells must be plain data");
+
+template<std::size_t Dim>
+inline void setIndex(const std::array<int, Dim> &index, int32_t (&dst)[4])
+{
+    std::fill(dst, dst + 4, 0);
+    std::copy(index.begin(), index.end(), dst);
+}
+
+template<std::size_t Dim>
+inline std::array<int, Dim> getIndex(const int32_t (&src)[4])
+{
+    std::array<int, Dim> index;
+    std::copy(src, src + Dim, index.begin());
+    return index;
+}
+
+template<std::size_t Dim>
+inline void encode(const cslibs_math::statistics::Distribution<Dim, 3> &d,
+                   Cell<Dim> &c)
+{
+    using sample_t     = typename cslibs_math::statistics::Distribution<Dim, 3>::sample_t;
+    using covariance_t = typename cslibs_math::statistics::Distribution<Dim, 3>::covariance_t;
+
+    c.n = d.getN();
+    Eigen::Map<sample_t>(c.mean)           = d.getMean();
+    Eigen::Map<covariance_t>(c.correlated) = d.getCorrelated();
+    if (c.n >= 3) {
+        const covariance_t information = d.getInformationMatrix();
+        Eigen::Map<covariance_t>(c.information) = information;
+        c.normalizer = std::sqrt(information.determinant() / std::pow(2.0 * M_PI, static_cast<double>(Dim)));
+    } else {
+        Eigen::Map<covariance_t>(c.information).setZero();
+        c.normalizer = 0.0;
+    }
+}
+
+template<std::size_t Dim>
+inline void encode(const Distribution<Dim> &d,
+                   Cell<Dim> &c)
+{
+    c.n_free = 0;
+    encode(d.data(), c);
+}
+
+template<std::size_t Dim>
+inline void encode(const OccupancyDistribution<Dim> &d,
+                   Cell<Dim> &c)
+{
+    if (d.getDistribution())
+        encode(*d.getDistribution(), c);
+    else
+        encode(cslibs_math::statistics::Distribution<Dim, 3>(), c);
+    c.n      = d.numOccupied();
+    c.n_free = d.numFree();
+}
+
+template<std::size_t Dim>
+inline cslibs_math::statistics::Distribution<Dim, 3> decode(const Cell<Dim> &c)
+{
+    using distribution_t = cslibs_math::statistics::Distribution<Dim, 3>;
+    using sample_t       = typename distribution_t::sample_t;
+    using covariance_t   = typename distribution_t::covariance_t;
+
+    return distribution_t(static_cast<std::size_t>(c.n),
+                          sample_t(Eigen::Map<const sample_t>(c.mean)),
+                          covariance_t(Eigen::Map<const covariance_t>(c.correlated)));
+}
+
+template<std::size_t Dim>
+inline void decode(const Cell<Dim> &c,
+                   Distribution<Dim> &d)
+{
+    d.data() = decode(c);
+}
+
+template<std::size_t Dim>
+inline void decode(const Cell<Dim> &c,
+                   OccupancyDistribution<Dim> &d)
+{
+    d = c.n > 0 ? OccupancyDistribution<Dim>(static_cast<std::size_t>(c.n_free), decode(c)) :
+                  OccupancyDistribution<Dim>(static_cast<std::size_t>(c.n_free));
+}
+
+/**
+ * @brief Encode a dynamic map, the layout is computed before anything is written.
+ * @param map       map providing getStorages(), getBundleIndices() and get(bundle_index)
+ * @param origin    initial origin, see Header
+ * @param name      file or segment name for error messages
+ * @param open      called with the total size in bytes, returns the stream to write to or nullptr
+ */
+template<std::size_t Dim, typename map_t, typename Open>
+inline bool write(const map_t &map,
+                  const MapType type,
+                  const std::array<double, 6> &origin,
+                  const std::string &name,
+                  const Open &open)
+{
+    using index_t        = std::array<int, Dim>;
+    using data_t         = typename map_t::distribution_t;
+    using cell_t         = Cell<Dim>;
+    using bundle_t       = Bundle<Dim>;
+    using cell_ref_t     = std::pair<index_t, const data_t*>;
+    static constexpr std::size_t STORAGES = 1 << Dim;
+
+    /// cells sorted by index, slots are resolved through the distribution addresses held by the bundles
+    const auto &storages = map.getStorages();
+    std::array<std::vector<cell_ref_t>, STORAGES>                         cells;
+    std::array<std::unordered_map<const data_t*, uint32_t>, STORAGES>     slots;
+    for (std::size_t s = 0 ; s < STORAGES ; ++s) {
+        storages[s]->traverse([&cells, s](const index_t &i, const data_t &d) {
+            cells[s].emplace_back(i, &d);
+        });
+        if (cells[s].size() >= NO_SLOT) {
+            std::cerr << "Too many cells for '" << name << "'\n";
+            return false;
+        }
+        std::sort(cells[s].begin(), cells[s].end(), [](const cell_ref_t &a, const cell_ref_t &b) {
+            return a.first < b.first;
+        });
+        slots[s].reserve(cells[s].size());
+        for (std::size_t i = 0 ; i < cells[s].size() ; ++i)
+            slots[s][cells[s][i].second] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<index_t> bundles;
+    map.getBundleIndices(bundles);
+    std::sort(bundles.begin(), bundles.end());
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, magic(), sizeof(header.magic));
+    header.version      = VERSION;
+    header.byte_order   = ENDIANNESS;
+    header.dim          = static_cast<uint32_t>(Dim);
+    header.map_type     = type;
+    header.resolution   = map.getResolution();
+    std::copy(origin.begin(), origin.end(), header.origin);
+    setIndex<Dim>(map.getMinBundleIndex(), header.min_index);
+    setIndex<Dim>(map.getMaxBundleIndex(), header.max_index);
+    header.bundle_count  = bundles.size();
+    header.bundle_offset = sizeof(Header);
+    uint64_t offset = header.bundle_offset + header.bundle_count * sizeof(bundle_t);
+    for (std::size_t s = 0 ; s < STORAGES ; ++s) {
+        header.cell_count[s]  = cells[s].size();
+        header.cell_offset[s] = offset;
+        offset += header.cell_count[s] * sizeof(cell_t);
+    }
+    header.file_size = offset;
+
+    std::ostream *stream = open(header.file_size);
+    if (!stream)
+        return false;
+    std::ostream &out = *stream;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+    /// records are written in blocks to keep the number of stream calls low
+    static constexpr std::size_t BLOCK_SIZE = 4096;
+    std::vector<bundle_t> bundle_block;
+    bundle_block.reserve(BLOCK_SIZE);
+    auto flush_bundles = [&out, &bundle_block]() {
+        out.write(reinterpret_cast<const char*>(bundle_block.data()), bundle_block.size() * sizeof(bundle_t));
+        bundle_block.clear();
+    };
+    for (const index_t &bi : bundles) {
+        const auto *b = map.get(bi);
+        bundle_t r;
+        setIndex<Dim>(bi, r.index);
+        for (std::size_t s = 0 ; s < STORAGES ; ++s) {
+            const auto slot = b && b->at(s) ? slots[s].find(b->at(s)) : slots[s].end();
+            r.cells[s] = slot != slots[s].end() ? slot->second : NO_SLOT;
+        }
+        bundle_block.emplace_back(r);
+        if (bundle_block.size() == BLOCK_SIZE)
+            flush_bundles();
+    }
+    flush_bundles();
+
+    std::vector<cell_t> cell_block;
+    cell_block.reserve(BLOCK_SIZE);
+    auto flush_cells = [&out, &cell_block]() {
+        out.write(reinterpret_cast<const char*>(cell_block.data()), cell_block.size() * sizeof(cell_t));
+        cell_block.clear();
+    };
+    for (std::size_t s = 0 ; s < STORAGES ; ++s) {
+        for (const cell_ref_t &c : cells[s]) {
+            cell_t r;
+            std::memset(&r, 0, sizeof(cell_t));
+            setIndex<Dim>(c.first, r.index);
+            encode(*c.second, r);
+            cell_block.emplace_back(r);
+            if (cell_block.size() == BLOCK_SIZE)
+                flush_cells();
+        }
+        flush_cells();
+    }
+
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed writing '" << name << "'\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write a dynamic map into a single file.
+ * @param map       map providing getStorages(), getBundleIndices() and get(bundle_index)
+ * @param origin    initial origin, see Header
+ */
+template<std::size_t Dim, typename map_t>
+inline bool save(const map_t &map,
+                 const MapType type,
+                 const std::array<double, 6> &origin,
+                 const std::string &path)
+{
+    std::ofstream out;
+    const bool success = write<Dim>(map, type, origin, path, [&out, &path](const uint64_t) -> std::ostream* {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Could not open '" << path << "'\n";
+            return nullptr;
+        }
+        return &out;
+    });
+    out.close();
+    if (success && !out) {
+        std::cerr << "Failed writing '" << path << "'\n";
+        return false;
+    }
+    return success;
+}
+
+/**
+ * @brief Read only memory mapping of a file, unmapped on destruction.
+ */
+class MappedFile
+{
+public:
+    using Ptr = std::shared_ptr<MappedFile>;
+
+    inline static Ptr open(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Could not open '" << path << "'\n";
+            return nullptr;
+        }
+        return map(fd, path);
+    }
+
+    /**
+     * @brief Map a POSIX shared memory segment read only, see shm_open().
+     */
+    inline static Ptr openShared(const std::string &name)
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            std::cerr << "Could not open shared memory '" << name << "'\n";
+            return nullptr;
+        }
+        return map(fd, name);
+    }
+
+    inline virtual ~MappedFile()
+    {
+        ::munmap(data_, size_);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator = (const MappedFile &) = delete;
+
+    inline const char* data() const
+    {
+        return static_cast<const char*>(data_);
+    }
+
+    inline std::size_t size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Map an open file descriptor, which is closed afterwards.
+     * @param path  name for error messages
+     */
+    inline static Ptr map(const int fd,
+                          const std::string &path)
+    {
+        struct stat s;
+        if (::fstat(fd, &s) != 0 || s.st_size <= 0) {
+            std::cerr << "Could not stat '" << path << "'\n";
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *data = ::mmap(nullptr, static_cast<std::size_t>(s.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            std::cerr << "Could not map '" << path << "'\n";
+            return nullptr;
+        }
+        return Ptr(new MappedFile(data, static_cast<std::size_t>(s.st_size)));
+    }
+
+private:
+    inline MappedFile(void *data, const std::size_t size) :
+        data_(data),
+        size_(size)
+    {
+    }
+
+    void        *data_;
+    std::size_t  size_;
+};
+
+/**
+ * @brief Read only view of a mapped map file. Records are accessed in place, nothing is
+ *        decoded when opening, the operating system pages in what is actually accessed.
+ */
+template<std::size_t Dim>
+class MappedMap
+{
+public:
+    using Ptr      = std::shared_ptr<MappedMap<Dim>>;
+    using ConstPtr = std::shared_ptr<const MappedMap<Dim>>;
+    using index_t  = std::array<int, Dim>;
+    using cell_t   = Cell<Dim>;
+    using bundle_t = Bundle<Dim>;
+
+    static constexpr std::size_t STORAGES = 1 << Dim;
+
+    /**
+     * @brief Map a file and check its header.
+     * @return nullptr if the file cannot be mapped or does not contain a map of the given type
+     */
+    inline static Ptr open(const std::string &path,
+                           const MapType type)
+    {
+        return open(MappedFile::open(path), type, path);
+    }
+
+    /**
+     * @brief Check the header of a mapped file or shared memory segment.
+     * @param path  name for error messages
+     */
+    inline static Ptr open(const MappedFile::Ptr &file,
+                           const MapType type,
+                           const std::string &path)
+    {
+        if (!file)
+            return nullptr;
+
+        auto fail = [&path](const std::string &reason) {
+            std::cerr << "Invalid map file '" << path << "': " << reason << "\n";
+            return nullptr;
+        };
+        if (file->size() < sizeof(Header))
+            return fail("truncated header");
+
+        const Header &header = *reinterpret_cast<const Header*>(file->data());
+        if (std::memcmp(header.magic, magic(), sizeof(header.magic)) != 0)
+            return fail("unknown format");
+        if (header.version != VERSION)
+            return fail("unsupported version " + std::to_string(header.version));
+        if (header.byte_order != ENDIANNESS)
+            return fail("byte order mismatch");
+        if (header.dim != Dim || header.map_type != type)
+            return fail("map type mismatch");
+        if (header.file_size > file->size())
+            return fail("truncated file");
+
+        auto in_file = [&header](const uint64_t offset, const uint64_t count, const std::size_t size) {
+            return offset % 8 == 0 && offset <= header.file_size &&
+                   count <= (header.file_size - offset) / size;
+        };
+        if (!in_file(header.bundle_offset, header.bundle_count, sizeof(bundle_t)))
+            return fail("bundles out of range");
+        for (std::size_t s = 0 ; s < STORAGES ; ++s)
+            if (!in_file(header.cell_offset[s], header.cell_count[s], sizeof(cell_t)))
+                return fail("cells out of range");
+
+        return Ptr(new MappedMap(file));
+    }
+
+    inline const Header& getHeader() const
+    {
+        return *header_;
+    }
+
+    inline std::size_t getBundleCount() const
+    {
+        return static_cast<std::size_t>(header_->bundle_count);
+    }
+
+    inline std::size_t getCellCount(const std::size_t storage) const
+    {
+        return static_cast<std::size_t>(header_->cell_count[storage]);
+    }
+
+    inline index_t getMinBundleIndex() const
+    {
+        return getIndex<Dim>(header_->min_index);
+    }
+
+    inline index_t getMaxBundleIndex() const
+    {
+        return getIndex<Dim>(header_->max_index);
+    }
+
+    /**
+     * @brief Look up a bundle by binary search over the sorted records.
+     * @return nullptr if the bundle is not allocated
+     */
+    inline const bundle_t* getBundle(const index_t &bi) const
+    {
+        const bundle_t *end = bundles_ + header_->bundle_count;
+        const bundle_t *b   = std::lower_bound(bundles_, end, bi, [](const bundle_t &r, const index_t &i) {
+            return getIndex<Dim>(r.index) < i;
+        });
+        return (b != end && getIndex<Dim>(b->index) == bi) ? b : nullptr;
+    }
+
+    inline const cell_t* getCell(const bundle_t &b,
+                                 const std::size_t storage) const
+    {
+        const uint32_t slot = b.cells[storage];
+        return slot != NO_SLOT && slot < header_->cell_count[storage] ? cells_[storage] + slot : nullptr;
+    }
+
+    inline const cell_t* getCells(const std::size_t storage) const
+    {
+        return cells_[storage];
+    }
+
+    template<typename Fn>
+    inline void traverse(const Fn &function) const
+    {
+        for (const bundle_t *b = bundles_, *end = bundles_ + header_->bundle_count ; b != end ; ++b)
+            function(getIndex<Dim>(b->index), *b);
+    }
+
+    /**
+     * @brief Evaluate the gaussian of a cell like cslibs_math::statistics::Distribution::sampleNonNormalized(),
+     *        i.e. zero for less than three samples.
+     */
+    template<typename point_t>
+    inline static double sampleNonNormalized(const cell_t &c,
+                                             const point_t &p)
+    {
+        if (c.normalizer == 0.0)
+            return 0.0;
+
+        double q[Dim];
+        for (std::size_t i = 0 ; i < Dim ; ++i)
+            q[i] = p(i) - c.mean[i];
+        double exponent = 0.0;
+        for (std::size_t i = 0 ; i < Dim ; ++i)
+            for (std::size_t j = 0 ; j < Dim ; ++j)
+                exponent += q[i] * c.information[j * Dim + i] * q[j];
+        return std::exp(-0.5 * exponent);
+    }
+
+    template<typename point_t>
+    inline static double sample(const cell_t &c,
+                                const point_t &p)
+    {
+        return c.normalizer * sampleNonNormalized(c, p);
+    }
+
+    /**
+     * @brief Occupancy of a cell like cslibs_ndt::OccupancyDistribution::getOccupancy().
+     */
+    inline static double getOccupancy(const cell_t &c,
+                                      const cslibs_gridmaps::utility::InverseModel &inverse_model)
+    {
+        const double n_free = static_cast<double>(c.n_free);
+        const double n      = static_cast<double>(c.n);
+        return cslibs_math::common::LogOdds::from(n_free * inverse_model.getLogOddsFree() +
+                                                  n * inverse_model.getLogOddsOccupied() -
+                                                  (n_free + n) * inverse_model.getLogOddsPrior());
+    }
+
+    /**
+     * @brief Decode all cells into storages and rebuild the bundles from the stored slots, e.g. to continue mapping.
+     * @param storages  storages of a dynamic map, reset and filled
+     * @param bundles   bundle storage of a dynamic map, filled
+     */
+    template<typename map_t>
+    inline void decode(typename map_t::distribution_storage_array_t      &storages,
+                       typename map_t::distribution_bundle_storage_ptr_t &bundles) const
+    {
+        using data_t    = typename map_t::distribution_t;
+        using storage_t = typename map_t::distribution_storage_t;
+        using db_t      = typename map_t::distribution_bundle_t;
+
+        std::array<std::vector<data_t*>, STORAGES> slots;
+        for (std::size_t s = 0 ; s < STORAGES ; ++s) {
+            storages[s].reset(new storage_t);
+            slots[s].resize(getCellCount(s));
+            const cell_t *c = cells_[s];
+            for (std::size_t i = 0 ; i < slots[s].size() ; ++i, ++c) {
+                data_t d;
+                map_file::decode(*c, d);
+                slots[s][i] = &(storages[s]->insert(getIndex<Dim>(c->index), d));
+            }
+        }
+
+        traverse([&bundles, &slots](const index_t &bi, const bundle_t &r) {
+            db_t b;
+            for (std::size_t s = 0 ; s < STORAGES ; ++s)
+                b[s] = r.cells[s] < slots[s].size() ? slots[s][r.cells[s]] : nullptr;
+            bundles->insert(bi, b);
+        });
+    }
+
+private:
+    inline explicit MappedMap(const MappedFile::Ptr &file) :
+        file_(file),
+        header_(reinterpret_cast<const Header*>(file->data())),
+        bundles_(reinterpret_cast<const bundle_t*>(file->data() + header_->bundle_offset))
+    {
+        for (std::size_t s = 0 ; s < STORAGES ; ++s)
+            cells_[s] = reinterpret_cast<const cell_t*>(file->data() + header_->cell_offset[s]);
+    }
+
+    MappedFile::Ptr                         file_;
+    const Header                           *header_;
+    const bundle_t                         *bundles_;
+    std::array<const cell_t*, STORAGES>     cells_;
+};
+
+template<std::size_t Dim>
+constexpr std::size_t MappedMap<Dim>::STORAGES;
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_MAP_FILE_HPP
@@ -0,0 +1,441 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_POINTCLOUD_HPP
+#define CSLIBS_NDT_SERIALIZATION_POINTCLOUD_HPP
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Streaming readers for point clouds on disk, points are read in chunks of bounded size:
+ *
+ *  .ply       : binary PLY, little or big endian, x, y and z of the vertex element, which must come first
+ *  .pcd       : PCD with binary data, x, y and z fields of any numeric type
+ *  .bin, .xyz : raw float32 x, y, z triples in native byte order
+ *
+ * Points with a NaN or infinite coordinate, e.g. invalid returns of organized clouds, are skipped.
+ */
+namespace pointcloud {
+/// coordinates are decoded in double precision, float would round georeferenced clouds to decimeters
+using point_t = std::array<double, 3>;
+
+/**
+ * @brief Reads the xyz coordinates of fixed size records following a header.
+ */
+class Reader
+{
+public:
+    using Ptr = std::shared_ptr<Reader>;
+
+    enum Type { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+    struct Field
+    {
+        std::size_t offset;
+        Type        type;
+    };
+
+    /**
+     * @brief Open a file by its extension.
+     * @return nullptr for unknown extensions, use openRaw() for raw files named otherwise
+     */
+    inline static Ptr open(const std::string &path)
+    {
+        const std::size_t dot = path.rfind('.');
+        std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+        for (char &c : extension)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (extension == "ply")
+            return openPLY(path);
+        if (extension == "pcd")
+            return openPCD(path);
+        if (extension == "bin" || extension == "xyz")
+            return openRaw(path);
+        std::cerr << "Unknown point cloud extension of '" << path << "', expected ply, pcd, bin or xyz\n";
+        return nullptr;
+    }
+
+    inline static Ptr openRaw(const std::string &path)
+    {
+        Ptr reader(new Reader(path));
+        if (!reader->in_.is_open()) {
+            std::cerr << "Could not open '" << path << "'\n";
+            return nullptr;
+        }
+        reader->stride_ = 3 * sizeof(float);
+        reader->fields_ = {{{0, FLOAT32}, {sizeof(float), FLOAT32}, {2 * sizeof(float), FLOAT32}}};
+        return reader->setSize(reader->sizeFromFile()) ? reader : nullptr;
+    }
+
+    inline static Ptr openPLY(const std::string &path)
+    {
+        Ptr reader(new Reader(path));
+        if (!reader->in_.is_open()) {
+            std::cerr << "Could not open '" << path << "'\n";
+            return nullptr;
+        }
+
+        auto fail = [&path](const std::string &reason) {
+            std::cerr << "Invalid PLY file '" << path << "': " << reason << "\n";
+            return nullptr;
+        };
+
+        std::string line;
+        if (!std::getline(reader->in_, line) || trim(line) != "ply")
+            return fail("magic");
+
+        std::array<bool, 3> found = {{false, false, false}};
+        bool format = false;
+        bool vertex = false;
+        bool first  = true;
+        uint64_t size = 0;
+        while (std::getline(reader->in_, line)) {
+            std::istringstream words(trim(line));
+            std::string keyword;
+            words >> keyword;
+            if (keyword == "end_header")
+                break;
+            if (keyword == "format") {
+                std::string encoding;
+                words >> encoding;
+                if (encoding != "binary_little_endian" && encoding != "binary_big_endian")
+                    return fail("unsupported format '" + encoding + "'");
+                reader->swap_ = (encoding == "binary_little_endian") != littleEndian();
+                format = true;
+            } else if (keyword == "element") {
+                std::string name;
+                words >> name;
+                vertex = name == "vertex";
+                if (vertex && !first)
+                    return fail("vertex element must come first");
+                if (vertex && !(words >> size))
+                    return fail("vertex count");
+                first = false;
+            } else if (keyword == "property" && vertex) {
+                std::string type, name;
+                words >> type;
+                if (type == "list")
+                    return fail("list properties of vertices");
+                words >> name;
+                Type t;
+                if (!plyType(type, t))
+                    return fail("unknown type '" + type + "'");
+                for (std::size_t i = 0 ; i < 3 ; ++i) {
+                    if (name == std::string(1, static_cast<char>('x' + i))) {
+                        reader->fields_[i] = {reader->stride_, t};
+                        found[i] = true;
+                    }
+                }
+                reader->stride_ += typeSize(t);
+            }
+        }
+
+        if (!format || line.compare(0, 10, "end_header") != 0)
+            return fail("header");
+        if (!found[0] || !found[1] || !found[2])
+            return fail("vertex properties x, y and z");
+        return reader->setSize(size) ? reader : nullptr;
+    }
+
+    inline static Ptr openPCD(const std::string &path)
+    {
+        Ptr reader(new Reader(path));
+        if (!reader->in_.is_open()) {
+            std::cerr << "Could not open '" << path << "'\n";
+            return nullptr;
+        }
+
+        auto fail = [&path](const std::string &reason) {
+            std::cerr << "Invalid PCD file '" << path << "': " << reason << "\n";
+            return nullptr;
+        };
+
+        std::vector<std::string> fields;
+        std::vector<std::size_t> sizes;
+        std::vector<char>        types;
+        std::vector<std::size_t> counts;
+        uint64_t size = 0;
+        std::string line;
+        bool data = false;
+        while (!data && std::getline(reader->in_, line)) {
+            std::istringstream words(trim(line));
+            std::string keyword;
+            words >> keyword;
+            if (keyword.empty() || keyword[0] == '#')
+                continue;
+            if (keyword == "FIELDS") {
+                for (std::string f ; words >> f ;)
+                    fields.emplace_back(f);
+            } else if (keyword == "SIZE") {
+                for (std::size_t s ; words >> s ;)
+                    sizes.emplace_back(s);
+            } else if (keyword == "TYPE") {
+                for (char t ; words >> t ;)
+                    types.emplace_back(t);
+            } else if (keyword == "COUNT") {
+                for (std::size_t c ; words >> c ;)
+                    counts.emplace_back(c);
+            } else if (keyword == "POINTS") {
+                words >> size;
+            } else if (keyword == "DATA") {
+                std::string encoding;
+                words >> encoding;
+                if (encoding != "binary")
+                    return fail("unsupported data '" + encoding + "'");
+                data = true;
+            }
+        }
+
+        if (!data)
+            return fail("header");
+        if (counts.empty())
+            counts.assign(fields.size(), 1);
+        if (sizes.size() != fields.size() || types.size() != fields.size() || counts.size() != fields.size())
+            return fail("field description");
+
+        /// PCL writes binary data in little endian
+        reader->swap_ = !littleEndian();
+        std::array<bool, 3> found = {{false, false, false}};
+        for (std::size_t i = 0 ; i < fields.size() ; ++i) {
+            Type t;
+            if (!pcdType(types[i], sizes[i], t))
+                return fail("unknown type of field '" + fields[i] + "'");
+            for (std::size_t j = 0 ; j < 3 ; ++j) {
+                if (fields[i] == std::string(1, static_cast<char>('x' + j))) {
+                    reader->fields_[j] = {reader->stride_, t};
+                    found[j] = true;
+                }
+            }
+            reader->stride_ += sizes[i] * counts[i];
+        }
+        if (!found[0] || !found[1] || !found[2])
+            return fail("fields x, y and z");
+        return reader->setSize(size) ? reader : nullptr;
+    }
+
+    Reader(const Reader &other) = delete;
+    Reader& operator = (const Reader &other) = delete;
+
+    /**
+     * @brief Number of points in the file.
+     */
+    inline uint64_t size() const
+    {
+        return size_;
+    }
+
+    inline uint64_t remaining() const
+    {
+        return remaining_;
+    }
+
+    /**
+     * @brief Read the next chunk of at most max_points records, the buffers are reused between calls.
+     *        Records with non-finite coordinates are skipped, so points may hold fewer or none.
+     * @return false at the end of the file or if the file is truncated, points is empty then
+     */
+    inline bool read(std::vector<point_t> &points,
+                     const std::size_t max_points)
+    {
+        points.clear();
+        const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(remaining_, max_points));
+        if (n == 0)
+            return false;
+
+        buffer_.resize(n * stride_);
+        in_.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        if (static_cast<std::size_t>(in_.gcount()) != buffer_.size()) {
+            std::cerr << "Unexpected end of file '" << path_ << "'\n";
+            remaining_ = 0;
+            return false;
+        }
+
+        points.resize(n);
+        const char *record = buffer_.data();
+        std::size_t valid  = 0;
+        for (std::size_t r = 0 ; r < n ; ++r, record += stride_) {
+            point_t &p = points[valid];
+            for (std::size_t i = 0 ; i < 3 ; ++i)
+                p[i] = decode(record + fields_[i].offset, fields_[i].type, swap_);
+            if (finite(p[0]) && finite(p[1]) && finite(p[2]))
+                ++valid;
+        }
+        points.resize(valid);
+        remaining_ -= n;
+        return true;
+    }
+
+private:
+    const std::string    path_;
+    std::ifstream        in_;
+    std::size_t          stride_;
+    std::array<Field, 3> fields_;
+    bool                 swap_;
+    uint64_t             size_;
+    uint64_t             remaining_;
+    std::vector<char>    buffer_;
+
+    inline explicit Reader(const std::string &path) :
+        path_(path),
+        in_(path, std::ios::binary),
+        stride_(0),
+        swap_(false),
+        size_(0),
+        remaining_(0)
+    {
+    }
+
+    /// number of records from the header end to the end of the file
+    inline uint64_t sizeFromFile()
+    {
+        const std::streampos begin = in_.tellg();
+        in_.seekg(0, std::ios::end);
+        const std::streampos end = in_.tellg();
+        in_.seekg(begin);
+        return static_cast<uint64_t>(end - begin) / stride_;
+    }
+
+    inline bool setSize(const uint64_t size)
+    {
+        if (stride_ == 0 || !in_)
+            return false;
+        if (sizeFromFile() < size) {
+            std::cerr << "File '" << path_ << "' is too short for " << size << " points\n";
+            return false;
+        }
+        size_      = size;
+        remaining_ = size;
+        return true;
+    }
+
+    inline static bool littleEndian()
+    {
+        const uint16_t one = 1;
+        return *reinterpret_cast<const uint8_t*>(&one) == 1;
+    }
+
+    /// tests the exponent bits, std::isfinite() may be optimized away with -ffast-math
+    inline static bool finite(const double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x7ff0000000000000ull) != 0x7ff0000000000000ull;
+    }
+
+    inline static std::string trim(const std::string &s)
+    {
+        const std::size_t begin = s.find_first_not_of(" \t\r\n");
+        const std::size_t end   = s.find_last_not_of(" \t\r\n");
+        return begin == std::string::npos ? std::string() : s.substr(begin, end - begin + 1);
+    }
+
+    inline static std::size_t typeSize(const Type t)
+    {
+        switch (t) {
+        case INT8:
+        case UINT8:   return 1;
+        case INT16:
+        case UINT16:  return 2;
+        case INT32:
+        case UINT32:
+        case FLOAT32: return 4;
+        default:      return 8;
+        }
+    }
+
+    inline static bool plyType(const std::string &name,
+                               Type &t)
+    {
+        static const std::array<std::pair<const char*, Type>, 16> types = {{
+            {"char",   INT8},    {"int8",    INT8},
+            {"uchar",  UINT8},   {"uint8",   UINT8},
+            {"short",  INT16},   {"int16",   INT16},
+            {"ushort", UINT16},  {"uint16",  UINT16},
+            {"int",    INT32},   {"int32",   INT32},
+            {"uint",   UINT32},  {"uint32",  UINT32},
+            {"float",  FLOAT32}, {"float32", FLOAT32},
+            {"double", FLOAT64}, {"float64", FLOAT64}}};
+        for (const auto &type : types) {
+            if (name == type.first) {
+                t = type.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline static bool pcdType(const char type,
+                               const std::size_t size,
+                               Type &t)
+    {
+        switch (type) {
+        case 'F': t = size == 4 ? FLOAT32 : FLOAT64; return size == 4 || size == 8;
+        case 'I': t = size == 1 ? INT8  : size == 2 ? INT16  : INT32;  return size == 1 || size == 2 || size == 4;
+        case 'U': t = size == 1 ? UINT8 : size == 2 ? UINT16 : UINT32; return size == 1 || size == 2 || size == 4;
+        default:  return false;
+        }
+    }
+
+    template <typename T>
+    inline static double decode(const char *src,
+                                const bool swap)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, src, sizeof(T));
+        if (swap)
+            std::reverse(bytes, bytes + sizeof(T));
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return static_cast<double>(value);
+    }
+
+    inline static double decode(const char *src,
+                                const Type t,
+                                const bool swap)
+    {
+        switch (t) {
+        case INT8:    return decode<int8_t>(src, swap);
+        case UINT8:   return decode<uint8_t>(src, swap);
+        case INT16:   return decode<int16_t>(src, swap);
+        case UINT16:  return decode<uint16_t>(src, swap);
+        case INT32:   return decode<int32_t>(src, swap);
+        case UINT32:  return decode<uint32_t>(src, swap);
+        case FLOAT32: return decode<float>(src, swap);
+        default:      return decode<double>(src, swap);
+        }
+    }
+};
+
+/**
+ * @brief Read a point cloud file chunk by chunk, memory is bounded by the chunk size.
+ * @param insert    called with every chunk and its index
+ * @return false if the file cannot be read completely, chunks read before are inserted
+ */
+template <typename insert_t>
+inline bool stream(const std::string &path,
+                   const std::size_t chunk_size,
+                   const insert_t &insert)
+{
+    const Reader::Ptr reader = Reader::open(path);
+    if (!reader || chunk_size == 0)
+        return false;
+
+    std::vector<point_t> points;
+    for (std::size_t chunk = 0 ; reader->read(points, chunk_size) ; ++chunk)
+        insert(points, chunk);
+    return reader->remaining() == 0;
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_POINTCLOUD_HPP
@@ -0,0 +1,328 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_SHARED_MAP_HPP
+#define CSLIBS_NDT_SERIALIZATION_SHARED_MAP_HPP
+
+#include <cslibs_ndt/serialization/map_file.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Maps published into POSIX shared memory, to be served to other processes without copies:
+ *
+ *  <name>           : control segment | magic | version : atomic uint64 |
+ *  <name>.<version> : map segment, holding a single map file (see map_file.hpp)
+ *
+ * Names follow shm_open(), i.e. start with a slash. A new version is written into a fresh segment and
+ * announced by storing its version, the previous segment is unlinked afterwards. Subscribers attached
+ * to an old version keep their mapping until they drop it, so maps are swapped atomically. There must
+ * be only one publisher per name.
+ *
+ * The control segment outlives its publisher, so that a restarted publisher continues the versions
+ * and subscribers opened before see its maps. It is only removed by Publisher::unlink().
+ */
+namespace shared_map {
+struct Control
+{
+    char                  magic[8];
+    std::atomic<uint64_t> version;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared map versions require lock free 64 bit atomics");
+
+inline const char* magic()
+{
+    return "CSNDTSHM";
+}
+
+inline std::string segmentName(const std::string &name,
+                               const uint64_t version)
+{
+    return name + "." + std::to_string(version);
+}
+
+/**
+ * @brief Publishes maps under a name, the last map segment is unlinked on destruction.
+ */
+class Publisher
+{
+public:
+    using Ptr = std::shared_ptr<Publisher>;
+
+    /**
+     * @brief Create or take over the control segment, versions continue where a previous publisher left.
+     */
+    inline static Ptr create(const std::string &name)
+    {
+        const int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            std::cerr << "Could not create shared memory '" << name << "'\n";
+            return nullptr;
+        }
+
+        struct stat s;
+        if (::fstat(fd, &s) != 0 ||
+                (static_cast<std::size_t>(s.st_size) != sizeof(Control) && ::ftruncate(fd, sizeof(Control)) != 0)) {
+            std::cerr << "Could not resize shared memory '" << name << "'\n";
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *data = ::mmap(nullptr, sizeof(Control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            std::cerr << "Could not map shared memory '" << name << "'\n";
+            return nullptr;
+        }
+
+        Control *control = static_cast<Control*>(data);
+        if (std::memcmp(control->magic, magic(), sizeof(control->magic)) != 0) {
+            control->version.store(0, std::memory_order_relaxed);
+            std::memcpy(control->magic, magic(), sizeof(control->magic));
+        }
+        return Ptr(new Publisher(name, control));
+    }
+
+    /**
+     * @brief Remove the control segment and the last map segment, versions restart at one.
+     *        Not to be called while a publisher for the name exists.
+     */
+    inline static void unlink(const std::string &name)
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return;
+
+        struct stat s;
+        if (::fstat(fd, &s) == 0 && static_cast<std::size_t>(s.st_size) >= sizeof(Control)) {
+            void *data = ::mmap(nullptr, sizeof(Control), PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                const Control *control = static_cast<const Control*>(data);
+                const uint64_t version = control->version.load(std::memory_order_acquire);
+                if (std::memcmp(control->magic, magic(), sizeof(control->magic)) == 0 && version > 0)
+                    ::shm_unlink(segmentName(name, version).c_str());
+                ::munmap(data, sizeof(Control));
+            }
+        }
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+    }
+
+    /// the version is kept in the control segment, subscribers see the next publisher continue it
+    inline virtual ~Publisher()
+    {
+        const uint64_t version = control_->version.load(std::memory_order_relaxed);
+        if (version > 0)
+            ::shm_unlink(segmentName(name_, version).c_str());
+        ::munmap(control_, sizeof(Control));
+    }
+
+    Publisher(const Publisher &) = delete;
+    Publisher& operator = (const Publisher &) = delete;
+
+    inline const std::string& getName() const
+    {
+        return name_;
+    }
+
+    /**
+     * @brief Last version published, zero if nothing was published yet.
+     */
+    inline uint64_t getVersion() const
+    {
+        return control_->version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Write the map into a new segment and swap it in, see map_file::save().
+     * @return false if the map could not be written, the published version is kept then
+     */
+    template<std::size_t Dim, typename map_t>
+    inline bool publish(const map_t &map,
+                        const map_file::MapType type,
+                        const std::array<double, 6> &origin)
+    {
+        const uint64_t    previous = control_->version.load(std::memory_order_relaxed);
+        const uint64_t    version  = previous + 1;
+        const std::string segment  = segmentName(name_, version);
+
+        /// a segment left by a crashed publisher is never attached to, as its version was not announced
+        ::shm_unlink(segment.c_str());
+        const int fd = ::shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            std::cerr << "Could not create shared memory '" << segment << "'\n";
+            return false;
+        }
+
+        void        *data = MAP_FAILED;
+        std::size_t  size = 0;
+        std::unique_ptr<MemoryBuffer> buffer;
+        std::unique_ptr<std::ostream> out;
+        const bool success = map_file::write<Dim>(map, type, origin, segment,
+                                                  [&](const uint64_t file_size) -> std::ostream* {
+            size = static_cast<std::size_t>(file_size);
+            if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                std::cerr << "Could not resize shared memory '" << segment << "'\n";
+                return nullptr;
+            }
+            data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                std::cerr << "Could not map shared memory '" << segment << "'\n";
+                return nullptr;
+            }
+            buffer.reset(new MemoryBuffer(static_cast<char*>(data), size));
+            out.reset(new std::ostream(buffer.get()));
+            return out.get();
+        });
+        ::close(fd);
+        if (data != MAP_FAILED)
+            ::munmap(data, size);
+
+        if (!success) {
+            ::shm_unlink(segment.c_str());
+            return false;
+        }
+
+        control_->version.store(version, std::memory_order_release);
+        if (previous > 0)
+            ::shm_unlink(segmentName(name_, previous).c_str());
+        return true;
+    }
+
+private:
+    /// writes into a fixed memory range, overflowing it fails the stream
+    struct MemoryBuffer : public std::streambuf
+    {
+        inline MemoryBuffer(char *data,
+                            const std::size_t size)
+        {
+            setp(data, data + size);
+        }
+    };
+
+    const std::string  name_;
+    Control           *control_;
+
+    inline Publisher(const std::string &name,
+                     Control *control) :
+        name_(name),
+        control_(control)
+    {
+    }
+};
+
+/**
+ * @brief Attaches to maps published under a name, read only.
+ */
+class Subscriber
+{
+public:
+    using Ptr = std::shared_ptr<Subscriber>;
+
+    inline static Ptr open(const std::string &name)
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            std::cerr << "Could not open shared memory '" << name << "'\n";
+            return nullptr;
+        }
+
+        struct stat s;
+        if (::fstat(fd, &s) != 0 || static_cast<std::size_t>(s.st_size) < sizeof(Control)) {
+            std::cerr << "Invalid shared memory '" << name << "'\n";
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *data = ::mmap(nullptr, sizeof(Control), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            std::cerr << "Could not map shared memory '" << name << "'\n";
+            return nullptr;
+        }
+
+        const Control *control = static_cast<const Control*>(data);
+        if (std::memcmp(control->magic, magic(), sizeof(control->magic)) != 0) {
+            std::cerr << "Invalid shared memory '" << name << "'\n";
+            ::munmap(data, sizeof(Control));
+            return nullptr;
+        }
+        return Ptr(new Subscriber(name, control));
+    }
+
+    inline virtual ~Subscriber()
+    {
+        ::munmap(const_cast<Control*>(control_), sizeof(Control));
+    }
+
+    Subscriber(const Subscriber &) = delete;
+    Subscriber& operator = (const Subscriber &) = delete;
+
+    inline const std::string& getName() const
+    {
+        return name_;
+    }
+
+    /**
+     * @brief Version currently published, a cheap check whether attach() would yield a newer map.
+     */
+    inline uint64_t getVersion() const
+    {
+        return control_->version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Map the current version, retries if it is swapped while attaching.
+     * @param version   version attached to
+     * @return nullptr if nothing was published yet or the segment does not hold a map of the given type
+     */
+    template<std::size_t Dim>
+    inline typename map_file::MappedMap<Dim>::Ptr attach(const map_file::MapType type,
+                                                          uint64_t &version) const
+    {
+        version = getVersion();
+        while (version > 0) {
+            const std::string segment = segmentName(name_, version);
+            const int fd = ::shm_open(segment.c_str(), O_RDONLY, 0);
+            if (fd >= 0)
+                return map_file::MappedMap<Dim>::open(map_file::MappedFile::map(fd, segment), type, segment);
+
+            const uint64_t current = getVersion();
+            if (errno != ENOENT || current == version) {
+                std::cerr << "Could not open shared memory '" << segment << "'\n";
+                return nullptr;
+            }
+            version = current;
+        }
+        std::cerr << "Nothing published to '" << name_ << "'\n";
+        return nullptr;
+    }
+
+private:
+    const std::string  name_;
+    const Control     *control_;
+
+    inline Subscriber(const std::string &name,
+                      const Control *control) :
+        name_(name),
+        control_(control)
+    {
+    }
+};
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_SHARED_MAP_HPP
@@ -7,12 +7,19 @@
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/occupancy_distribution.hpp>
+#include <cslibs_ndt/common/parallel.hpp>
 #include <cslibs_ndt/serialization/filesystem.hpp>
+#include <cslibs_ndt/serialization/indices.hpp>
 
 #include <cslibs_math/serialization/array.hpp>
 #include <cslibs_math/serialization/distribution.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 namespace cis = cslibs_indexed_storage;
@@ -52,16 +59,120 @@ std::size_t read(std::ifstream &in, OccupancyDistribution<Size> &d)
     return sizeof(std::size_t) + r;
 }
 
+namespace impl {
+/**
+ * @brief In memory encoding of the records written by write() and read by read(), i.e. the layout of
+ *        cslibs_math::serialization::distribution::binary: sample count, mean and correlated moments.
+ */
+template<std::size_t Size>
+struct DistributionRecord
+{
+    using distribution_t = cslibs_math::statistics::Distribution<Size, 3>;
+    using sample_t       = typename distribution_t::sample_t;
+    using covariance_t   = typename distribution_t::covariance_t;
+
+    static constexpr std::size_t size = sizeof(std::size_t) + (Size + Size * Size) * sizeof(double);
+
+    inline static char* encode(const distribution_t &d, char *dst)
+    {
+        const std::size_t  n    = d.getN();
+        const sample_t     mean = d.getMean();
+        const covariance_t corr = d.getCorrelated();
+        std::memcpy(dst, &n, sizeof(std::size_t));
+        dst += sizeof(std::size_t);
+        std::memcpy(dst, mean.data(), Size * sizeof(double));
+        dst += Size * sizeof(double);
+        std::memcpy(dst, corr.data(), Size * Size * sizeof(double));
+        return dst + Size * Size * sizeof(double);
+    }
+
+    inline static char* encode(char *dst)
+    {
+        std::memset(dst, 0, size);
+        return dst + size;
+    }
+
+    inline static const char* decode(const char *src, distribution_t &d)
+    {
+        std::size_t  n;
+        sample_t     mean;
+        covariance_t corr;
+        std::memcpy(&n, src, sizeof(std::size_t));
+        src += sizeof(std::size_t);
+        std::memcpy(mean.data(), src, Size * sizeof(double));
+        src += Size * sizeof(double);
+        std::memcpy(corr.data(), src, Size * Size * sizeof(double));
+        d = distribution_t(n, mean, corr);
+        return src + Size * Size * sizeof(double);
+    }
+};
+
+template<typename T>
+struct Record;
+
+template<std::size_t Size>
+struct Record<Distribution<Size>>
+{
+    static constexpr std::size_t size = DistributionRecord<Size>::size;
+
+    inline static char* encode(const Distribution<Size> &d, char *dst)
+    {
+        return DistributionRecord<Size>::encode(d.data(), dst);
+    }
+
+    inline static const char* decode(const char *src, Distribution<Size> &d)
+    {
+        return DistributionRecord<Size>::decode(src, d.data());
+    }
+};
+
+template<std::size_t Size>
+struct Record<OccupancyDistribution<Size>>
+{
+    static constexpr std::size_t size = sizeof(std::size_t) + DistributionRecord<Size>::size;
+
+    inline static char* encode(const OccupancyDistribution<Size> &d, char *dst)
+    {
+        const std::size_t f = d.numFree();
+        std::memcpy(dst, &f, sizeof(std::size_t));
+        dst += sizeof(std::size_t);
+        return d.getDistribution() ? DistributionRecord<Size>::encode(*(d.getDistribution()), dst) :
+                                     DistributionRecord<Size>::encode(dst);
+    }
+
+    inline static const char* decode(const char *src, OccupancyDistribution<Size> &d)
+    {
+        std::size_t f;
+        std::memcpy(&f, src, sizeof(std::size_t));
+        typename DistributionRecord<Size>::distribution_t tmp;
+        src = DistributionRecord<Size>::decode(src + sizeof(std::size_t), tmp);
+        d = tmp.getN() != 0 ? OccupancyDistribution<Size>(f, tmp) : OccupancyDistribution<Size>(f);
+        return src;
+    }
+};
+}
+
+/**
+ * @brief Storage serialization, every element is written as its index followed by its data.
+ *        Elements are encoded into and decoded from large blocks, which are written and read with
+ *        a single call each, decoding is done in parallel.
+ */
 template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
 struct binary {
     using index_t      = std::array<int, Dim>;
     using size_t       = std::array<std::size_t, Dim>;
     using data_t       = T<Size>;
+    using record_t     = impl::Record<data_t>;
     template <template <typename, typename, typename...> class be>
     using storage_t    = cis::Storage<data_t, index_t, be>;
     using kd_storage_t = storage_t<cis::backend::kdtree::KDTree>;
     using ar_storage_t = storage_t<cis::backend::array::Array>;
 
+    /// bytes per element on disk
+    static constexpr std::size_t RECORD_SIZE = Dim * sizeof(int) + record_t::size;
+    /// bytes per block written or read at once
+    static constexpr std::size_t BLOCK_SIZE  = 1ul << 22;
+
     template <template <typename, typename, typename...> class be>
     inline static bool save(const std::shared_ptr<storage_t<be>> &storage,
                             const boost::filesystem::path        &path)
@@ -72,13 +183,22 @@ struct binary {
             return false;
         }
 
-        auto write = [&out] (const index_t &index, const data_t &data) {
-            cslibs_math::serialization::array::binary<int, Dim>::write(index, out);
-            cslibs_ndt::write(data, out);
+        const std::size_t records_per_block = BLOCK_SIZE / RECORD_SIZE;
+        std::vector<char> block(records_per_block * RECORD_SIZE);
+        char *pos = block.data();
+        char *end = block.data() + block.size();
+        auto write = [&out, &block, &pos, end] (const index_t &index, const data_t &data) {
+            std::memcpy(pos, index.data(), Dim * sizeof(int));
+            pos = record_t::encode(data, pos + Dim * sizeof(int));
+            if (pos == end) {
+                out.write(block.data(), static_cast<std::streamsize>(block.size()));
+                pos = block.data();
+            }
         };
         storage->traverse(write);
+        out.write(block.data(), static_cast<std::streamsize>(pos - block.data()));
         out.close();
-        return true;
+        return static_cast<bool>(out);
     }
 
     inline static bool load(const boost::filesystem::path &path,
@@ -99,7 +219,71 @@ struct binary {
         return loadStorage(path, storage);
     }
 
+    /**
+     * @brief Compact variant, indices are stored in Morton order as delta and varint stream
+     *        (see indices.hpp) followed by the data records in the same order:
+     *        | magic | index encoding | records |
+     * @param indices the cell indices written, in Morton order
+     */
+    template <template <typename, typename, typename...> class be>
+    inline static bool saveCompact(const std::shared_ptr<storage_t<be>> &storage,
+                                   const boost::filesystem::path        &path,
+                                   std::vector<index_t>                 &indices)
+    {
+        indices.clear();
+        storage->traverse([&indices](const index_t &index, const data_t &) {
+            indices.emplace_back(index);
+        });
+
+        std::vector<char> buffer(COMPACT_MAGIC, COMPACT_MAGIC + sizeof(COMPACT_MAGIC));
+        if (!serialization::indices::encode<Dim>(indices, buffer))
+            return false;
+
+        const std::size_t offset = buffer.size();
+        buffer.resize(offset + indices.size() * record_t::size);
+        char *pos = buffer.data() + offset;
+        for (const index_t &index : indices)
+            pos = record_t::encode(*(storage->get(index)), pos);
+
+        std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Could not open '" << path.string() << "'\n";
+            return false;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Load a file written by saveCompact().
+     * @param indices the cell indices read, in Morton order
+     */
+    inline static bool loadCompact(const boost::filesystem::path &path,
+                                   std::shared_ptr<kd_storage_t> &storage,
+                                   std::vector<index_t>          &indices)
+    {
+        storage.reset(new kd_storage_t);
+        return loadCompactStorage(path, storage, indices);
+    }
+
+    inline static bool loadCompact(const boost::filesystem::path &path,
+                                   std::shared_ptr<ar_storage_t> &storage,
+                                   const size_t &size,
+                                   const index_t &offset,
+                                   std::vector<index_t> &indices)
+    {
+        storage.reset(new ar_storage_t);
+        storage->template set<cis::option::tags::array_size>(size);
+        storage->template set<cis::option::tags::array_offset>(offset);
+        return loadCompactStorage(path, storage, indices);
+    }
+
 private:
+    static constexpr char COMPACT_MAGIC[8] = {'C', 'S', 'N', 'D', 'T', 'I', 'D', 'X'};
+    /// small blocks are not worth spawning threads
+    static constexpr std::size_t MIN_RECORDS_PER_THREAD = 4096;
+
     template <template <typename, typename, typename...> class be>
     inline static bool loadStorage(const boost::filesystem::path  &path,
                                    std::shared_ptr<storage_t<be>> &storage)
@@ -110,25 +294,90 @@ private:
             return false;
         }
 
-        try {
-            in.seekg (0, std::ios::end);
-            const std::size_t size = in.tellg();
-            in.seekg (0, std::ios::beg);
-            std::size_t read = 0;
-            while (read < size) {
-                index_t index;
-                data_t  data;
-                read += cslibs_math::serialization::array::binary<int, Dim>::read(in, index);
-                read += cslibs_ndt::read(in, data);
-                storage->insert(index, data);
+        in.seekg (0, std::ios::end);
+        const std::size_t size = static_cast<std::size_t>(in.tellg());
+        in.seekg (0, std::ios::beg);
+        if (size % RECORD_SIZE != 0) {
+            std::cerr << "Faild reading file '" << path.string() << "': size is not a multiple of the record size\n";
+            return false;
+        }
+
+        /// decoding buffers are sized once for the largest block
+        const std::size_t count             = size / RECORD_SIZE;
+        const std::size_t records_per_block = std::min(count, BLOCK_SIZE / RECORD_SIZE);
+        std::vector<char>                                           block(records_per_block * RECORD_SIZE);
+        std::vector<index_t>                                        indices(records_per_block);
+        std::vector<data_t, typename data_t::allocator_t>           data(records_per_block);
+
+        auto decode = [&block, &indices, &data](const std::size_t begin, const std::size_t end) {
+            const char *pos = block.data() + begin * RECORD_SIZE;
+            for (std::size_t i = begin ; i < end ; ++i) {
+                std::memcpy(indices[i].data(), pos, Dim * sizeof(int));
+                pos = record_t::decode(pos + Dim * sizeof(int), data[i]);
+            }
+        };
+
+        for (std::size_t read = 0 ; read < count ;) {
+            const std::size_t n = std::min(records_per_block, count - read);
+            if (!in.read(block.data(), static_cast<std::streamsize>(n * RECORD_SIZE))) {
+                std::cerr << "Faild reading file '" << path.string() << "'\n";
+                return false;
             }
-        } catch (const std::exception &e) {
-            std::cerr << "Faild reading file '" << e.what() << "'\n";
+
+            cslibs_ndt::parallel(n, MIN_RECORDS_PER_THREAD, decode);
+
+            /// the storage is not thread safe, inserting stays sequential
+            for (std::size_t i = 0 ; i < n ; ++i)
+                storage->insert(indices[i], data[i]);
+            read += n;
+        }
+        return true;
+    }
+
+    template <template <typename, typename, typename...> class be>
+    inline static bool loadCompactStorage(const boost::filesystem::path  &path,
+                                          std::shared_ptr<storage_t<be>> &storage,
+                                          std::vector<index_t>           &indices)
+    {
+        std::ifstream in(path.string(), std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Could not open '" << path.string() << "'\n";
+            return false;
+        }
+        const std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        const char *pos = buffer.data() + sizeof(COMPACT_MAGIC);
+        const char *end = buffer.data() + buffer.size();
+        if (buffer.size() < sizeof(COMPACT_MAGIC) ||
+                std::memcmp(buffer.data(), COMPACT_MAGIC, sizeof(COMPACT_MAGIC)) != 0 ||
+                !serialization::indices::decode<Dim>(pos, end, indices) ||
+                static_cast<std::size_t>(end - pos) != indices.size() * record_t::size) {
+            std::cerr << "Faild reading file '" << path.string() << "'\n";
             return false;
         }
+
+        std::vector<data_t, typename data_t::allocator_t> data(indices.size());
+        cslibs_ndt::parallel(indices.size(), MIN_RECORDS_PER_THREAD, [pos, &data](const std::size_t begin, const std::size_t end) {
+            const char *p = pos + begin * record_t::size;
+            for (std::size_t i = begin ; i < end ; ++i)
+                p = record_t::decode(p, data[i]);
+        });
+
+        /// the storage is not thread safe, inserting stays sequential
+        for (std::size_t i = 0 ; i < indices.size() ; ++i)
+            storage->insert(indices[i], data[i]);
         return true;
     }
 };
+
+template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
+constexpr std::size_t binary<T, Size, Dim>::RECORD_SIZE;
+template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
+constexpr std::size_t binary<T, Size, Dim>::BLOCK_SIZE;
+template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
+constexpr std::size_t binary<T, Size, Dim>::MIN_RECORDS_PER_THREAD;
+template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
+constexpr char binary<T, Size, Dim>::COMPACT_MAGIC[8];
 }
 
 #endif // CSLIBS_NDT_SERIALIZATION_STORAGE_HPP
@@ -0,0 +1,426 @@
+#ifndef CSLIBS_NDT_SERIALIZATION_TILES_HPP
+#define CSLIBS_NDT_SERIALIZATION_TILES_HPP
+
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/serialization/chunk.hpp>
+#include <cslibs_ndt/serialization/filesystem.hpp>
+
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/serialization/array.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cslibs_ndt {
+namespace serialization {
+/**
+ * Tiled map layout, a directory holding a spatial index and one file per tile of tile_size^Dim bundles:
+ *
+ *  tiles.yaml : origin, resolution, tile_size and the indices of all tiles
+ *  tile_<i>_<j>[_<k>].bin : | magic | bundles and their distributions : chunk (see chunk.hpp) |
+ *
+ * Every tile holds all distributions its bundles refer to, distributions shared by bundles of
+ * neighbouring tiles are stored in both tiles.
+ */
+namespace tiles {
+/**
+ * @brief Spatial index of a tiled map, loads and unloads tiles into one dynamic map and keeps track
+ *        of the tiles loaded. Reading and decoding can run on a background worker, see prefetch().
+ */
+template <typename map_t, std::size_t Dim>
+class Tiles
+{
+public:
+    using Ptr                          = std::shared_ptr<Tiles>;
+    using index_t                      = std::array<int, Dim>;
+    using index_set_t                  = std::unordered_set<index_t, IndexHash<Dim>>;
+    using origin_t                     = std::array<double, 6>;
+    using distribution_t               = typename map_t::distribution_t;
+    using distribution_storage_t       = typename map_t::distribution_storage_t;
+    using distribution_storage_array_t = typename map_t::distribution_storage_array_t;
+
+    static constexpr std::size_t NUM_STORAGES = 1ul << Dim;
+
+    /**
+     * @brief Write the map as tiles of tile_size^Dim bundles.
+     * @param origin    initial origin of the map, see encodeOrigin()
+     */
+    inline static bool save(const map_t &map,
+                            const origin_t &origin,
+                            const std::string &path,
+                            const int tile_size)
+    {
+        using path_t = boost::filesystem::path;
+
+        if (tile_size <= 0)
+            return false;
+
+        path_t path_root(path);
+        if (!cslibs_ndt::common::serialization::create_directory(path_root))
+            return false;
+
+        std::vector<index_t> bis;
+        map.getBundleIndices(bis);
+
+        std::unordered_map<index_t, std::vector<index_t>, IndexHash<Dim>> tiles;
+        for (const index_t &bi : bis)
+            tiles[toTileIndex(bi, tile_size)].emplace_back(bi);
+
+        std::vector<index_t> tile_indices;
+        tile_indices.reserve(tiles.size());
+        for (auto &t : tiles) {
+            if (!saveTile(map, t.second, path_root / path_t(tileFile(t.first))))
+                return false;
+            tile_indices.emplace_back(t.first);
+        }
+
+        std::ofstream out((path_root / path_t("tiles.yaml")).string(), std::fstream::trunc);
+        YAML::Emitter yaml(out);
+        YAML::Node n;
+        n["origin"]     = origin;
+        n["resolution"] = map.getResolution();
+        n["tile_size"]  = tile_size;
+        n["tiles"]      = tile_indices;
+        yaml << n;
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Read the spatial index of a tiled map, tiles are only read by load() and prefetch().
+     */
+    inline static Ptr open(const std::string &path)
+    {
+        using path_t = boost::filesystem::path;
+
+        path_t path_root(path);
+        if (!cslibs_ndt::common::serialization::check_directory(path_root) ||
+                !cslibs_ndt::common::serialization::check_file(path_root / path_t("tiles.yaml")))
+            return Ptr();
+
+        YAML::Node n = YAML::LoadFile((path_root / path_t("tiles.yaml")).string());
+        Ptr tiles(new Tiles(path_root,
+                            n["origin"].as<origin_t>(),
+                            n["resolution"].as<double>(),
+                            n["tile_size"].as<int>(),
+                            n["tiles"].as<std::vector<index_t>>()));
+        return tiles->tile_size_ > 0 ? tiles : Ptr();
+    }
+
+    Tiles(const Tiles &other) = delete;
+    Tiles& operator = (const Tiles &other) = delete;
+
+    /**
+     * @brief Stops the worker after the tile being read, requests not started yet report zero tiles.
+     */
+    inline virtual ~Tiles()
+    {
+        {
+            lock_t l(mutex_);
+            stop_ = true;
+        }
+        requested_.notify_all();
+        if (worker_.joinable())
+            worker_.join();
+    }
+
+    inline const origin_t& getOrigin() const
+    {
+        return origin_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline int getTileSize() const
+    {
+        return tile_size_;
+    }
+
+    /**
+     * @brief Tiles on disk, which intersect the given bundle index box.
+     */
+    inline std::vector<index_t> getTiles(const index_t &min_bi,
+                                         const index_t &max_bi) const
+    {
+        const index_t min_ti = toTileIndex(min_bi, tile_size_);
+        const index_t max_ti = toTileIndex(max_bi, tile_size_);
+
+        std::vector<index_t> tiles;
+        for (const index_t &ti : tiles_) {
+            bool inside = true;
+            for (std::size_t i = 0 ; i < Dim ; ++i)
+                inside &= ti[i] >= min_ti[i] && ti[i] <= max_ti[i];
+            if (inside)
+                tiles.emplace_back(ti);
+        }
+        return tiles;
+    }
+
+    inline std::vector<index_t> getLoadedTiles() const
+    {
+        lock_t l(mutex_);
+        return std::vector<index_t>(loaded_.begin(), loaded_.end());
+    }
+
+    /**
+     * @brief Read and decode the tiles intersecting the bundle index box in the background.
+     *        Tiles loaded, staged or already requested are skipped. Decoded tiles are merged
+     *        by apply(), so the map is never touched by the background worker. Requests are
+     *        processed in order by a single worker owned by this, dropping the future does not block.
+     * @return future of the number of tiles decoded successfully
+     */
+    inline std::future<std::size_t> prefetch(const index_t &min_bi,
+                                             const index_t &max_bi)
+    {
+        std::shared_ptr<Request> request(new Request);
+        std::future<std::size_t> decoded = request->decoded.get_future();
+        {
+            lock_t l(mutex_);
+            for (const index_t &ti : getTiles(min_bi, max_bi)) {
+                if (pending_.count(ti) > 0)
+                    cancelled_.erase(ti);
+                else if (loaded_.count(ti) == 0 && staged_.count(ti) == 0) {
+                    pending_.insert(ti);
+                    request->tiles.emplace_back(ti);
+                }
+            }
+            if (request->tiles.empty()) {
+                request->decoded.set_value(0);
+                return decoded;
+            }
+
+            requests_.emplace_back(request);
+            if (!worker_.joinable())
+                worker_ = std::thread([this]() { work(); });
+        }
+        requested_.notify_one();
+        return decoded;
+    }
+
+    /**
+     * @brief Merge the tiles decoded by prefetch() into the map, to be called by the thread owning the map.
+     * @return number of tiles merged
+     */
+    inline std::size_t apply(map_t &map)
+    {
+        std::unordered_map<index_t, std::shared_ptr<Tile>, IndexHash<Dim>> staged;
+        {
+            lock_t l(mutex_);
+            staged.swap(staged_);
+            for (const auto &t : staged)
+                loaded_.insert(t.first);
+        }
+        for (const auto &t : staged)
+            map.insertBundles(t.second->bundles, t.second->storages);
+        return staged.size();
+    }
+
+    /**
+     * @brief Load the tiles intersecting the bundle index box into the map synchronously.
+     * @return number of tiles merged, including ones prefetched before
+     */
+    inline std::size_t load(const index_t &min_bi,
+                            const index_t &max_bi,
+                            map_t &map)
+    {
+        prefetch(min_bi, max_bi).wait();
+        return apply(map);
+    }
+
+    /**
+     * @brief Remove the bundles of all loaded tiles intersecting the bundle index box from the map,
+     *        including bundles allocated since. Staged or pending tiles in the box are dropped.
+     * @return number of tiles unloaded
+     */
+    inline std::size_t unload(const index_t &min_bi,
+                              const index_t &max_bi,
+                              map_t &map)
+    {
+        index_set_t unloaded;
+        {
+            lock_t l(mutex_);
+            for (const index_t &ti : getTiles(min_bi, max_bi)) {
+                staged_.erase(ti);
+                if (pending_.count(ti) > 0)
+                    cancelled_.insert(ti);
+                if (loaded_.erase(ti) > 0)
+                    unloaded.insert(ti);
+            }
+        }
+        if (unloaded.empty())
+            return 0;
+
+        std::vector<index_t> bis;
+        map.getBundleIndices(bis);
+        std::vector<index_t> erase;
+        for (const index_t &bi : bis)
+            if (unloaded.count(toTileIndex(bi, tile_size_)) > 0)
+                erase.emplace_back(bi);
+        map.eraseBundles(erase);
+        return unloaded.size();
+    }
+
+    inline static index_t toTileIndex(const index_t &bi,
+                                      const int tile_size)
+    {
+        index_t ti;
+        for (std::size_t i = 0 ; i < Dim ; ++i)
+            ti[i] = cslibs_math::common::div<int>(bi[i], tile_size);
+        return ti;
+    }
+
+private:
+    using mutex_t = std::mutex;
+    using lock_t  = std::unique_lock<mutex_t>;
+
+    static constexpr char MAGIC[8] = {'C', 'S', 'N', 'D', 'T', 'T', 'I', 'L'};
+
+    struct Tile {
+        std::vector<index_t>         bundles;
+        distribution_storage_array_t storages;
+    };
+
+    struct Request {
+        std::vector<index_t>      tiles;
+        std::promise<std::size_t> decoded;
+    };
+
+    const boost::filesystem::path                                       path_;
+    const origin_t                                                      origin_;
+    const double                                                        resolution_;
+    const int                                                           tile_size_;
+    const std::vector<index_t>                                          tiles_;
+
+    mutable mutex_t                                                     mutex_;
+    index_set_t                                                         loaded_;
+    index_set_t                                                         pending_;
+    index_set_t                                                         cancelled_;
+    std::unordered_map<index_t, std::shared_ptr<Tile>, IndexHash<Dim>> staged_;
+    std::deque<std::shared_ptr<Request>>                                requests_;
+    std::condition_variable                                             requested_;
+    bool                                                                stop_;
+    std::thread                                                         worker_;
+
+    inline Tiles(const boost::filesystem::path &path,
+                 const origin_t &origin,
+                 const double resolution,
+                 const int tile_size,
+                 const std::vector<index_t> &tiles) :
+        path_(path),
+        origin_(origin),
+        resolution_(resolution),
+        tile_size_(tile_size),
+        tiles_(tiles),
+        stop_(false)
+    {
+    }
+
+    /// reads the requested tiles one after another until stopped
+    inline void work()
+    {
+        lock_t l(mutex_);
+        while (true) {
+            requested_.wait(l, [this]() { return stop_ || !requests_.empty(); });
+            if (stop_)
+                break;
+
+            const std::shared_ptr<Request> request = requests_.front();
+            requests_.pop_front();
+
+            std::size_t decoded = 0;
+            for (const index_t &ti : request->tiles) {
+                if (stop_)
+                    break;
+                l.unlock();
+                std::shared_ptr<Tile> tile(new Tile);
+                const bool success = loadTile(path_ / boost::filesystem::path(tileFile(ti)), *tile);
+                l.lock();
+
+                pending_.erase(ti);
+                const bool cancelled = cancelled_.erase(ti) > 0;
+                if (success && !cancelled) {
+                    staged_[ti] = tile;
+                    ++decoded;
+                }
+            }
+            request->decoded.set_value(decoded);
+        }
+
+        for (const std::shared_ptr<Request> &request : requests_)
+            request->decoded.set_value(0);
+        requests_.clear();
+    }
+
+    inline static std::string tileFile(const index_t &ti)
+    {
+        std::string name = "tile";
+        for (std::size_t i = 0 ; i < Dim ; ++i)
+            name += "_" + std::to_string(ti[i]);
+        return name + ".bin";
+    }
+
+    inline static bool saveTile(const map_t &map,
+                                const std::vector<index_t> &bis,
+                                const boost::filesystem::path &path)
+    {
+        std::vector<char> buffer(MAGIC, MAGIC + sizeof(MAGIC));
+        if (!chunk::encode<map_t, Dim>(map, bis, buffer))
+            return false;
+
+        std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Could not open '" << path.string() << "'\n";
+            return false;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return static_cast<bool>(out);
+    }
+
+    inline static bool loadTile(const boost::filesystem::path &path,
+                                Tile &tile)
+    {
+        std::ifstream in(path.string(), std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Could not open '" << path.string() << "'\n";
+            return false;
+        }
+        const std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        const char *pos = buffer.data() + sizeof(MAGIC);
+        const char *end = buffer.data() + buffer.size();
+        if (buffer.size() < sizeof(MAGIC) ||
+                std::memcmp(buffer.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+                !chunk::decode<map_t, Dim>(pos, end, tile.bundles, tile.storages) ||
+                pos != end) {
+            std::cerr << "Faild reading file '" << path.string() << "'\n";
+            return false;
+        }
+        return true;
+    }
+};
+
+template <typename map_t, std::size_t Dim>
+constexpr std::size_t Tiles<map_t, Dim>::NUM_STORAGES;
+template <typename map_t, std::size_t Dim>
+constexpr char Tiles<map_t, Dim>::MAGIC[8];
+}
+}
+}
+
+#endif // CSLIBS_NDT_SERIALIZATION_TILES_HPP
@@ -6,6 +6,8 @@
 
 #include <cslibs_ndt_2d/conversion/gridmap.hpp>
 #include <cslibs_ndt_2d/conversion/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/rasterization.hpp>
+#include <cslibs_ndt_2d/conversion/region.hpp>
 
 #include <cslibs_gridmaps/static_maps/binary_gridmap.h>
 #include <cslibs_gridmaps/static_maps/algorithms/distance_transform.hpp>
@@ -22,7 +24,6 @@ inline void from(
         return;
     src->allocatePartiallyAllocatedBundles();
 
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
     using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
     dst.reset(new dst_map_t(src->getOrigin(),
                             sampling_resolution,
@@ -30,30 +31,11 @@ inline void from(
                             std::ceil(src->getWidth()  / sampling_resolution)));
     std::fill(dst->getData().begin(), dst->getData().end(), 0);
 
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        return 0.25 * (bundle.at(0)->data().sampleNonNormalized(p) +
-                       bundle.at(1)->data().sampleNonNormalized(p) +
-                       bundle.at(2)->data().sampleNonNormalized(p) +
-                       bundle.at(3)->data().sampleNonNormalized(p));
-    };
-
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
-
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) =
-                        sample(p, b) >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
-                                                    cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
-            }
-        }
+    impl::Rasterizer rasterizer(src->getMinBundleIndex(), src->getBundleResolution(), sampling_resolution);
+    impl::gather(*src, rasterizer);
+    rasterizer.apply(*dst, [&threshold](const double v) {
+        return v >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
+                                cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
     });
 }
 
@@ -68,7 +50,6 @@ inline void from(
         return;
     src->allocatePartiallyAllocatedBundles();
 
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
     using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
     dst.reset(new dst_map_t(src->getOrigin(),
                             sampling_resolution,
@@ -76,38 +57,53 @@ inline void from(
                             std::ceil(src->getWidth()  / sampling_resolution)));
     std::fill(dst->getData().begin(), dst->getData().end(), 0);
 
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
+    impl::Rasterizer rasterizer(src->getMinBundleIndex(), src->getBundleResolution(), sampling_resolution);
+    impl::gather(*src, inverse_model, rasterizer);
+    rasterizer.apply(*dst, [&threshold](const double v) {
+        return v >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
+                                cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
+    });
+}
 
-    auto sample = [&inverse_model](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        auto sample = [&p, &inverse_model](const src_map_t::distribution_t *d) {
-            auto do_sample = [&p, &inverse_model, &d]() {
-                const auto &handle = d;
-                return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(inverse_model) : 0.0;
-            };
-            return d ? do_sample() : 0.0;
-        };
-        return 0.25 * (sample(bundle.at(0)) +
-                       sample(bundle.at(1)) +
-                       sample(bundle.at(2)) +
-                       sample(bundle.at(3)));
-    };
+/**
+ * @brief Region of interest conversion, only the bundles intersecting the region are sampled.
+ *        The destination is reused while the region stays within the same bundles.
+ */
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const Region &region,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
 
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
+    impl::gatherRegion(*src, region, sampling_resolution, 0.0, dst,
+                       impl::setBundle<cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_bundle_t>).apply(*dst, [&threshold](const double v) {
+        return v >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
+                                cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
+    });
+}
+
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const Region &region,
+        const double &threshold = 0.169)
+{
+    if (!src || !inverse_model)
+        return;
 
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) =
-                        sample(p, b) >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
-                                                    cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
-            }
-        }
+    impl::gatherRegion(*src, region, sampling_resolution, 0.0, dst,
+                       [&inverse_model](const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::distribution_bundle_t &b,
+                                 impl::BundleGaussians &g) {
+        impl::setOccupancyBundle(b, inverse_model, g);
+    }).apply(*dst, [&threshold](const double v) {
+        return v >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
+                                cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
     });
 }
 }
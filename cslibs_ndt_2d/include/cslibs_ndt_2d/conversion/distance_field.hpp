@@ -0,0 +1,136 @@
+#ifndef CSLIBS_NDT_2D_CONVERSION_DISTANCE_FIELD_HPP
+#define CSLIBS_NDT_2D_CONVERSION_DISTANCE_FIELD_HPP
+
+#include <cslibs_ndt/common/parallel.hpp>
+#include <cslibs_ndt_2d/conversion/rasterization.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace cslibs_ndt_2d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief Exact squared distance transform of a sampled function along one line,
+ *        lower envelope of parabolas after Felzenszwalb and Huttenlocher.
+ * @param f         input, n values with the given stride
+ * @param d         output, n values with the given stride
+ * @param v, z      scratch, at least n and n + 1 values
+ */
+inline void squaredDistanceTransform(const double *f, double *d,
+                                     const std::size_t n, const std::size_t stride,
+                                     int *v, double *z)
+{
+    if (n == 0)
+        return;
+
+    auto intersection = [f, stride](const int q, const int p) {
+        return ((f[q * stride] + q * q) - (f[p * stride] + p * p)) / (2.0 * (q - p));
+    };
+
+    int k = 0;
+    v[0] = 0;
+    z[0] = std::numeric_limits<double>::lowest();
+    z[1] = std::numeric_limits<double>::max();
+    for (int q = 1 ; q < static_cast<int>(n) ; ++q) {
+        double s = intersection(q, v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = intersection(q, v[k]);
+        }
+        ++k;
+        v[k]     = q;
+        z[k]     = s;
+        z[k + 1] = std::numeric_limits<double>::max();
+    }
+
+    k = 0;
+    for (int q = 0 ; q < static_cast<int>(n) ; ++q) {
+        while (z[k + 1] < q)
+            ++k;
+        const double dq = q - v[k];
+        d[q * stride] = dq * dq + f[v[k] * stride];
+    }
+}
+
+/**
+ * @brief Distance field seeded directly from the gaussians of the gathered bundles, pixels sampled at or
+ *        above the threshold are obstacles, like in the dense probability image fed to DistanceTransform.
+ *        Columns and rows are transformed exactly and in parallel, distances are limited to maximum_distance.
+ * @param rasterizer        bundles of the source map
+ * @param width, height     extent of the rasterizer in pixels
+ * @param data              row major destination of width x height pixels
+ */
+inline void distanceField(const Rasterizer &rasterizer,
+                          const double sampling_resolution,
+                          const double maximum_distance,
+                          const double threshold,
+                          const std::size_t width,
+                          const std::size_t height,
+                          std::vector<double> &data)
+{
+    if (threshold <= 0.0) {
+        std::fill(data.begin(), data.end(), 0.0);
+        return;
+    }
+
+    std::vector<unsigned char> seeds(width * height, 0);
+    rasterizer.seed(seeds, width, threshold);
+
+    /// anything farther than the maximum distance is clamped, so there is no need to propagate further
+    const double max_pixels = std::ceil(maximum_distance / sampling_resolution) + 1.0;
+    const double far        = max_pixels * max_pixels;
+
+    /// columns: distance to the closest seed in the same column, two sweeps suffice for a binary input
+    std::vector<double> g(width * height);
+    cslibs_ndt::parallel(width, 16, [&seeds, &g, width, height, max_pixels, far](const std::size_t begin, const std::size_t end) {
+        for (std::size_t x = begin ; x < end ; ++x) {
+            double last = max_pixels;
+            for (std::size_t y = 0 ; y < height ; ++y) {
+                const std::size_t i = y * width + x;
+                last = seeds[i] ? 0.0 : std::min(last + 1.0, max_pixels);
+                g[i] = last;
+            }
+            last = max_pixels;
+            for (std::size_t y = height ; y-- > 0 ;) {
+                const std::size_t i = y * width + x;
+                last = seeds[i] ? 0.0 : std::min(last + 1.0, max_pixels);
+                g[i] = std::min(g[i] * g[i], std::min(last * last, far));
+            }
+        }
+    });
+
+    /// rows: exact transform of the squared column distances
+    cslibs_ndt::parallel(height, 16, [&g, &data, width, sampling_resolution, maximum_distance](const std::size_t begin, const std::size_t end) {
+        std::vector<int>    v(width);
+        std::vector<double> z(width + 1);
+        for (std::size_t y = begin ; y < end ; ++y) {
+            double *row = data.data() + y * width;
+            squaredDistanceTransform(g.data() + y * width, row, width, 1, v.data(), z.data());
+            for (std::size_t x = 0 ; x < width ; ++x)
+                row[x] = std::min(std::sqrt(row[x]) * sampling_resolution, maximum_distance);
+        }
+    });
+}
+
+/**
+ * @brief Distance field written into a gridmap.
+ * @param dst               destination gridmap with row major getData() and the extent of the rasterizer
+ */
+template<typename dst_map_t>
+inline void distanceField(const Rasterizer &rasterizer,
+                          const double sampling_resolution,
+                          const double maximum_distance,
+                          const double threshold,
+                          dst_map_t &dst)
+{
+    distanceField(rasterizer, sampling_resolution, maximum_distance, threshold,
+                  dst.getWidth(), dst.getHeight(), dst.getData());
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_CONVERSION_DISTANCE_FIELD_HPP
@@ -6,9 +6,11 @@
 
 #include <cslibs_ndt_2d/conversion/gridmap.hpp>
 #include <cslibs_ndt_2d/conversion/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/rasterization.hpp>
+#include <cslibs_ndt_2d/conversion/distance_field.hpp>
+#include <cslibs_ndt_2d/conversion/region.hpp>
 
 #include <cslibs_gridmaps/static_maps/distance_gridmap.h>
-#include <cslibs_gridmaps/static_maps/algorithms/distance_transform.hpp>
 
 namespace cslibs_ndt_2d {
 namespace conversion {
@@ -23,7 +25,6 @@ inline void from(
         return;
     src->allocatePartiallyAllocatedBundles();
 
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
     using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
     dst.reset(new dst_map_t(src->getOrigin(),
                             sampling_resolution,
@@ -31,34 +32,9 @@ inline void from(
                             std::ceil(src->getWidth()  / sampling_resolution)));
     std::fill(dst->getData().begin(), dst->getData().end(), 0);
 
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        return 0.25 * (bundle.at(0)->data().sampleNonNormalized(p) +
-                       bundle.at(1)->data().sampleNonNormalized(p) +
-                       bundle.at(2)->data().sampleNonNormalized(p) +
-                       bundle.at(3)->data().sampleNonNormalized(p));
-    };
-
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
-
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) = sample(p, b);
-            }
-        }
-    });
-
-    std::vector<double> occ = dst->getData();
-    cslibs_gridmaps::static_maps::algorithms::DistanceTransform<double> distance_transform(
-                sampling_resolution, maximum_distance, threshold);
-    distance_transform.apply(occ, dst->getWidth(), dst->getData());
+    impl::Rasterizer rasterizer(src->getMinBundleIndex(), src->getBundleResolution(), sampling_resolution);
+    impl::gather(*src, rasterizer);
+    impl::distanceField(rasterizer, sampling_resolution, maximum_distance, threshold, *dst);
 }
 
 inline void from(
@@ -73,7 +49,6 @@ inline void from(
         return;
     src->allocatePartiallyAllocatedBundles();
 
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
     using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
     dst.reset(new dst_map_t(src->getOrigin(),
                             sampling_resolution,
@@ -81,42 +56,53 @@ inline void from(
                             std::ceil(src->getWidth()  / sampling_resolution)));
     std::fill(dst->getData().begin(), dst->getData().end(), 0);
 
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
+    impl::Rasterizer rasterizer(src->getMinBundleIndex(), src->getBundleResolution(), sampling_resolution);
+    impl::gather(*src, inverse_model, rasterizer);
+    impl::distanceField(rasterizer, sampling_resolution, maximum_distance, threshold, *dst);
+}
+
+/**
+ * @brief Region of interest conversion, the destination covers the bundles intersecting the region.
+ *        Bundles within the maximum distance around it are sampled as well, so that obstacles outside
+ *        of the region contribute to the distances like in the conversion of the whole map.
+ *        The destination is reused while the region stays within the same bundles.
+ */
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::DistanceGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const Region &region,
+        const double &maximum_distance = 2.0,
+        const double &threshold        = 0.169)
+{
+    if (!src)
+        return;
 
-    auto sample = [&inverse_model](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        auto sample = [&p, &inverse_model](const src_map_t::distribution_t *d) {
-            auto do_sample = [&p, &inverse_model, &d]() {
-                const auto &handle = d;
-                return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(inverse_model) : 0.0;
-            };
-            return d ? do_sample() : 0.0;
-        };
-        return 0.25 * (sample(bundle.at(0)) +
-                       sample(bundle.at(1)) +
-                       sample(bundle.at(2)) +
-                       sample(bundle.at(3)));
-    };
+    const impl::RegionRasterizer rasterizer =
+            impl::gatherRegion(*src, region, sampling_resolution, maximum_distance, dst,
+                               impl::setBundle<cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_bundle_t>);
+    impl::distanceField(rasterizer, sampling_resolution, maximum_distance, threshold, *dst);
+}
 
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::DistanceGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const Region &region,
+        const double &maximum_distance = 2.0,
+        const double &threshold        = 0.169)
+{
+    if (!src || !inverse_model)
+        return;
 
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) = sample(p, b);
-            }
-        }
+    const impl::RegionRasterizer rasterizer =
+            impl::gatherRegion(*src, region, sampling_resolution, maximum_distance, dst,
+                               [&inverse_model](const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::distribution_bundle_t &b,
+                                                impl::BundleGaussians &g) {
+        impl::setOccupancyBundle(b, inverse_model, g);
     });
-
-    std::vector<double> occ = dst->getData();
-    cslibs_gridmaps::static_maps::algorithms::DistanceTransform<double> distance_transform(
-                sampling_resolution, maximum_distance, threshold);
-    distance_transform.apply(occ, dst->getWidth(), dst->getData());
+    impl::distanceField(rasterizer, sampling_resolution, maximum_distance, threshold, *dst);
 }
 }
 }
@@ -7,11 +7,78 @@
 
 #include <cslibs_ndt_2d/conversion/gridmap.hpp>
 #include <cslibs_ndt_2d/conversion/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/rasterization.hpp>
+#include <cslibs_ndt_2d/conversion/region.hpp>
 
 #include <cslibs_gridmaps/static_maps/probability_gridmap.h>
 
 namespace cslibs_ndt_2d {
 namespace conversion {
+namespace impl {
+template<typename src_map_t, typename set_bundle_t>
+inline void from(src_map_t &src,
+                 cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+                 const double sampling_resolution,
+                 const set_bundle_t &set_bundle)
+{
+    src.allocatePartiallyAllocatedBundles();
+
+    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
+    dst.reset(new dst_map_t(src.getOrigin(),
+                            sampling_resolution,
+                            std::ceil(src.getHeight() / sampling_resolution),
+                            std::ceil(src.getWidth()  / sampling_resolution)));
+    std::fill(dst->getData().begin(), dst->getData().end(), 0);
+
+    Rasterizer rasterizer(src.getMinBundleIndex(), src.getBundleResolution(), sampling_resolution);
+    src.traverse([&rasterizer, &set_bundle](const typename src_map_t::index_t &bi,
+                                            const typename src_map_t::distribution_bundle_t &b) {
+        set_bundle(b, rasterizer.add(bi));
+    });
+    rasterizer.apply(*dst);
+    src.clearDirtyBundles();
+}
+
+/**
+ * @brief Sample only the bundles changed since the last conversion again.
+ * @return false if dst does not fit the source anymore, the map only grows, so the size of dst changes then
+ */
+template<typename src_map_t, typename set_bundle_t>
+inline bool update(src_map_t &src,
+                   cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+                   const double sampling_resolution,
+                   const set_bundle_t &set_bundle)
+{
+    using index_t     = std::array<int, 2>;
+    using index_set_t = typename src_map_t::index_set_t;
+
+    const std::vector<index_t> dirty(src.getDirtyBundles().begin(), src.getDirtyBundles().end());
+    src.allocatePartiallyAllocatedBundles(dirty);
+
+    if (!dst ||
+            dst->getHeight() != static_cast<std::size_t>(std::ceil(src.getHeight() / sampling_resolution)) ||
+            dst->getWidth()  != static_cast<std::size_t>(std::ceil(src.getWidth()  / sampling_resolution)))
+        return false;
+
+    /// distributions are shared by neighbouring bundles, their samples change as well
+    index_set_t bundles;
+    for (const index_t &bi : src.getDirtyBundles())
+        for (int dx = -1 ; dx <= 1 ; ++dx)
+            for (int dy = -1 ; dy <= 1 ; ++dy)
+                bundles.insert({{bi[0] + dx, bi[1] + dy}});
+
+    Rasterizer rasterizer(src.getMinBundleIndex(), src.getBundleResolution(), sampling_resolution);
+    for (const index_t &bi : bundles) {
+        const typename src_map_t::distribution_bundle_t *b = src.get(bi);
+        if (b)
+            set_bundle(*b, rasterizer.add(bi));
+    }
+    rasterizer.apply(*dst);
+    src.clearDirtyBundles();
+    return true;
+}
+}
+
 inline void from(
         const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
         cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
@@ -19,39 +86,29 @@ inline void from(
 {
     if (!src)
         return;
-    src->allocatePartiallyAllocatedBundles();
 
     using src_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
-    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
-    dst.reset(new dst_map_t(src->getOrigin(),
-                            sampling_resolution,
-                            std::ceil(src->getHeight() / sampling_resolution),
-                            std::ceil(src->getWidth()  / sampling_resolution)));
-    std::fill(dst->getData().begin(), dst->getData().end(), 0);
-
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        return 0.25 * (bundle.at(0)->data().sampleNonNormalized(p) +
-                       bundle.at(1)->data().sampleNonNormalized(p) +
-                       bundle.at(2)->data().sampleNonNormalized(p) +
-                       bundle.at(3)->data().sampleNonNormalized(p));
-    };
+    impl::from(*src, dst, sampling_resolution,
+               impl::setBundle<src_map_t::distribution_bundle_t>);
+}
 
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
+/**
+ * @brief Incremental conversion for maps which are republished while mapping, only the pixels
+ *        of bundles changed since the last conversion of src are sampled again. Falls back to
+ *        a full conversion if dst is not set or the map has grown.
+ */
+inline void update(
+        const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+        const double sampling_resolution)
+{
+    if (!src)
+        return;
 
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) = sample(p, b);
-            }
-        }
-    });
+    using src_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    auto set_bundle = impl::setBundle<src_map_t::distribution_bundle_t>;
+    if (!impl::update(*src, dst, sampling_resolution, set_bundle))
+        impl::from(*src, dst, sampling_resolution, set_bundle);
 }
 
 inline void from(
@@ -69,29 +126,33 @@ inline void from(
                             std::ceil(src->getWidth()  / sampling_resolution)));
     std::fill(dst->getData().begin(), dst->getData().end(), 0);
 
+    using src_map_t = cslibs_ndt_2d::static_maps::mono::Gridmap;
     const std::size_t height = dst->getHeight();
     const std::size_t width  = dst->getWidth();
-    const cslibs_ndt_2d::static_maps::mono::Gridmap::index_t min_index = src->getMinIndex();
+    const src_map_t::index_t min_index = src->getMinIndex();
 
-    //// Todo: Check that code here!
-
-    std::cerr << "converting " << width << " " << height << "\n";
+    /// distributions update lazily, update them before sampling concurrently
+    src->traverse([](const src_map_t::index_t &, const src_map_t::distribution_t &d) {
+        if (d.data().getN() >= 3)
+            d.data().getInformationMatrix();
+    });
 
-    for(std::size_t i = 0 ; i < height ; ++i) {
-        for(std::size_t j = 0 ; j < width ; ++j) {
-            const cslibs_math_2d::Point2d  p(j * sampling_resolution,
-                                             i * sampling_resolution);
+    cslibs_ndt::parallel(height, 1, [&src, &dst, &min_index, width, sampling_resolution](const std::size_t begin, const std::size_t end) {
+        for(std::size_t i = begin ; i < end ; ++i) {
+            for(std::size_t j = 0 ; j < width ; ++j) {
+                const cslibs_math_2d::Point2d  p(j * sampling_resolution,
+                                                 i * sampling_resolution);
 
-            const cslibs_ndt_2d::static_maps::mono::Gridmap::index_t idx = {{min_index[0] + static_cast<int>(p(0) / src->getResolution()),
-                                                                             min_index[1] + static_cast<int>(p(1) / src->getResolution())}};
+                const src_map_t::index_t idx = {{min_index[0] + static_cast<int>(p(0) / src->getResolution()),
+                                                 min_index[1] + static_cast<int>(p(1) / src->getResolution())}};
 
-            const double v = src->sampleNonNormalized(src->getOrigin() * p,idx);
-            if(v >= 0.0) {
-                dst->at(j,i) = v;
+                const double v = src->sampleNonNormalized(src->getOrigin() * p,idx);
+                if(v >= 0.0) {
+                    dst->at(j,i) = v;
+                }
             }
         }
-    }
-    std::cerr << "converted" << std::endl;
+    });
 }
 
 inline void from(
@@ -102,47 +163,66 @@ inline void from(
 {
     if (!src || !inverse_model)
         return;
-    src->allocatePartiallyAllocatedBundles();
 
     using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
-    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
-    dst.reset(new dst_map_t(src->getOrigin(),
-                            sampling_resolution,
-                            std::ceil(src->getHeight() / sampling_resolution),
-                            std::ceil(src->getWidth()  / sampling_resolution)));
-    std::fill(dst->getData().begin(), dst->getData().end(), 0);
+    impl::from(*src, dst, sampling_resolution,
+               [&inverse_model](const src_map_t::distribution_bundle_t &b, impl::BundleGaussians &g) {
+        impl::setOccupancyBundle(b, inverse_model, g);
+    });
+}
 
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [&inverse_model](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        auto sample = [&p, &inverse_model](const src_map_t::distribution_t *d) {
-            auto do_sample = [&p, &inverse_model, &d]() {
-                const auto &handle = d;
-                return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(inverse_model) : 0.0;
-            };
-            return d ? do_sample() : 0.0;
-        };
-        return 0.25 * (sample(bundle.at(0)) +
-                       sample(bundle.at(1)) +
-                       sample(bundle.at(2)) +
-                       sample(bundle.at(3)));
+/**
+ * @brief Incremental conversion, see update() of the dynamic gridmap.
+ */
+inline void update(
+        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model)
+{
+    if (!src || !inverse_model)
+        return;
+
+    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    auto set_bundle = [&inverse_model](const src_map_t::distribution_bundle_t &b, impl::BundleGaussians &g) {
+        impl::setOccupancyBundle(b, inverse_model, g);
     };
+    if (!impl::update(*src, dst, sampling_resolution, set_bundle))
+        impl::from(*src, dst, sampling_resolution, set_bundle);
+}
+
+/**
+ * @brief Region of interest conversion, only the bundles intersecting the region are sampled.
+ *        The destination is reused while the region stays within the same bundles.
+ */
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+        const double sampling_resolution,
+        const Region &region)
+{
+    if (!src)
+        return;
 
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
+    impl::gatherRegion(*src, region, sampling_resolution, 0.0, dst,
+                       impl::setBundle<cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_bundle_t>).apply(*dst);
+}
 
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) = sample(p, b);
-            }
-        }
-    });
+inline void from(
+        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const Region &region)
+{
+    if (!src || !inverse_model)
+        return;
+
+    impl::gatherRegion(*src, region, sampling_resolution, 0.0, dst,
+                       [&inverse_model](const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::distribution_bundle_t &b,
+                                 impl::BundleGaussians &g) {
+        impl::setOccupancyBundle(b, inverse_model, g);
+    }).apply(*dst);
 }
 }
 }
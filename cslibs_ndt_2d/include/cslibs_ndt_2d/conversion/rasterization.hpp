@@ -0,0 +1,287 @@
+#ifndef CSLIBS_NDT_2D_CONVERSION_RASTERIZATION_HPP
+#define CSLIBS_NDT_2D_CONVERSION_RASTERIZATION_HPP
+
+#include <cslibs_ndt/common/parallel.hpp>
+
+#include <Eigen/Eigen>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace cslibs_ndt_2d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief The four weighted gaussians of a bundle, extracted once so that pixels can be sampled
+ *        concurrently and with all four exponentials evaluated at once.
+ */
+struct EIGEN_ALIGN16 BundleGaussians
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using allocator_t = Eigen::aligned_allocator<BundleGaussians>;
+    using array_t     = Eigen::Array4d;
+
+    array_t mean_x = array_t::Zero();
+    array_t mean_y = array_t::Zero();
+    array_t inf_xx = array_t::Zero();
+    array_t inf_xy = array_t::Zero();
+    array_t inf_yy = array_t::Zero();
+    array_t weight = array_t::Zero();
+
+    /**
+     * @brief Set the i-th gaussian, distributions with less than three samples do not contribute
+     *        like in sampleNonNormalized().
+     */
+    template<typename distribution_t>
+    inline void set(const std::size_t i,
+                    const distribution_t *d,
+                    const double w)
+    {
+        if (!d || d->getN() < 3 || w == 0.0)
+            return;
+
+        const auto &mean = d->getMean();
+        const auto &inf  = d->getInformationMatrix();
+        mean_x(i) = mean(0);
+        mean_y(i) = mean(1);
+        inf_xx(i) = inf(0,0);
+        inf_xy(i) = inf(0,1);
+        inf_yy(i) = inf(1,1);
+        weight(i) = w;
+    }
+
+    /**
+     * @brief Bounding box of the area in which the gaussians can sum up to the threshold: at least one of
+     *        the four has to reach a quarter of it, i.e. has to lie within its ellipse w exp(-0.5 m) >= t / 4.
+     * @return false if the threshold cannot be reached at all
+     */
+    inline bool bounds(const double threshold,
+                       double &min_x, double &min_y,
+                       double &max_x, double &max_y) const
+    {
+        if (weight.sum() < threshold)
+            return false;
+
+        min_x = min_y = std::numeric_limits<double>::max();
+        max_x = max_y = std::numeric_limits<double>::lowest();
+        for (std::size_t i = 0 ; i < 4 ; ++i) {
+            const double r2 = 2.0 * std::log(4.0 * weight(i) / threshold);
+            if (!(r2 > 0.0))
+                continue;
+
+            /// half extents of the ellipse are r sqrt(S_xx) and r sqrt(S_yy) with S the covariance
+            const double det = inf_xx(i) * inf_yy(i) - inf_xy(i) * inf_xy(i);
+            const double hx  = std::sqrt(r2 * inf_yy(i) / det);
+            const double hy  = std::sqrt(r2 * inf_xx(i) / det);
+            if (!(det > 0.0) || !std::isfinite(hx) || !std::isfinite(hy)) {
+                min_x = min_y = std::numeric_limits<double>::lowest();
+                max_x = max_y = std::numeric_limits<double>::max();
+                return true;
+            }
+            min_x = std::min(min_x, mean_x(i) - hx);
+            max_x = std::max(max_x, mean_x(i) + hx);
+            min_y = std::min(min_y, mean_y(i) - hy);
+            max_y = std::max(max_y, mean_y(i) + hy);
+        }
+        return min_x <= max_x;
+    }
+
+    /**
+     * @brief Sample a column of pixels at x, starting at y0 with a step of dy,
+     *        the terms depending on x only are evaluated once.
+     */
+    template<typename output_t>
+    inline void sampleColumn(const double x,
+                             const double y0,
+                             const double step,
+                             const int    count,
+                             const output_t &output) const
+    {
+        const array_t dx = x - mean_x;
+        const array_t c  = -0.5 * inf_xx * dx.square();
+        const array_t b  = -inf_xy * dx;
+        const array_t a  = -0.5 * inf_yy;
+        array_t dy = y0 - mean_y;
+        for (int l = 0 ; l < count ; ++l, dy += step)
+            output(l, (weight * (c + dy * (b + a * dy)).exp()).sum());
+    }
+};
+
+/**
+ * @brief Rasterizes bundles into a gridmap, every bundle covers a block of chunk_step x chunk_step pixels.
+ *        Bundles are gathered sequentially, since the distributions update lazily, and are sampled in
+ *        parallel afterwards, each thread writes a disjoint range of blocks.
+ */
+class Rasterizer
+{
+public:
+    using index_t = std::array<int, 2>;
+
+    inline Rasterizer(const index_t &min_bi,
+                      const double   bundle_resolution,
+                      const double   sampling_resolution) :
+        min_bi_(min_bi),
+        bundle_resolution_(bundle_resolution),
+        sampling_resolution_(sampling_resolution),
+        chunk_step_(static_cast<int>(bundle_resolution / sampling_resolution))
+    {
+    }
+
+    inline BundleGaussians& add(const index_t &bi)
+    {
+        indices_.emplace_back(bi);
+        gaussians_.emplace_back();
+        return gaussians_.back();
+    }
+
+    inline std::size_t size() const
+    {
+        return indices_.size();
+    }
+
+    /**
+     * @brief Sample all gathered bundles.
+     * @param dst       gridmap providing at(x, y)
+     * @param convert   maps the sampled value to the stored cell value
+     */
+    template<typename dst_map_t, typename convert_t>
+    inline void apply(dst_map_t &dst,
+                      const convert_t &convert) const
+    {
+        cslibs_ndt::parallel(indices_.size(), MIN_BUNDLES_PER_THREAD,
+                             [this, &dst, &convert](const std::size_t begin, const std::size_t end) {
+            for (std::size_t b = begin ; b < end ; ++b) {
+                const index_t         &bi = indices_[b];
+                const BundleGaussians &g  = gaussians_[b];
+                const double x0 = bi[0] * bundle_resolution_;
+                const double y0 = bi[1] * bundle_resolution_;
+                const int    u0 = (bi[0] - min_bi_[0]) * chunk_step_;
+                const int    v0 = (bi[1] - min_bi_[1]) * chunk_step_;
+                for (int k = 0 ; k < chunk_step_ ; ++ k) {
+                    g.sampleColumn(x0 + k * sampling_resolution_, y0, sampling_resolution_, chunk_step_,
+                                   [&dst, &convert, u0, v0, k](const int l, const double v) {
+                        dst.at(u0 + k, v0 + l) = convert(v);
+                    });
+                }
+            }
+        });
+    }
+
+    template<typename dst_map_t>
+    inline void apply(dst_map_t &dst) const
+    {
+        apply(dst, [](const double v) { return v; });
+    }
+
+    /**
+     * @brief Mark all pixels sampled at or above the threshold, only the parts of the bundles which
+     *        can reach it are sampled.
+     * @param seeds     row major pixel mask of the destination, set to 1 for marked pixels
+     * @param width     width of the destination in pixels
+     */
+    inline void seed(std::vector<unsigned char> &seeds,
+                     const std::size_t width,
+                     const double threshold) const
+    {
+        cslibs_ndt::parallel(indices_.size(), MIN_BUNDLES_PER_THREAD,
+                             [this, &seeds, width, threshold](const std::size_t begin, const std::size_t end) {
+            for (std::size_t b = begin ; b < end ; ++b) {
+                const index_t         &bi = indices_[b];
+                const BundleGaussians &g  = gaussians_[b];
+                const double x0 = bi[0] * bundle_resolution_;
+                const double y0 = bi[1] * bundle_resolution_;
+                const int    u0 = (bi[0] - min_bi_[0]) * chunk_step_;
+                const int    v0 = (bi[1] - min_bi_[1]) * chunk_step_;
+
+                double min_x, min_y, max_x, max_y;
+                if (!g.bounds(threshold, min_x, min_y, max_x, max_y))
+                    continue;
+                const int k0 = toPixel(std::floor((min_x - x0) / sampling_resolution_));
+                const int k1 = toPixel(std::ceil ((max_x - x0) / sampling_resolution_));
+                const int l0 = toPixel(std::floor((min_y - y0) / sampling_resolution_));
+                const int l1 = toPixel(std::ceil ((max_y - y0) / sampling_resolution_));
+                for (int k = k0 ; k <= k1 ; ++ k) {
+                    g.sampleColumn(x0 + k * sampling_resolution_, y0 + l0 * sampling_resolution_, sampling_resolution_, l1 - l0 + 1,
+                                   [&seeds, width, threshold, u0, v0, k, l0](const int l, const double v) {
+                        if (v >= threshold)
+                            seeds[static_cast<std::size_t>(v0 + l0 + l) * width + static_cast<std::size_t>(u0 + k)] = 1;
+                    });
+                }
+            }
+        });
+    }
+
+private:
+    /// small maps are not worth spawning threads
+    static constexpr std::size_t MIN_BUNDLES_PER_THREAD = 64;
+
+    const index_t   min_bi_;
+    const double    bundle_resolution_;
+    const double    sampling_resolution_;
+    const int       chunk_step_;
+
+    /// clamp to the pixels of a bundle
+    inline int toPixel(const double v) const
+    {
+        return static_cast<int>(std::max(0.0, std::min(static_cast<double>(chunk_step_ - 1), v)));
+    }
+
+    std::vector<index_t>                                        indices_;
+    std::vector<BundleGaussians, BundleGaussians::allocator_t>  gaussians_;
+};
+
+/**
+ * @brief Set the gaussians of a gridmap bundle, all are weighted equally.
+ */
+template<typename bundle_t>
+inline void setBundle(const bundle_t &b,
+                      BundleGaussians &g)
+{
+    for (std::size_t i = 0 ; i < 4 ; ++i)
+        g.set(i, &(b.at(i)->data()), 0.25);
+}
+
+/**
+ * @brief Set the gaussians of an occupancy gridmap bundle, each is weighted by its occupancy.
+ */
+template<typename bundle_t, typename inverse_model_t>
+inline void setOccupancyBundle(const bundle_t &b,
+                               const inverse_model_t &inverse_model,
+                               BundleGaussians &g)
+{
+    for (std::size_t i = 0 ; i < 4 ; ++i) {
+        const auto *d = b.at(i);
+        if (d && d->getDistribution())
+            g.set(i, d->getDistribution().get(), 0.25 * d->getOccupancy(inverse_model));
+    }
+}
+
+template<typename src_map_t>
+inline void gather(const src_map_t &src,
+                   Rasterizer &rasterizer)
+{
+    src.traverse([&rasterizer](const typename src_map_t::index_t &bi,
+                               const typename src_map_t::distribution_bundle_t &b) {
+        setBundle(b, rasterizer.add(bi));
+    });
+}
+
+template<typename src_map_t, typename inverse_model_t>
+inline void gather(const src_map_t &src,
+                   const inverse_model_t &inverse_model,
+                   Rasterizer &rasterizer)
+{
+    src.traverse([&rasterizer, &inverse_model](const typename src_map_t::index_t &bi,
+                                               const typename src_map_t::distribution_bundle_t &b) {
+        setOccupancyBundle(b, inverse_model, rasterizer.add(bi));
+    });
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_CONVERSION_RASTERIZATION_HPP
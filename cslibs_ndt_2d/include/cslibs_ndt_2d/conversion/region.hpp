@@ -0,0 +1,217 @@
+#ifndef CSLIBS_NDT_2D_CONVERSION_REGION_HPP
+#define CSLIBS_NDT_2D_CONVERSION_REGION_HPP
+
+#include <cslibs_ndt_2d/conversion/rasterization.hpp>
+#include <cslibs_ndt_2d/conversion/distance_field.hpp>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+#include <cslibs_math_2d/linear/point.hpp>
+
+#include <cslibs_gridmaps/static_maps/probability_gridmap.h>
+
+#include <cmath>
+#include <limits>
+
+namespace cslibs_ndt_2d {
+namespace conversion {
+/**
+ * @brief Axis aligned box in world coordinates, e.g. the window of a local costmap around the robot.
+ */
+class Region
+{
+public:
+    inline Region(const cslibs_math_2d::Point2d &min,
+                  const cslibs_math_2d::Point2d &max) :
+        min_(min),
+        max_(max)
+    {
+    }
+
+    inline Region(const cslibs_math_2d::Point2d &center,
+                  const double size_x,
+                  const double size_y) :
+        min_(center(0) - 0.5 * size_x, center(1) - 0.5 * size_y),
+        max_(center(0) + 0.5 * size_x, center(1) + 0.5 * size_y)
+    {
+    }
+
+    inline const cslibs_math_2d::Point2d& getMin() const
+    {
+        return min_;
+    }
+
+    inline const cslibs_math_2d::Point2d& getMax() const
+    {
+        return max_;
+    }
+
+private:
+    cslibs_math_2d::Point2d min_;
+    cslibs_math_2d::Point2d max_;
+};
+
+namespace impl {
+/**
+ * @brief Bundles gathered for a region, the destination covers the bundles intersecting the region and
+ *        lies border pixels inside the gathered extent of width x height pixels.
+ */
+class RegionRasterizer : public Rasterizer
+{
+public:
+    inline RegionRasterizer(const index_t    &min_bi,
+                            const double      bundle_resolution,
+                            const double      sampling_resolution,
+                            const std::size_t border,
+                            const std::size_t width,
+                            const std::size_t height) :
+        Rasterizer(min_bi, bundle_resolution, sampling_resolution),
+        border_(border),
+        width_(width),
+        height_(height)
+    {
+    }
+
+    inline std::size_t getBorder() const
+    {
+        return border_;
+    }
+
+    inline std::size_t getWidth() const
+    {
+        return width_;
+    }
+
+    inline std::size_t getHeight() const
+    {
+        return height_;
+    }
+
+private:
+    const std::size_t border_;
+    const std::size_t width_;
+    const std::size_t height_;
+};
+
+/**
+ * @brief Prepare the conversion of the bundles intersecting a region. The destination covers exactly
+ *        these bundles, it is reused if it already has the same extent, so that a local map updated
+ *        at a high rate does not reallocate unless the window moves by a bundle.
+ * @param src           source map, bundles in the region are completed by allocating their neighbours
+ * @param region        region in world coordinates
+ * @param margin        bundles within this distance around the region are gathered as well, e.g. the
+ *                      maximum distance of a distance field, zero if only the region is sampled
+ * @param dst           destination, (re)allocated and cleared
+ * @param set_bundle    sets the gaussians of a bundle
+ * @return the rasterizer holding the bundles in the region and its margin
+ */
+template<typename src_map_t, typename dst_map_ptr_t, typename set_bundle_t>
+inline RegionRasterizer gatherRegion(src_map_t &src,
+                                     const Region &region,
+                                     const double sampling_resolution,
+                                     const double margin,
+                                     dst_map_ptr_t &dst,
+                                     const set_bundle_t &set_bundle)
+{
+    using index_t   = Rasterizer::index_t;
+    using point_t   = cslibs_math_2d::Point2d;
+    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
+
+    const double bundle_resolution = src.getBundleResolution();
+
+    /// bounding box of the region in map coordinates
+    const auto m_T_w = src.getInitialOrigin().inverse();
+    const point_t corners[4] = {region.getMin(),
+                                point_t(region.getMax()(0), region.getMin()(1)),
+                                point_t(region.getMin()(0), region.getMax()(1)),
+                                region.getMax()};
+    double min[2] = { std::numeric_limits<double>::max(),    std::numeric_limits<double>::max()};
+    double max[2] = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+    for (const point_t &c : corners) {
+        const point_t c_m = m_T_w * c;
+        for (std::size_t i = 0 ; i < 2 ; ++i) {
+            min[i] = std::min(min[i], c_m(i));
+            max[i] = std::max(max[i], c_m(i));
+        }
+    }
+    const index_t min_bi = {{static_cast<int>(std::floor(min[0] / bundle_resolution)),
+                             static_cast<int>(std::floor(min[1] / bundle_resolution))}};
+    const index_t max_bi = {{static_cast<int>(std::floor(max[0] / bundle_resolution)),
+                             static_cast<int>(std::floor(max[1] / bundle_resolution))}};
+
+    /// pixels only depend on the bundle they lie in, so a margin of whole bundles suffices
+    const int     m          = static_cast<int>(std::ceil(std::max(0.0, margin) / bundle_resolution));
+    const index_t min_bi_m   = {{min_bi[0] - m, min_bi[1] - m}};
+    const index_t max_bi_m   = {{max_bi[0] + m, max_bi[1] + m}};
+
+    /// partially allocated bundles at the border are completed by neighbours outside of the gathered ones
+    std::vector<index_t> allocated;
+    for (int i = min_bi_m[0] - 1 ; i <= max_bi_m[0] + 1 ; ++i)
+        for (int j = min_bi_m[1] - 1 ; j <= max_bi_m[1] + 1 ; ++j)
+            if (src.get(index_t{{i, j}}))
+                allocated.push_back({{i, j}});
+    src.allocatePartiallyAllocatedBundles(allocated);
+
+    const std::size_t chunk_step = static_cast<std::size_t>(bundle_resolution / sampling_resolution);
+    const std::size_t width      = static_cast<std::size_t>(max_bi[0] - min_bi[0] + 1) * chunk_step;
+    const std::size_t height     = static_cast<std::size_t>(max_bi[1] - min_bi[1] + 1) * chunk_step;
+    const std::size_t border     = static_cast<std::size_t>(m) * chunk_step;
+
+    typename src_map_t::pose_t origin = src.getInitialOrigin();
+    origin.translation() += point_t(min_bi[0] * bundle_resolution,
+                                    min_bi[1] * bundle_resolution);
+
+    auto fits = [&dst, &origin, width, height, sampling_resolution]() {
+        const auto dst_origin = dst->getOrigin();
+        return dst->getWidth() == width && dst->getHeight() == height &&
+               dst->getResolution() == sampling_resolution &&
+               std::abs(dst_origin.tx() - origin.tx()) < 0.5 * sampling_resolution &&
+               std::abs(dst_origin.ty() - origin.ty()) < 0.5 * sampling_resolution;
+    };
+    if (!dst || !fits())
+        dst.reset(new dst_map_t(origin, sampling_resolution, height, width));
+    std::fill(dst->getData().begin(), dst->getData().end(), 0);
+
+    RegionRasterizer rasterizer(min_bi_m, bundle_resolution, sampling_resolution,
+                                border, width + 2 * border, height + 2 * border);
+    for (int i = min_bi_m[0] ; i <= max_bi_m[0] ; ++i) {
+        for (int j = min_bi_m[1] ; j <= max_bi_m[1] ; ++j) {
+            const index_t bi = {{i, j}};
+            const typename src_map_t::distribution_bundle_t *b = src.get(bi);
+            if (b)
+                set_bundle(*b, rasterizer.add(bi));
+        }
+    }
+    return rasterizer;
+}
+
+/**
+ * @brief Distance field of a region, computed on the gathered extent and cropped to the destination,
+ *        so that obstacles in the margin contribute like in the conversion of the whole map.
+ */
+template<typename dst_map_t>
+inline void distanceField(const RegionRasterizer &rasterizer,
+                          const double sampling_resolution,
+                          const double maximum_distance,
+                          const double threshold,
+                          dst_map_t &dst)
+{
+    const std::size_t width  = rasterizer.getWidth();
+    const std::size_t border = rasterizer.getBorder();
+    std::vector<double> data(width * rasterizer.getHeight());
+    distanceField(rasterizer, sampling_resolution, maximum_distance, threshold,
+                  width, rasterizer.getHeight(), data);
+
+    const std::size_t dst_width  = dst.getWidth();
+    const std::size_t dst_height = dst.getHeight();
+    std::vector<double> &dst_data = dst.getData();
+    for (std::size_t y = 0 ; y < dst_height ; ++y) {
+        const auto row = data.begin() + static_cast<std::ptrdiff_t>((y + border) * width + border);
+        std::copy(row, row + static_cast<std::ptrdiff_t>(dst_width),
+                  dst_data.begin() + static_cast<std::ptrdiff_t>(y * dst_width));
+    }
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_CONVERSION_REGION_HPP
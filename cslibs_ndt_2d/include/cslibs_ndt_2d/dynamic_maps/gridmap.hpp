@@ -5,12 +5,16 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 #include <cslibs_math_2d/linear/point.hpp>
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/common/unsaved_bundles.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -39,6 +43,7 @@ public:
     using transform_t                       = cslibs_math_2d::Transform2d;
     using point_t                           = cslibs_math_2d::Point2d;
     using index_t                           = std::array<int, 2>;
+    using index_set_t                       = std::unordered_set<index_t, cslibs_ndt::IndexHash<2>>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
     using distribution_t                    = cslibs_ndt::Distribution<2>;
@@ -122,7 +127,9 @@ public:
                   distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[1])),
                   distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[2])),
                   distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[3]))}},
-        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_))
+        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_)),
+        dirty_bundles_(other.dirty_bundles_),
+        unsaved_bundles_(other.unsaved_bundles_)
     {
     }
 
@@ -135,7 +142,9 @@ public:
         min_bundle_index_(other.min_bundle_index_),
         max_bundle_index_(other.max_bundle_index_),
         storage_(other.storage_),
-        bundle_storage_(other.bundle_storage_)
+        bundle_storage_(other.bundle_storage_),
+        dirty_bundles_(std::move(other.dirty_bundles_)),
+        unsaved_bundles_(std::move(other.unsaved_bundles_))
     {
     }
 
@@ -190,6 +199,7 @@ public:
     {
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle = getAllocate(bi);
+        markDirty(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -198,10 +208,17 @@ public:
 
     inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                        const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
     {
         distribution_storage_t storage;
-        for (const auto &p : *points) {
-            const point_t pm = points_origin * p;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
             if (pm.isNormal()) {
                 const index_t &bi = toBundleIndex(pm);
                 distribution_t *d = storage.get(bi);
@@ -211,6 +228,7 @@ public:
 
         storage.traverse([this](const index_t& bi, const distribution_t &d) {
             distribution_bundle_t *bundle = getAllocate(bi);
+            markDirty(bi);
             bundle->at(0)->data() += d.data();
             bundle->at(1)->data() += d.data();
             bundle->at(2)->data() += d.data();
@@ -336,6 +354,47 @@ public:
                 storage_[3]->byte_size();
     }
 
+    /**
+     * @brief Bundles allocated or updated since the last call of clearDirtyBundles().
+     *        Distributions are shared by neighbouring bundles, the samples of the
+     *        direct neighbours of a dirty bundle change as well.
+     */
+    inline const index_set_t& getDirtyBundles() const
+    {
+        return dirty_bundles_;
+    }
+
+    inline void clearDirtyBundles()
+    {
+        dirty_bundles_.clear();
+    }
+
+    /**
+     * @brief Bundles allocated or updated since a consumer saved the map, tracked independently of the
+     *        dirty bundles. Every consumer, e.g. a journal or an asynchronous saver, keeps its own revision.
+     * @param saved revision returned by the previous call of the consumer, 0 initially
+     * @param bis   changed bundles
+     * @return revision to pass to the next call, once the bundles are saved
+     */
+    inline uint64_t getUnsavedBundles(const uint64_t saved,
+                                      std::vector<index_t> &bis)
+    {
+        return unsaved_bundles_.get(saved, bis);
+    }
+
+    inline bool hasUnsavedBundles(const uint64_t saved = 0) const
+    {
+        return unsaved_bundles_.has(saved);
+    }
+
+    /**
+     * @brief Regard all bundles as saved by every consumer, e.g. after loading the map.
+     */
+    inline void clearUnsavedBundles()
+    {
+        unsaved_bundles_.clear();
+    }
+
     inline virtual bool validate(const pose_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w.translation();
@@ -350,7 +409,15 @@ public:
     {
         std::vector<index_t> bis;
         getBundleIndices(bis);
+        allocatePartiallyAllocatedBundles(bis);
+    }
 
+    /**
+     * @brief Allocate the neighbours of the given bundles only.
+     * @param bis   bundle indices, e.g. the dirty bundles
+     */
+    inline void allocatePartiallyAllocatedBundles(const std::vector<index_t> &bis)
+    {
         using neighborhood_t = cis::operations::clustering::GridNeighborhoodStatic<std::tuple_size<index_t>::value, 3>;
         static constexpr neighborhood_t grid{};
 
@@ -369,6 +436,87 @@ public:
         }
     }
 
+    /**
+     * @brief Allocate the given bundles with the distributions of the given storages, e.g. map tiles
+     *        loaded from disk. Distributions already present are kept.
+     */
+    inline void insertBundles(const std::vector<index_t>            &bis,
+                              const distribution_storage_array_t    &storages)
+    {
+        for (std::size_t i = 0 ; i < storage_.size() ; ++i) {
+            const distribution_storage_ptr_t &s = storage_[i];
+            storages[i]->traverse([&s](const index_t &index, const distribution_t &d) {
+                if (!s->get(index))
+                    s->insert(index, d);
+            });
+        }
+        /// loaded bundles are on disk already, only bundles allocated before keep their unsaved state
+        for (const index_t &bi : bis) {
+            if (!bundle_storage_->get(bi)) {
+                getAllocate(bi);
+                unsaved_bundles_.erase(bi);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the given bundles and the distributions no remaining bundle refers to, e.g. to unload
+     *        map tiles. The storages are rebuilt from the remaining bundles.
+     */
+    inline void eraseBundles(const std::vector<index_t> &bis)
+    {
+        if (bis.empty())
+            return;
+
+        const index_set_t erased(bis.begin(), bis.end());
+        distribution_storage_array_t      storage;
+        distribution_bundle_storage_ptr_t bundle_storage(new distribution_bundle_storage_t);
+
+        using cell_index_map_t = std::unordered_map<const distribution_t*, index_t>;
+        std::array<cell_index_map_t, std::tuple_size<distribution_storage_array_t>::value> cell_indices;
+        for (std::size_t i = 0 ; i < storage_.size() ; ++i) {
+            storage[i].reset(new distribution_storage_t);
+            cell_index_map_t &c = cell_indices[i];
+            storage_[i]->traverse([&c](const index_t &index, const distribution_t &d) {
+                c[&d] = index;
+            });
+        }
+
+        const index_t min_index = min_bundle_index_;
+        const index_t max_index = max_bundle_index_;
+        min_bundle_index_.fill(std::numeric_limits<int>::max());
+        max_bundle_index_.fill(std::numeric_limits<int>::min());
+        bool remaining = false;
+        bundle_storage_->traverse([this, &erased, &storage, &bundle_storage, &cell_indices, &remaining]
+                                  (const index_t &bi, const distribution_bundle_t &b) {
+            if (erased.count(bi) > 0)
+                return;
+
+            distribution_bundle_t bundle;
+            for (std::size_t i = 0 ; i < storage.size() ; ++i) {
+                const index_t &index = cell_indices[i].at(b.at(i));
+                distribution_t *d = storage[i]->get(index);
+                bundle[i] = d ? d : &(storage[i]->insert(index, *(b.at(i))));
+            }
+            bundle_storage->insert(bi, bundle);
+            updateIndices(bi);
+            remaining = true;
+        });
+
+        /// the bounds of an emptied map are kept, so that its extent stays valid
+        if (!remaining) {
+            min_bundle_index_ = min_index;
+            max_bundle_index_ = max_index;
+        }
+
+        storage_        = storage;
+        bundle_storage_ = bundle_storage;
+        for (const index_t &bi : bis) {
+            dirty_bundles_.erase(bi);
+            unsaved_bundles_.erase(bi);
+        }
+    }
+
 protected:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -380,6 +528,8 @@ protected:
     mutable index_t                                 max_bundle_index_;
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
+    mutable index_set_t                             dirty_bundles_;
+    mutable cslibs_ndt::UnsavedBundles<2>           unsaved_bundles_;
 
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
@@ -411,6 +561,7 @@ protected:
                 b[3] = getAllocate(storage_[3], storage_3_index);
 
                 updateIndices(bi);
+                markDirty(bi);
                 return &(bundle_storage_->insert(bi, b));
             };
             return bundle ? bundle : allocate_bundle();
@@ -419,6 +570,12 @@ protected:
         return get_allocate(bi);
     }
 
+    inline void markDirty(const index_t &bi) const
+    {
+        dirty_bundles_.insert(bi);
+        unsaved_bundles_.mark(bi);
+    }
+
     inline void updateIndices(const index_t &chunk_index) const
     {
         min_bundle_index_ = std::min(min_bundle_index_, chunk_index);
@@ -0,0 +1,225 @@
+#ifndef CSLIBS_NDT_2D_MAPPED_MAPS_GRIDMAP_HPP
+#define CSLIBS_NDT_2D_MAPPED_MAPS_GRIDMAP_HPP
+
+#include <cslibs_ndt_2d/serialization/map_file.hpp>
+#include <cslibs_ndt/serialization/shared_map.hpp>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+#include <cslibs_math_2d/linear/point.hpp>
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace cslibs_ndt_2d {
+namespace mapped_maps {
+/**
+ * @brief Read only gridmap served from a memory mapped map file, written by dynamic_maps::saveMapped().
+ *        Nothing is deserialized, bundles are looked up and sampled in place.
+ */
+class EIGEN_ALIGN16 Gridmap
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using ConstPtr              = std::shared_ptr<const Gridmap>;
+    using Ptr                   = std::shared_ptr<Gridmap>;
+    using pose_t                = cslibs_math_2d::Pose2d;
+    using transform_t           = cslibs_math_2d::Transform2d;
+    using point_t               = cslibs_math_2d::Point2d;
+    using index_t               = std::array<int, 2>;
+    using file_t                = cslibs_ndt::serialization::map_file::MappedMap<2>;
+    using distribution_t        = file_t::cell_t;
+    using distribution_bundle_t = file_t::bundle_t;
+
+    inline explicit Gridmap(const file_t::Ptr &file) :
+        file_(file),
+        resolution_(file->getHeader().resolution),
+        bundle_resolution_(0.5 * resolution_),
+        bundle_resolution_inv_(1.0 / bundle_resolution_),
+        w_T_m_(serialization::decodeOrigin(file->getHeader())),
+        m_T_w_(w_T_m_.inverse()),
+        min_bundle_index_(file->getMinBundleIndex()),
+        max_bundle_index_(file->getMaxBundleIndex())
+    {
+    }
+
+    inline bool empty() const
+    {
+        return file_->getBundleCount() == 0;
+    }
+
+    inline pose_t getOrigin() const
+    {
+        pose_t origin = w_T_m_;
+        origin.translation() += point_t(min_bundle_index_[0] * bundle_resolution_,
+                                        min_bundle_index_[1] * bundle_resolution_);
+        return origin;
+    }
+
+    inline pose_t getInitialOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline double sample(const point_t &p) const
+    {
+        return sample(p, toBundleIndex(p));
+    }
+
+    inline double sample(const point_t &p,
+                         const index_t &bi) const
+    {
+        const distribution_bundle_t *bundle = file_->getBundle(bi);
+        auto sample = [this, &p, bundle](const std::size_t i) {
+            const distribution_t *d = file_->getCell(*bundle, i);
+            return d ? file_t::sample(*d, p) : 0.0;
+        };
+        return bundle ? 0.25 * (sample(0) + sample(1) + sample(2) + sample(3)) : 0.0;
+    }
+
+    inline double sampleNonNormalized(const point_t &p) const
+    {
+        return sampleNonNormalized(p, toBundleIndex(p));
+    }
+
+    inline double sampleNonNormalized(const point_t &p,
+                                      const index_t &bi) const
+    {
+        const distribution_bundle_t *bundle = file_->getBundle(bi);
+        auto sample = [this, &p, bundle](const std::size_t i) {
+            const distribution_t *d = file_->getCell(*bundle, i);
+            return d ? file_t::sampleNonNormalized(*d, p) : 0.0;
+        };
+        return bundle ? 0.25 * (sample(0) + sample(1) + sample(2) + sample(3)) : 0.0;
+    }
+
+    inline const distribution_bundle_t* getDistributionBundle(const index_t &bi) const
+    {
+        return file_->getBundle(bi);
+    }
+
+    inline const distribution_bundle_t* getDistributionBundle(const point_t &p) const
+    {
+        return file_->getBundle(toBundleIndex(p));
+    }
+
+    /**
+     * @brief The i-th distribution of a bundle, nullptr if not allocated.
+     */
+    inline const distribution_t* getDistribution(const distribution_bundle_t &bundle,
+                                                 const std::size_t i) const
+    {
+        return file_->getCell(bundle, i);
+    }
+
+    inline index_t getMinBundleIndex() const
+    {
+        return min_bundle_index_;
+    }
+
+    inline index_t getMaxBundleIndex() const
+    {
+        return max_bundle_index_;
+    }
+
+    inline double getBundleResolution() const
+    {
+        return bundle_resolution_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline double getHeight() const
+    {
+        return (max_bundle_index_[1] - min_bundle_index_[1] + 1) * bundle_resolution_;
+    }
+
+    inline double getWidth() const
+    {
+        return (max_bundle_index_[0] - min_bundle_index_[0] + 1) * bundle_resolution_;
+    }
+
+    template <typename Fn>
+    inline void traverse(const Fn& function) const
+    {
+        file_->traverse(function);
+    }
+
+    inline void getBundleIndices(std::vector<index_t> &indices) const
+    {
+        indices.reserve(indices.size() + file_->getBundleCount());
+        file_->traverse([&indices](const index_t &bi, const distribution_bundle_t &) {
+            indices.emplace_back(bi);
+        });
+    }
+
+    inline const file_t::Ptr& getFile() const
+    {
+        return file_;
+    }
+
+    /**
+     * @brief Heap memory used, the mapped file is paged in by the operating system on access.
+     */
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this);
+    }
+
+protected:
+    const file_t::Ptr   file_;
+    const double        resolution_;
+    const double        bundle_resolution_;
+    const double        bundle_resolution_inv_;
+    const transform_t   w_T_m_;
+    const transform_t   m_T_w_;
+    const index_t       min_bundle_index_;
+    const index_t       max_bundle_index_;
+
+    inline index_t toBundleIndex(const point_t &p_w) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        return {{static_cast<int>(std::floor(p_m(0) * bundle_resolution_inv_)),
+                 static_cast<int>(std::floor(p_m(1) * bundle_resolution_inv_))}};
+    }
+};
+
+/**
+ * @brief Map a file written by dynamic_maps::saveMapped(), takes milliseconds independent of the map size.
+ */
+inline bool loadMapped(const std::string &path,
+                       Gridmap::Ptr &map)
+{
+    const Gridmap::file_t::Ptr file = Gridmap::file_t::open(path, cslibs_ndt::serialization::map_file::GRIDMAP);
+    if (!file)
+        return false;
+
+    map.reset(new Gridmap(file));
+    return true;
+}
+
+/**
+ * @brief Attach to the map currently published under the subscriber's name, read only and without copies.
+ *        The map stays valid when a newer version is published, compare version to subscriber.getVersion().
+ */
+inline bool attachShared(const cslibs_ndt::serialization::shared_map::Subscriber &subscriber,
+                         Gridmap::Ptr &map,
+                         uint64_t &version)
+{
+    const Gridmap::file_t::Ptr file =
+            subscriber.attach<2>(cslibs_ndt::serialization::map_file::GRIDMAP, version);
+    if (!file)
+        return false;
+
+    map.reset(new Gridmap(file));
+    return true;
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_MAPPED_MAPS_GRIDMAP_HPP
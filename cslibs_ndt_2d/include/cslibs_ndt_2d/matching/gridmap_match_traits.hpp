@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cslibs_ndt/matching/match_traits.hpp>
+#include <cslibs_ndt/matching/parameter.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/mono_gridmap.hpp>
+#include <cslibs_ndt_2d/matching/jacobian.hpp>
+#include <cslibs_ndt_2d/matching/hessian.hpp>
+#include <cslibs_ndt_2d/matching/kernel.hpp>
+
+namespace cslibs_ndt {
+namespace matching {
+
+template<typename MapT> struct IsGridmap2d : std::false_type {};
+template<> struct IsGridmap2d<cslibs_ndt_2d::dynamic_maps::Gridmap> : std::true_type {};
+template<> struct IsGridmap2d<cslibs_ndt_2d::static_maps::Gridmap> : std::true_type {};
+template<> struct IsGridmap2d<cslibs_ndt_2d::static_maps::mono::Gridmap> : std::true_type {};
+
+/**
+ * @brief Point to distribution matching for 2d gridmaps. The map is only read,
+ *        bundles which are not allocated are skipped, use allocatePartiallyAllocatedBundles()
+ *        on the map beforehand to cover the border regions.
+ */
+template<typename MapT>
+struct MatchTraits<MapT, typename std::enable_if<IsGridmap2d<MapT>::value>::type>
+{
+    static constexpr int LINEAR_DIMS  = 2;
+    static constexpr int ANGULAR_DIMS = 1;
+    using Jacobian              = cslibs_ndt_2d::matching::Jacobian;
+    using Hessian               = cslibs_ndt_2d::matching::Hessian;
+
+    using gradient_t            = Eigen::Matrix<double, 3, 1>;
+    using hessian_t             = Eigen::Matrix<double, 3, 3>;
+
+    using point_t               = cslibs_math_2d::Point2d;
+    using transform_t           = cslibs_math_2d::Transform2d;
+    using parameter_t           = cslibs_ndt::matching::Parameter;
+    using distribution_t        = typename MapT::distribution_t;
+
+    static transform_t makeTransform(const Eigen::Vector2d& linear,
+                                     const Eigen::Matrix<double, 1, 1>& angular)
+    {
+        return transform_t{linear.x(), linear.y(), angular(0)};
+    }
+
+    static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
+                                const point_t& point,
+                                const Jacobian& J,
+                                const Hessian& H,
+                                const parameter_t&,
+                                double& score,
+                                gradient_t& g,
+                                hessian_t& h)
+    {
+        auto evaluate = [&point_prime, &point, &J, &H, &score, &g, &h](const distribution_t* distribution_wrapper)
+        {
+            if (!distribution_wrapper)
+                return;
+
+            auto& d = distribution_wrapper->data();
+            if (d.getN() < 3)
+                return;
+
+            cslibs_ndt_2d::matching::computeGradient(point_prime.data(), point.data(),
+                                                     d.getMean(), d.getInformationMatrix(), 1.0,
+                                                     J, H, score, g, h);
+        };
+        visit(map, point, evaluate);
+    }
+
+private:
+    template<typename M, typename Fn>
+    static void visit(const M& map,
+                      const point_t& point,
+                      const Fn& fn)
+    {
+        const auto* bundle = map.get(point);
+        if (!bundle)
+            return;
+
+        for (const auto* distribution_wrapper : *bundle)
+            fn(distribution_wrapper);
+    }
+
+    /// the single layer map has exactly one distribution per cell
+    template<typename Fn>
+    static void visit(const cslibs_ndt_2d::static_maps::mono::Gridmap& map,
+                      const point_t& point,
+                      const Fn& fn)
+    {
+        fn(map.get(point));
+    }
+};
+
+}
+}
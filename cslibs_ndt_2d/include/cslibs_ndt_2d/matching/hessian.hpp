@@ -0,0 +1,57 @@
+#ifndef CSLIBS_NDT_2D_HESSIAN_HPP
+#define CSLIBS_NDT_2D_HESSIAN_HPP
+
+#include <Eigen/Eigen>
+
+namespace cslibs_ndt_2d {
+namespace matching {
+/**
+ * @brief Second order partials of the planar transform x' = R(yaw) * x + t,
+ *        only the yaw / yaw partial is non-zero.
+ */
+class EIGEN_ALIGN16 Hessian {
+public:
+    using point_t   = Eigen::Vector2d;
+    using matrix_t  = Eigen::Matrix2d;
+    using angular_t = Eigen::Matrix<double, 1, 1>;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    inline Hessian() :
+        angular_data_(matrix_t::Zero())
+    {
+    }
+
+    enum Partial{tx = 0, ty = 1, yaw = 2};
+
+    inline const point_t get(const std::size_t pi,
+                             const std::size_t pj,
+                             const point_t &p) const
+    {
+        assert(pi < 3);
+        assert(pj < 3);
+        return (pi < 2 || pj < 2) ? point_t::Zero().eval() : static_cast<point_t>(angular_data_ * p);
+    }
+
+    inline const matrix_t & angular() const
+    {
+        return angular_data_;
+    }
+
+    inline static void get(const angular_t &angular,
+                           Hessian &h)
+    {
+        const double s = std::sin(angular(0));
+        const double c = std::cos(angular(0));
+
+        h.angular_data_ << -c,  s,
+                           -s, -c;
+    }
+
+private:
+    matrix_t angular_data_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_2D_HESSIAN_HPP
@@ -0,0 +1,64 @@
+#ifndef CSLIBS_NDT_2D_JACOBIAN_HPP
+#define CSLIBS_NDT_2D_JACOBIAN_HPP
+
+#include <Eigen/Eigen>
+
+namespace cslibs_ndt_2d {
+namespace matching {
+/**
+ * @brief First order partials of the planar transform x' = R(yaw) * x + t
+ *        with respect to tx, ty and yaw.
+ */
+class EIGEN_ALIGN16 Jacobian {
+public:
+    using point_t   = Eigen::Vector2d;
+    using matrix_t  = Eigen::Matrix2d;
+    using angular_t = Eigen::Matrix<double, 1, 1>;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    inline Jacobian() :
+        angular_data_(matrix_t::Zero()),
+        rotation_(matrix_t::Identity())
+    {
+    }
+
+    enum Partial{tx = 0, ty = 1, yaw = 2};
+
+    inline const point_t get(const std::size_t  pi,
+                             const point_t &p) const
+    {
+        assert(pi < 3);
+        return pi < 2 ? static_cast<point_t>(point_t::Unit(pi)) : static_cast<point_t>(angular_data_ * p);
+    }
+
+    inline const matrix_t & angular() const
+    {
+        return angular_data_;
+    }
+
+    inline const matrix_t & rotation() const
+    {
+        return rotation_;
+    }
+
+    inline static void get(const angular_t &angular, /// linear components not required because the derivation is always the same
+                           Jacobian &j)
+    {
+        const double s = std::sin(angular(0));
+        const double c = std::cos(angular(0));
+
+        j.rotation_     <<  c, -s,
+                            s,  c;
+        j.angular_data_ << -s, -c,
+                            c, -s;
+    }
+
+private:
+    matrix_t angular_data_;
+    matrix_t rotation_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_2D_JACOBIAN_HPP
@@ -0,0 +1,70 @@
+#ifndef CSLIBS_NDT_2D_KERNEL_HPP
+#define CSLIBS_NDT_2D_KERNEL_HPP
+
+#include <cslibs_ndt_2d/matching/jacobian.hpp>
+#include <cslibs_ndt_2d/matching/hessian.hpp>
+
+namespace cslibs_ndt_2d {
+namespace matching {
+/**
+ * @brief Closed form contribution of a single point to score, gradient and hessian
+ *        of a normal distribution, s = weight * exp(-0.5 * scale * q^T * information * q).
+ *        The partials of tx and ty are unit vectors, therefore only the yaw terms
+ *        have to be evaluated. The hessian follows the convention of the 3d traits.
+ * @param point_prime   point before applying the current estimate
+ * @param point         point after applying the current estimate
+ * @param mean          mean of the distribution
+ * @param information   information matrix of the distribution
+ * @param weight        score scale
+ * @param scale         exponent scale, the derivatives are those of the unscaled information
+ *                      as in the 3d occupancy traits
+ */
+template<typename gradient_t, typename hessian_t>
+inline void computeGradient(const Eigen::Vector2d &point_prime,
+                            const Eigen::Vector2d &point,
+                            const Eigen::Vector2d &mean,
+                            const Eigen::Matrix2d &information,
+                            const double           weight,
+                            const Jacobian        &J,
+                            const Hessian         &H,
+                            double                &score,
+                            gradient_t            &g,
+                            hessian_t             &h,
+                            const double           scale = 1.0)
+{
+    const Eigen::Vector2d q = point - mean;
+    const Eigen::Vector2d a = information * q;
+    const double          s = weight * std::exp(-0.5 * scale * q.dot(a));
+    if (!std::isnormal(s) || s <= 1e-5)
+        return;
+
+    const Eigen::Vector2d j_yaw  = J.angular() * point_prime;
+    const Eigen::Vector2d h_yaw  = H.angular() * point_prime;
+    const Eigen::Vector2d ij_yaw = information * j_yaw;
+
+    /// q^T * information * J_i
+    const double b0 = a(0);
+    const double b1 = a(1);
+    const double b2 = a.dot(j_yaw);
+
+    g(0) += s * b0;
+    g(1) += s * b1;
+    g(2) += s * b2;
+
+    const double h00 = s * (information(0,0) + b0 * b0);
+    const double h01 = s * (information(0,1) + b0 * b1);
+    const double h02 = s * (ij_yaw(0)        + b0 * b2);
+    const double h11 = s * (information(1,1) + b1 * b1);
+    const double h12 = s * (ij_yaw(1)        + b1 * b2);
+    const double h22 = s * (j_yaw.dot(ij_yaw) + b2 * b2 + a.dot(h_yaw));
+
+    h(0,0) -= h00; h(0,1) -= h01; h(0,2) -= h02;
+    h(1,0) -= h01; h(1,1) -= h11; h(1,2) -= h12;
+    h(2,0) -= h02; h(2,1) -= h12; h(2,2) -= h22;
+
+    score += s;
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_KERNEL_HPP
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cslibs_ndt/matching/match_traits.hpp>
+#include <cslibs_ndt/matching/occupancy_parameter.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/matching/jacobian.hpp>
+#include <cslibs_ndt_2d/matching/hessian.hpp>
+#include <cslibs_ndt_2d/matching/kernel.hpp>
+
+namespace cslibs_ndt {
+namespace matching {
+
+template<typename MapT> struct IsOccupancyGridmap2d : std::false_type {};
+template<> struct IsOccupancyGridmap2d<cslibs_ndt_2d::dynamic_maps::OccupancyGridmap> : std::true_type {};
+template<> struct IsOccupancyGridmap2d<cslibs_ndt_2d::static_maps::OccupancyGridmap> : std::true_type {};
+
+template<typename MapT>
+struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap2d<MapT>::value>::type>
+{
+    static constexpr int LINEAR_DIMS  = 2;
+    static constexpr int ANGULAR_DIMS = 1;
+    using Jacobian      = cslibs_ndt_2d::matching::Jacobian;
+    using Hessian       = cslibs_ndt_2d::matching::Hessian;
+
+    using gradient_t    = Eigen::Matrix<double, 3, 1>;
+    using hessian_t     = Eigen::Matrix<double, 3, 3>;
+
+    using point_t       = cslibs_math_2d::Point2d;
+    using transform_t   = cslibs_math_2d::Transform2d;
+    using parameter_t   = cslibs_ndt::matching::OccupancyParameter;
+
+    static transform_t makeTransform(const Eigen::Vector2d& linear,
+                                     const Eigen::Matrix<double, 1, 1>& angular)
+    {
+        return transform_t{linear.x(), linear.y(), angular(0)};
+    }
+
+    static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
+                                const point_t& point,
+                                const Jacobian& J,
+                                const Hessian& H,
+                                const parameter_t& param,
+                                double& score,
+                                gradient_t& g,
+                                hessian_t& h)
+    {
+        static constexpr double d1 = 0.95;
+        static constexpr double d2 = 1 - d1;
+
+        const auto* bundle = map.get(point);
+        if (!bundle)
+            return;
+
+        // check occupancy value
+        if (param.occupancyThreshold() > 0.0)
+        {
+            double occupancy = 0.0;
+            for (const auto* distribution_wrapper : *bundle)
+                occupancy += distribution_wrapper->getOccupancy(param.inverseModel());
+            occupancy /= 4.0;
+
+            if (occupancy < param.occupancyThreshold())
+                return;
+        }
+
+        for (const auto* distribution_wrapper : *bundle)
+        {
+            const auto& d = distribution_wrapper->getDistribution();
+            if (!d || d->getN() < 3)
+                continue;
+
+            // the occupancy only weights the score and scales its exponent, as in the 3d traits
+            const double p_occ = distribution_wrapper->getOccupancy(param.inverseModel()); // no recompute: this uses a cached value
+            cslibs_ndt_2d::matching::computeGradient(point_prime.data(), point.data(),
+                                                     d->getMean(), d->getInformationMatrix(), d1 * p_occ,
+                                                     J, H, score, g, h, d2 * (1 - p_occ));
+        }
+    }
+};
+
+}
+}
@@ -0,0 +1,132 @@
+#ifndef CSLIBS_NDT_2D_SERIALIZATION_DYNAMIC_MAPS_TILES_HPP
+#define CSLIBS_NDT_2D_SERIALIZATION_DYNAMIC_MAPS_TILES_HPP
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/serialization/map_file.hpp>
+
+#include <cslibs_ndt/serialization/tiles.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cslibs_ndt_2d {
+namespace dynamic_maps {
+using GridmapTiles          = cslibs_ndt::serialization::tiles::Tiles<Gridmap, 2>;
+using OccupancyGridmapTiles = cslibs_ndt::serialization::tiles::Tiles<OccupancyGridmap, 2>;
+
+/**
+ * @brief Write the map as tiles of tile_size x tile_size bundles with a spatial index,
+ *        to be loaded partially by loadTiles().
+ */
+inline bool saveTiled(const Gridmap::Ptr &map,
+                      const std::string &path,
+                      const int tile_size = 64)
+{
+    return map && GridmapTiles::save(*map, serialization::encodeOrigin(map->getInitialOrigin()), path, tile_size);
+}
+
+inline bool saveTiled(const OccupancyGridmap::Ptr &map,
+                      const std::string &path,
+                      const int tile_size = 64)
+{
+    return map && OccupancyGridmapTiles::save(*map, serialization::encodeOrigin(map->getInitialOrigin()), path, tile_size);
+}
+
+/**
+ * @brief Open a tiled map for the given map, which has to share origin and resolution with the map saved.
+ */
+template <typename map_t>
+inline bool openTiled(const std::string &path,
+                      const map_t &map,
+                      typename cslibs_ndt::serialization::tiles::Tiles<map_t, 2>::Ptr &tiles)
+{
+    using tiles_t = cslibs_ndt::serialization::tiles::Tiles<map_t, 2>;
+
+    tiles = tiles_t::open(path);
+    if (!tiles)
+        return false;
+
+    const typename tiles_t::origin_t origin = serialization::encodeOrigin(map.getInitialOrigin());
+    bool matches = std::fabs(tiles->getResolution() - map.getResolution()) < 1e-6;
+    for (std::size_t i = 0 ; i < origin.size() ; ++i)
+        matches &= std::fabs(tiles->getOrigin()[i] - origin[i]) < 1e-6;
+    if (!matches) {
+        std::cerr << "Tiled map '" << path << "' does not match the origin or resolution of the map.\n";
+        tiles.reset();
+    }
+    return matches;
+}
+
+/**
+ * @brief Bundle index box covering the world frame box given by its corners.
+ */
+template <typename map_t>
+inline std::array<typename map_t::index_t, 2> toBundleBox(const map_t &map,
+                                                          const cslibs_math_2d::Point2d &min,
+                                                          const cslibs_math_2d::Point2d &max)
+{
+    using index_t = typename map_t::index_t;
+
+    const cslibs_math_2d::Transform2d m_T_w = map.getInitialOrigin().inverse();
+    const double bundle_resolution_inv = 1.0 / map.getBundleResolution();
+
+    index_t min_bi{{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+    index_t max_bi{{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+    for (const cslibs_math_2d::Point2d &corner : {min, max,
+                                                  cslibs_math_2d::Point2d(min(0), max(1)),
+                                                  cslibs_math_2d::Point2d(max(0), min(1))}) {
+        const cslibs_math_2d::Point2d p_m = m_T_w * corner;
+        for (std::size_t i = 0 ; i < 2 ; ++i) {
+            const int bi = static_cast<int>(std::floor(p_m(i) * bundle_resolution_inv));
+            min_bi[i] = std::min(min_bi[i], bi);
+            max_bi[i] = std::max(max_bi[i], bi);
+        }
+    }
+    return {{min_bi, max_bi}};
+}
+
+/**
+ * @brief Read and decode the tiles intersecting the world frame box in the background,
+ *        the map is updated by the next call of tiles->apply(map) or loadTiles().
+ */
+template <typename map_t>
+inline std::future<std::size_t> prefetchTiles(const typename cslibs_ndt::serialization::tiles::Tiles<map_t, 2>::Ptr &tiles,
+                                              const cslibs_math_2d::Point2d &min,
+                                              const cslibs_math_2d::Point2d &max,
+                                              const map_t &map)
+{
+    const std::array<typename map_t::index_t, 2> box = toBundleBox(map, min, max);
+    return tiles->prefetch(box[0], box[1]);
+}
+
+/**
+ * @brief Load the tiles intersecting the world frame box into the map.
+ */
+template <typename map_t>
+inline std::size_t loadTiles(const typename cslibs_ndt::serialization::tiles::Tiles<map_t, 2>::Ptr &tiles,
+                             const cslibs_math_2d::Point2d &min,
+                             const cslibs_math_2d::Point2d &max,
+                             map_t &map)
+{
+    const std::array<typename map_t::index_t, 2> box = toBundleBox(map, min, max);
+    return tiles->load(box[0], box[1], map);
+}
+
+/**
+ * @brief Remove the tiles intersecting the world frame box from the map.
+ */
+template <typename map_t>
+inline std::size_t unloadTiles(const typename cslibs_ndt::serialization::tiles::Tiles<map_t, 2>::Ptr &tiles,
+                               const cslibs_math_2d::Point2d &min,
+                               const cslibs_math_2d::Point2d &max,
+                               map_t &map)
+{
+    const std::array<typename map_t::index_t, 2> box = toBundleBox(map, min, max);
+    return tiles->unload(box[0], box[1], map);
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_SERIALIZATION_DYNAMIC_MAPS_TILES_HPP
@@ -0,0 +1,27 @@
+#ifndef CSLIBS_NDT_2D_SERIALIZATION_MAP_FILE_HPP
+#define CSLIBS_NDT_2D_SERIALIZATION_MAP_FILE_HPP
+
+#include <cslibs_ndt/serialization/map_file.hpp>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+
+namespace cslibs_ndt_2d {
+namespace serialization {
+inline std::array<double, 6> encodeOrigin(const cslibs_math_2d::Transform2d &origin)
+{
+    return {{origin.tx(), origin.ty(), origin.yaw(), 0.0, 0.0, 0.0}};
+}
+
+inline cslibs_math_2d::Transform2d decodeOrigin(const cslibs_ndt::serialization::map_file::Header &header)
+{
+    return cslibs_math_2d::Transform2d(header.origin[0], header.origin[1], header.origin[2]);
+}
+
+inline cslibs_math_2d::Transform2d decodeOrigin(const std::array<double, 6> &origin)
+{
+    return cslibs_math_2d::Transform2d(origin[0], origin[1], origin[2]);
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_SERIALIZATION_MAP_FILE_HPP
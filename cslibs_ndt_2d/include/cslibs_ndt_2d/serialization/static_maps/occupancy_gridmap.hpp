@@ -3,6 +3,7 @@
 
 #include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
 
+#include <cslibs_ndt/serialization/bundles.hpp>
 #include <cslibs_ndt/serialization/filesystem.hpp>
 #include <cslibs_ndt/serialization/storage.hpp>
 
@@ -17,8 +18,13 @@
 
 namespace cslibs_ndt_2d {
 namespace static_maps {
+/**
+ * @brief Write the map into a directory, with compact set indices are written as Morton ordered
+ *        delta and varint streams and the bundle list is derived from the storages (see indices.hpp).
+ */
 inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &map,
-                       const std::string &path)
+                       const std::string &path,
+                       const bool compact = false)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 4>;
@@ -40,17 +46,20 @@ inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &
     /// step three: we have our filesystem, now we write out the distributions file by file
     /// meta file
     const path_t path_file = path_t("map.yaml");
+    std::vector<index_t> indices;
+    map->getBundleIndices(indices);
     {
         std::ofstream out((path_root / path_file).string(), std::fstream::trunc);
         YAML::Emitter yaml(out);
         YAML::Node n;
-        std::vector<index_t> indices;
-        map->getBundleIndices(indices);
         n["origin"]     = map->getInitialOrigin();
         n["resolution"] = map->getResolution();
         n["size"]       = map->getSize();
         n["min_index"]  = map->getMinBundleIndex();
-        n["bundles"]    = indices;
+        if (compact)
+            n["encoding"] = "compact";
+        else
+            n["bundles"]  = indices;
         yaml << n;
     }
 
@@ -60,16 +69,18 @@ inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &
                                   map->getStorages()[2],
                                   map->getStorages()[3]}};
 
+    std::array<std::vector<index_t>, 4> cells;
     std::array<std::thread, 4> threads;
     std::atomic_bool success(true);
     for (std::size_t i = 0 ; i < 4 ; ++i)
-        threads[i] = std::thread([&storages, &paths, i, &success](){
-            success = success && binary_t::save(storages[i], paths[i]);
+        threads[i] = std::thread([&storages, &paths, &cells, i, compact, &success](){
+            success = success && (compact ? binary_t::saveCompact(storages[i], paths[i], cells[i]) :
+                                            binary_t::save(storages[i], paths[i]));
         });
     for (std::size_t i = 0 ; i < 4 ; ++i)
         threads[i].join();
 
-    return success;
+    return success && (!compact || cslibs_ndt::serialization::indices::saveBundles<2>(cells, indices, path_root / path_t("bundles.bin")));
 }
 
 inline bool loadBinary(const std::string &path,
@@ -109,20 +120,23 @@ inline bool loadBinary(const std::string &path,
     const cslibs_math_2d::Transform2d origin     = n["origin"].as<cslibs_math_2d::Transform2d>();
     const double                      resolution = n["resolution"].as<double>();
     const size_t                      size       = n["size"].as<size_t>();
-    const std::vector<index_t>        indices    = n["bundles"].as<std::vector<index_t>>();
+    const bool                        compact    = n["encoding"] && n["encoding"].as<std::string>() == "compact";
+    std::vector<index_t>              indices    = compact ? std::vector<index_t>() : n["bundles"].as<std::vector<index_t>>();
     const index_t                     min_index  = n["min_index"].as<index_t>();
 
     bundles->template set<cslibs_indexed_storage::option::tags::array_size>(size[0] * 2, size[1] * 2);
     bundles->template set<cslibs_indexed_storage::option::tags::array_offset>(min_index[0], min_index[1]);
 
+    std::array<std::vector<index_t>, 4> cells;
     std::array<std::thread, 4> threads;
     std::atomic_bool success(true);
     const index_t os = {{min_index[0] / 2, min_index[1] / 2}};
     for (std::size_t i = 0 ; i < 4 ; ++i) {
         const int off   = (i > 1) ? 1 : 0;
         const size_t sz = {{size[0] + off, size[1] + off}};
-        threads[i] = std::thread([&storages, &paths, i, &sz, &os, &success](){
-            success = success && binary_t::load(paths[i], storages[i], sz, os);
+        threads[i] = std::thread([&storages, &paths, &cells, i, sz, &os, compact, &success](){
+            success = success && (compact ? binary_t::loadCompact(paths[i], storages[i], sz, os, cells[i]) :
+                                            binary_t::load(paths[i], storages[i], sz, os));
         });
     }
     for (std::size_t i = 0 ; i < 4 ; ++i)
@@ -130,27 +144,10 @@ inline bool loadBinary(const std::string &path,
 
     if (!success)
         return false;
+    if (compact && !cslibs_ndt::serialization::indices::loadBundles<2>(path_root / path_t("bundles.bin"), cells, indices))
+        return false;
 
-    auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_bundle_t b;
-        const int divx = cslibs_math::common::div<int>(bi[0], 2);
-        const int divy = cslibs_math::common::div<int>(bi[1], 2);
-        const int modx = cslibs_math::common::mod<int>(bi[0], 2);
-        const int mody = cslibs_math::common::mod<int>(bi[1], 2);
-
-        const index_t storage_0_index = {{divx,        divy}};
-        const index_t storage_1_index = {{divx + modx, divy}};        /// shifted to the left
-        const index_t storage_2_index = {{divx,        divy + mody}}; /// shifted to the bottom
-        const index_t storage_3_index = {{divx + modx, divy + mody}}; /// shifted diagonally
-
-        b[0] = storages[0]->get(storage_0_index);
-        b[1] = storages[1]->get(storage_1_index);
-        b[2] = storages[2]->get(storage_2_index);
-        b[3] = storages[3]->get(storage_3_index);
-        bundles->insert(bi, b);
-    };
-    for(const index_t &index : indices)
-        allocate_bundle(index);
+    cslibs_ndt::serialization::allocateBundles<cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_bundle_t>(indices, storages, *bundles);
 
     map.reset(new cslibs_ndt_2d::static_maps::OccupancyGridmap(origin,
                                                                resolution,
@@ -298,6 +298,15 @@ public:
         return bundle ? evaluate() : 0.0;
     }
 
+    inline const distribution_bundle_t* get(const point_t &p) const
+    {
+        index_t bi;
+        if(!toBundleIndex(p, bi))
+            return nullptr;
+
+        return bundle_storage_->get(bi);
+    }
+
     inline const distribution_bundle_t* getDistributionBundle(const index_t &bi) const
     {
         return valid(bi) ? getAllocate(bi) : nullptr;
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/probability_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/binary_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/distance_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/likelihood_field_gridmap.hpp>
+
+#include <cslibs_gridmaps/static_maps/algorithms/distance_transform.hpp>
+
+#include <array>
+#include <limits>
+#include <random>
+
+const double RESOLUTION          = 1.0;
+const double SAMPLING_RESOLUTION = 0.05;
+const double MAXIMUM_DISTANCE    = 2.0;
+const double THRESHOLD           = 0.169;
+
+/// a room with some clutter
+cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr sampleMap(const std::size_t n,
+                                                    const unsigned int seed)
+{
+    using map_t   = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using point_t = cslibs_math_2d::Point2d;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> u(0.0, 20.0);
+    std::normal_distribution<double>       noise(0.0, 0.02);
+
+    map_t::Ptr map(new map_t(map_t::pose_t::identity(), RESOLUTION));
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        const double s = u(rng);
+        map->insert(point_t(s, noise(rng)));
+        map->insert(point_t(s, 20.0 + noise(rng)));
+        map->insert(point_t(noise(rng), s));
+        map->insert(point_t(20.0 + noise(rng), s));
+        if (i % 10 == 0)
+            map->insert(point_t(u(rng), u(rng)));
+    }
+    return map;
+}
+
+TEST(Test_cslibs_ndt_2d, testDistanceField)
+{
+    const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr map = sampleMap(5000, 42);
+
+    /// dense pipeline: probability image and distance transform
+    cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr probability;
+    cslibs_ndt_2d::conversion::from(map, probability, SAMPLING_RESOLUTION);
+    ASSERT_NE(probability, nullptr);
+
+    std::vector<double> expected(probability->getData().size(), 0.0);
+    cslibs_gridmaps::static_maps::algorithms::DistanceTransform<double> distance_transform(
+                SAMPLING_RESOLUTION, MAXIMUM_DISTANCE, THRESHOLD);
+    distance_transform.apply(probability->getData(), probability->getWidth(), expected);
+
+    /// distance field seeded from the distributions
+    cslibs_gridmaps::static_maps::DistanceGridmap::Ptr distance;
+    cslibs_ndt_2d::conversion::from(map, distance, SAMPLING_RESOLUTION, MAXIMUM_DISTANCE, THRESHOLD);
+    ASSERT_NE(distance, nullptr);
+
+    ASSERT_EQ(distance->getWidth(),       probability->getWidth());
+    ASSERT_EQ(distance->getHeight(),      probability->getHeight());
+    ASSERT_EQ(distance->getData().size(), expected.size());
+    for (std::size_t i = 0 ; i < expected.size() ; ++i)
+        EXPECT_NEAR(distance->getData()[i], expected[i], SAMPLING_RESOLUTION);
+}
+
+TEST(Test_cslibs_ndt_2d, testDistanceFieldExact)
+{
+    using map_t   = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using point_t = cslibs_math_2d::Point2d;
+
+    /// a short wall and a blob on a small grid, so that every pixel can be compared to every obstacle
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> u(0.5, 3.5);
+    std::normal_distribution<double>       noise(0.0, 0.02);
+
+    map_t::Ptr map(new map_t(map_t::pose_t::identity(), RESOLUTION));
+    for (std::size_t i = 0 ; i < 200 ; ++i) {
+        map->insert(point_t(u(rng), 0.5 + noise(rng)));
+        map->insert(point_t(3.0 + noise(rng), 2.5 + noise(rng)));
+    }
+
+    cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr probability;
+    cslibs_ndt_2d::conversion::from(map, probability, SAMPLING_RESOLUTION);
+    cslibs_gridmaps::static_maps::DistanceGridmap::Ptr distance;
+    cslibs_ndt_2d::conversion::from(map, distance, SAMPLING_RESOLUTION, MAXIMUM_DISTANCE, THRESHOLD);
+    ASSERT_NE(probability, nullptr);
+    ASSERT_NE(distance,    nullptr);
+
+    const std::size_t width  = probability->getWidth();
+    const std::size_t height = probability->getHeight();
+    ASSERT_EQ(distance->getWidth(),  width);
+    ASSERT_EQ(distance->getHeight(), height);
+
+    /// obstacles are the pixels of the probability image at or above the threshold
+    std::vector<std::array<long, 2>> obstacles;
+    for (std::size_t y = 0 ; y < height ; ++y)
+        for (std::size_t x = 0 ; x < width ; ++x)
+            if (probability->getData()[y * width + x] >= THRESHOLD)
+                obstacles.push_back({{static_cast<long>(x), static_cast<long>(y)}});
+    ASSERT_FALSE(obstacles.empty());
+
+    for (std::size_t y = 0 ; y < height ; ++y) {
+        for (std::size_t x = 0 ; x < width ; ++x) {
+            long min_squared = std::numeric_limits<long>::max();
+            for (const std::array<long, 2> &o : obstacles) {
+                const long dx = static_cast<long>(x) - o[0];
+                const long dy = static_cast<long>(y) - o[1];
+                min_squared = std::min(min_squared, dx * dx + dy * dy);
+            }
+            const double expected = std::min(std::sqrt(static_cast<double>(min_squared)) * SAMPLING_RESOLUTION, MAXIMUM_DISTANCE);
+            ASSERT_NEAR(distance->getData()[y * width + x], expected, 1e-9);
+        }
+    }
+}
+
+/// compares a region conversion with the same window cropped from the conversion of the whole map
+template<typename gridmap_ptr_t>
+void testCrop(const gridmap_ptr_t &full,
+              const gridmap_ptr_t &region)
+{
+    ASSERT_NE(full,   nullptr);
+    ASSERT_NE(region, nullptr);
+
+    const long offset_x = std::lround((region->getOrigin().tx() - full->getOrigin().tx()) / SAMPLING_RESOLUTION);
+    const long offset_y = std::lround((region->getOrigin().ty() - full->getOrigin().ty()) / SAMPLING_RESOLUTION);
+    ASSERT_GE(offset_x, 0);
+    ASSERT_GE(offset_y, 0);
+    ASSERT_LE(static_cast<std::size_t>(offset_x) + region->getWidth(),  full->getWidth());
+    ASSERT_LE(static_cast<std::size_t>(offset_y) + region->getHeight(), full->getHeight());
+
+    for (std::size_t y = 0 ; y < region->getHeight() ; ++y) {
+        for (std::size_t x = 0 ; x < region->getWidth() ; ++x) {
+            const std::size_t i = (y + static_cast<std::size_t>(offset_y)) * full->getWidth() + x + static_cast<std::size_t>(offset_x);
+            ASSERT_NEAR(region->getData()[y * region->getWidth() + x], full->getData()[i], 1e-9);
+        }
+    }
+}
+
+TEST(Test_cslibs_ndt_2d, testRegionConversion)
+{
+    const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr map = sampleMap(5000, 42);
+
+    /// a window cutting through the clutter, obstacles just outside of it have to be taken into account
+    const cslibs_ndt_2d::conversion::Region region(cslibs_math_2d::Point2d(7.3, 8.1), cslibs_math_2d::Point2d(12.2, 11.7));
+
+    cslibs_gridmaps::static_maps::DistanceGridmap::Ptr distance_region;
+    cslibs_ndt_2d::conversion::from(map, distance_region, SAMPLING_RESOLUTION, region, MAXIMUM_DISTANCE, THRESHOLD);
+    cslibs_gridmaps::static_maps::DistanceGridmap::Ptr distance;
+    cslibs_ndt_2d::conversion::from(map, distance, SAMPLING_RESOLUTION, MAXIMUM_DISTANCE, THRESHOLD);
+    testCrop(distance, distance_region);
+
+    cslibs_gridmaps::static_maps::LikelihoodFieldGridmap::Ptr likelihood_region;
+    cslibs_ndt_2d::conversion::from(map, likelihood_region, SAMPLING_RESOLUTION, region, MAXIMUM_DISTANCE, 0.5, THRESHOLD);
+    cslibs_gridmaps::static_maps::LikelihoodFieldGridmap::Ptr likelihood;
+    cslibs_ndt_2d::conversion::from(map, likelihood, SAMPLING_RESOLUTION, MAXIMUM_DISTANCE, 0.5, THRESHOLD);
+    testCrop(likelihood, likelihood_region);
+
+    cslibs_gridmaps::static_maps::BinaryGridmap::Ptr binary_region;
+    cslibs_ndt_2d::conversion::from(map, binary_region, SAMPLING_RESOLUTION, region, THRESHOLD);
+    cslibs_gridmaps::static_maps::BinaryGridmap::Ptr binary;
+    cslibs_ndt_2d::conversion::from(map, binary, SAMPLING_RESOLUTION, THRESHOLD);
+    testCrop(binary, binary_region);
+}
+
+TEST(Test_cslibs_ndt_2d, testIncrementalConversion)
+{
+    using point_t = cslibs_math_2d::Point2d;
+    const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr map = sampleMap(2000, 42);
+
+    cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr incremental;
+    cslibs_ndt_2d::conversion::from(map, incremental, SAMPLING_RESOLUTION);
+    ASSERT_NE(incremental, nullptr);
+    const cslibs_gridmaps::static_maps::ProbabilityGridmap *previous = incremental.get();
+
+    /// new clutter within the extent, partly in bundles which were empty so far
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> u(0.5, 19.5);
+    for (std::size_t i = 0 ; i < 200 ; ++i)
+        map->insert(point_t(u(rng), u(rng)));
+    cslibs_ndt_2d::conversion::update(map, incremental, SAMPLING_RESOLUTION);
+    EXPECT_EQ(incremental.get(), previous);
+
+    cslibs_gridmaps::static_maps::ProbabilityGridmap::Ptr full;
+    cslibs_ndt_2d::conversion::from(map, full, SAMPLING_RESOLUTION);
+    testCrop(full, incremental);
+
+    /// the map grows beyond its border, the conversion falls back to a full one
+    for (std::size_t i = 0 ; i < 50 ; ++i)
+        map->insert(point_t(21.0 + 0.01 * i, u(rng)));
+    cslibs_ndt_2d::conversion::update(map, incremental, SAMPLING_RESOLUTION);
+    cslibs_ndt_2d::conversion::from(map, full, SAMPLING_RESOLUTION);
+    ASSERT_NE(incremental, nullptr);
+    EXPECT_EQ(incremental->getWidth(),  full->getWidth());
+    EXPECT_EQ(incremental->getHeight(), full->getHeight());
+    testCrop(full, incremental);
+}
+
+int main(int argc, char *argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
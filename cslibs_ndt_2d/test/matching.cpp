@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/matching/match.hpp>
+#include <cslibs_ndt/matching/matcher.hpp>
+#include <cslibs_ndt_2d/matching/gridmap_match_traits.hpp>
+#include <cslibs_ndt_2d/matching/occupancy_gridmap_match_traits.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/gridmap.hpp>
+
+#include <random>
+
+using map_t       = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using point_t     = cslibs_math_2d::Point2d;
+using transform_t = cslibs_math_2d::Transform2d;
+using points_t    = std::vector<point_t>;
+
+/// walls of a 20 m x 20 m room seen from its center
+points_t sampleRoom(const std::size_t n,
+                    const unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> u(0.0, 20.0);
+    std::normal_distribution<double>       noise(0.0, 0.02);
+
+    points_t points;
+    points.reserve(4 * n);
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        const double s = u(rng);
+        points.emplace_back(point_t(s, noise(rng)));
+        points.emplace_back(point_t(s, 20.0 + noise(rng)));
+        points.emplace_back(point_t(noise(rng), s));
+        points.emplace_back(point_t(20.0 + noise(rng), s));
+    }
+    return points;
+}
+
+/// static gridmap of the points, converted from a dynamic one
+cslibs_ndt_2d::static_maps::Gridmap::Ptr staticGridmap(const points_t &points)
+{
+    using dynamic_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    const dynamic_map_t::Ptr map(new dynamic_map_t(transform_t(), 1.0));
+    for (const point_t &p : points)
+        map->insert(p);
+    return cslibs_ndt_2d::conversion::from(map);
+}
+
+TEST(Test_cslibs_ndt_2d, testOccupancyGridmapMatching)
+{
+    const point_t   sensor(10.0, 10.0);
+    const points_t  dst = sampleRoom(5000, 0u);
+    points_t        src = sampleRoom(5000, 1u);
+
+    map_t map(transform_t(), 1.0);
+    for (const point_t &p : dst)
+        map.insert(sensor, p);
+
+    const transform_t ground_truth(0.3, -0.2, 0.05);
+    const transform_t ground_truth_inverse = ground_truth.inverse();
+    for (point_t &p : src)
+        p = ground_truth_inverse * p;
+
+    cslibs_ndt::matching::Parameter parameter;
+    parameter.maxIterations() = 100;
+    const cslibs_ndt::matching::OccupancyParameter param(parameter, cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+
+    const auto r = cslibs_ndt::matching::match(src.begin(), src.end(), map, param, transform_t());
+
+    const transform_t &t = r.transform();
+    EXPECT_NEAR(t.tx(),  ground_truth.tx(),  0.05);
+    EXPECT_NEAR(t.ty(),  ground_truth.ty(),  0.05);
+    EXPECT_NEAR(t.yaw(), ground_truth.yaw(), 0.01);
+}
+
+/// matches a scan of the room displaced by the ground truth against the map
+template<typename ndt_t>
+void testMatching(const ndt_t &map)
+{
+    points_t src = sampleRoom(5000, 1u);
+
+    const transform_t ground_truth(0.3, -0.2, 0.05);
+    const transform_t ground_truth_inverse = ground_truth.inverse();
+    for (point_t &p : src)
+        p = ground_truth_inverse * p;
+
+    cslibs_ndt::matching::Parameter param;
+    param.maxIterations() = 100;
+
+    const auto r = cslibs_ndt::matching::match(src.begin(), src.end(), map, param, transform_t());
+
+    const transform_t &t = r.transform();
+    EXPECT_NEAR(t.tx(),  ground_truth.tx(),  0.05);
+    EXPECT_NEAR(t.ty(),  ground_truth.ty(),  0.05);
+    EXPECT_NEAR(t.yaw(), ground_truth.yaw(), 0.01);
+}
+
+TEST(Test_cslibs_ndt_2d, testStaticGridmapMatching)
+{
+    const cslibs_ndt_2d::static_maps::Gridmap::Ptr map = staticGridmap(sampleRoom(5000, 0u));
+    ASSERT_NE(map, nullptr);
+    testMatching(*map);
+}
+
+TEST(Test_cslibs_ndt_2d, testMonoGridmapMatching)
+{
+    using mono_map_t = cslibs_ndt_2d::static_maps::mono::Gridmap;
+
+    /// one cell of margin around the room
+    mono_map_t map(transform_t(), 1.0, mono_map_t::size_t{{23, 23}}, mono_map_t::index_t{{-1, -1}});
+    for (const point_t &p : sampleRoom(5000, 0u))
+        map.insert(p);
+    testMatching(map);
+}
+
+TEST(Test_cslibs_ndt_2d, testStaticGridmapMatcher)
+{
+    using static_map_t = cslibs_ndt_2d::static_maps::Gridmap;
+
+    const static_map_t::Ptr map = staticGridmap(sampleRoom(5000, 0u));
+    ASSERT_NE(map, nullptr);
+    points_t src = sampleRoom(5000, 1u);
+
+    const transform_t ground_truth(0.3, -0.2, 0.05);
+    const transform_t ground_truth_inverse = ground_truth.inverse();
+    for (point_t &p : src)
+        p = ground_truth_inverse * p;
+
+    cslibs_ndt::matching::Parameter param;
+    param.maxIterations() = 100;
+
+    /// static maps are read only, incremental mode must not try to update them
+    cslibs_ndt::matching::Matcher<static_map_t> matcher(param, map, true);
+    static_assert(!cslibs_ndt::matching::impl::IsInsertable<static_map_t, points_t::const_iterator>::value,
+                  "static gridmaps are read only");
+    const auto r = matcher.match(src.cbegin(), src.cend());
+
+    const transform_t &t = r.transform();
+    EXPECT_NEAR(t.tx(),  ground_truth.tx(),  0.05);
+    EXPECT_NEAR(t.ty(),  ground_truth.ty(),  0.05);
+    EXPECT_NEAR(t.yaw(), ground_truth.yaw(), 0.01);
+    EXPECT_NEAR(matcher.getPose().tx(), t.tx(), 1e-9);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -4,11 +4,17 @@
 #include <cslibs_ndt_2d/serialization/dynamic_maps/occupancy_gridmap.hpp>
 #include <cslibs_ndt_2d/serialization/static_maps/gridmap.hpp>
 #include <cslibs_ndt_2d/serialization/static_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/serialization/dynamic_maps/journal.hpp>
+#include <cslibs_ndt_2d/serialization/dynamic_maps/tiles.hpp>
+#include <cslibs_ndt_2d/mapped_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/mapped_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/serialization/pointcloud.hpp>
 
 #include <cslibs_ndt_2d/conversion/gridmap.hpp>
 #include <cslibs_ndt_2d/conversion/occupancy_gridmap.hpp>
 
 #include <cslibs_math/random/random.hpp>
+#include <algorithm>
 #include <fstream>
 
 const std::size_t MIN_NUM_SAMPLES = 10;
@@ -376,6 +382,358 @@ TEST(Test_cslibs_ndt_2d, testDynamicOccupancyGridmapFileBinarySerialization)
     testDynamicOccMap(map, map_from_file);
 }
 
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileLazySerialization)
+{
+    using map_t  = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using lazy_t = cslibs_ndt_2d::dynamic_maps::GridmapLazy;
+    const typename map_t::Ptr map = generateDynamicMap();
+    auto count = [](const typename map_t::distribution_storage_ptr_t &storage) {
+        std::size_t n = 0;
+        storage->traverse([&n](const typename map_t::index_t &, const typename map_t::distribution_t &) { ++n; });
+        return n;
+    };
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinary(map, "/tmp/dynamic_map_lazy_2d"));
+
+    // from file, meta data only
+    typename lazy_t::Ptr lazy;
+    ASSERT_TRUE(cslibs_ndt_2d::dynamic_maps::loadBinaryLazy("/tmp/dynamic_map_lazy_2d", lazy));
+    EXPECT_EQ(map->getMinBundleIndex(), lazy->getMinBundleIndex());
+    EXPECT_EQ(map->getMaxBundleIndex(), lazy->getMaxBundleIndex());
+    for (std::size_t i = 0 ; i < lazy_t::NUM_STORAGES ; ++i)
+        EXPECT_FALSE(lazy->isLoaded(i));
+
+    // a single storage
+    const typename map_t::distribution_storage_ptr_t storage = lazy->getStorage(0);
+    ASSERT_NE(storage, nullptr);
+    EXPECT_TRUE(lazy->isLoaded(0));
+    EXPECT_FALSE(lazy->isLoaded(1));
+    EXPECT_EQ(count(storage), count(map->getStorages()[0]));
+
+    // everything
+    testDynamicMap(map, lazy->getMap());
+    EXPECT_EQ(lazy->getStorage(0), storage);
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileMappedSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveMapped(map, "/tmp/dynamic_map_mapped_2d.bin"));
+
+    // from file, decoded
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::loadMapped("/tmp/dynamic_map_mapped_2d.bin", map_from_file));
+    testDynamicMap(map, map_from_file);
+
+    // from file, served in place
+    cslibs_ndt_2d::mapped_maps::Gridmap::Ptr map_mapped;
+    EXPECT_TRUE(cslibs_ndt_2d::mapped_maps::loadMapped("/tmp/dynamic_map_mapped_2d.bin", map_mapped));
+    ASSERT_NE(map_mapped, nullptr);
+    EXPECT_EQ(map->getMinBundleIndex(), map_mapped->getMinBundleIndex());
+    EXPECT_EQ(map->getMaxBundleIndex(), map_mapped->getMaxBundleIndex());
+    EXPECT_NEAR(map->getResolution(), map_mapped->getResolution(), 1e-9);
+
+    cslibs_ndt_2d::mapped_maps::OccupancyGridmap::Ptr map_wrong_type;
+    EXPECT_FALSE(cslibs_ndt_2d::mapped_maps::loadMapped("/tmp/dynamic_map_mapped_2d.bin", map_wrong_type));
+
+    using db_t = typename map_t::distribution_bundle_t;
+    map->traverse([&map, &map_mapped](const typename map_t::index_t &bi, const db_t &b) {
+        EXPECT_NE(map_mapped->getDistributionBundle(bi), nullptr);
+        const cslibs_math_2d::Point2d p(b.at(0)->data().getMean());
+        const double s = map->sample(p);
+        EXPECT_NEAR(s, map_mapped->sample(p), 1e-6 * std::max(1.0, s));
+        EXPECT_NEAR(map->sampleNonNormalized(p), map_mapped->sampleNonNormalized(p), 1e-6);
+    });
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicOccupancyGridmapFileMappedSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveMapped(map, "/tmp/dynamic_occ_map_mapped_2d.bin"));
+
+    // from file, decoded
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::loadMapped("/tmp/dynamic_occ_map_mapped_2d.bin", map_from_file));
+    testDynamicOccMap(map, map_from_file);
+
+    // from file, served in place
+    cslibs_ndt_2d::mapped_maps::OccupancyGridmap::Ptr map_mapped;
+    EXPECT_TRUE(cslibs_ndt_2d::mapped_maps::loadMapped("/tmp/dynamic_occ_map_mapped_2d.bin", map_mapped));
+    ASSERT_NE(map_mapped, nullptr);
+
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    using db_t = typename map_t::distribution_bundle_t;
+    map->traverse([&map, &map_mapped, &ivm](const typename map_t::index_t &bi, const db_t &b) {
+        EXPECT_NE(map_mapped->getDistributionBundle(bi), nullptr);
+        for (std::size_t i = 0 ; i < db_t::size() ; ++ i) {
+            if (!b.at(i)->getDistribution())
+                continue;
+            const cslibs_math_2d::Point2d p(b.at(i)->getDistribution()->getMean());
+            const double s = map->sample(p, ivm);
+            EXPECT_NEAR(s, map_mapped->sample(p, ivm), 1e-6 * std::max(1.0, s));
+            EXPECT_NEAR(map->sampleNonNormalized(p, ivm), map_mapped->sampleNonNormalized(p, ivm), 1e-6);
+        }
+    });
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileTiledSerialization)
+{
+    using map_t   = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using tiles_t = cslibs_ndt_2d::dynamic_maps::GridmapTiles;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveTiled(map, "/tmp/dynamic_map_tiled_2d", 4));
+
+    // from file, everything
+    typename map_t::Ptr map_from_file(new map_t(map->getInitialOrigin(), map->getResolution()));
+    typename tiles_t::Ptr tiles;
+    ASSERT_TRUE(cslibs_ndt_2d::dynamic_maps::openTiled("/tmp/dynamic_map_tiled_2d", *map_from_file, tiles));
+    EXPECT_GT(cslibs_ndt_2d::dynamic_maps::loadTiles(tiles, cslibs_math_2d::Point2d(-100.0, -100.0), cslibs_math_2d::Point2d(100.0, 100.0), *map_from_file), 0ul);
+    testDynamicMap(map, map_from_file);
+    EXPECT_FALSE(map_from_file->hasUnsavedBundles());
+
+    // unload a part, only bundles of other tiles remain
+    const cslibs_math_2d::Point2d min = cslibs_math_2d::Point2d(-100.0, -100.0);
+    const cslibs_math_2d::Point2d max = cslibs_math_2d::Point2d(0.0, 100.0);
+    EXPECT_GT(cslibs_ndt_2d::dynamic_maps::unloadTiles(tiles, min, max, *map_from_file), 0ul);
+    const std::array<typename map_t::index_t, 2> box = cslibs_ndt_2d::dynamic_maps::toBundleBox(*map_from_file, min, max);
+    std::vector<typename map_t::index_t> unloaded = tiles->getTiles(box[0], box[1]);
+    std::vector<typename map_t::index_t> bis;
+    map_from_file->getBundleIndices(bis);
+    for (const typename map_t::index_t &bi : bis)
+        EXPECT_EQ(std::find(unloaded.begin(), unloaded.end(), tiles_t::toTileIndex(bi, tiles->getTileSize())), unloaded.end());
+
+    // reload asynchronously
+    cslibs_ndt_2d::dynamic_maps::prefetchTiles(tiles, min, max, *map_from_file).wait();
+    EXPECT_EQ(tiles->apply(*map_from_file), unloaded.size());
+    testDynamicMap(map, map_from_file);
+
+    // unload everything, the extent of the empty map stays valid
+    const typename map_t::index_t min_index = map_from_file->getMinBundleIndex();
+    const typename map_t::index_t max_index = map_from_file->getMaxBundleIndex();
+    EXPECT_GT(cslibs_ndt_2d::dynamic_maps::unloadTiles(tiles, cslibs_math_2d::Point2d(-100.0, -100.0), cslibs_math_2d::Point2d(100.0, 100.0), *map_from_file), 0ul);
+    bis.clear();
+    map_from_file->getBundleIndices(bis);
+    EXPECT_TRUE(bis.empty());
+    EXPECT_EQ(map_from_file->getMinBundleIndex(), min_index);
+    EXPECT_EQ(map_from_file->getMaxBundleIndex(), max_index);
+
+    // a prefetch which is not waited for must not block
+    cslibs_ndt_2d::dynamic_maps::prefetchTiles(tiles, min, max, *map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileJournaledSerialization)
+{
+    using map_t     = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using journal_t = cslibs_ndt_2d::dynamic_maps::GridmapJournal;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // initial snapshot
+    typename journal_t::Ptr journal;
+    ASSERT_TRUE(cslibs_ndt_2d::dynamic_maps::createJournal(map, "/tmp/dynamic_map_journal_2d", journal, 1e3));
+    EXPECT_FALSE(map->hasUnsavedBundles(journal->getSavedRevision()));
+    EXPECT_EQ(journal->getJournalSize(), 0ul);
+
+    // checkpoints only append the changes
+    rng_t<1> rng_coord(-10.0, 10.0);
+    for (int i = 0 ; i < 3 ; ++ i) {
+        for (int j = 0 ; j < 100 ; ++ j)
+            map->insert(cslibs_math_2d::Point2d(rng_coord.get(), rng_coord.get()));
+        EXPECT_TRUE(map->hasUnsavedBundles(journal->getSavedRevision()));
+        const std::size_t size = journal->getJournalSize();
+        EXPECT_TRUE(journal->checkpoint(*map));
+        EXPECT_GT(journal->getJournalSize(), size);
+        EXPECT_FALSE(map->hasUnsavedBundles(journal->getSavedRevision()));
+    }
+
+    // from snapshot and journal
+    typename map_t::Ptr map_from_file;
+    typename journal_t::Ptr journal_from_file;
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::openJournal("/tmp/dynamic_map_journal_2d", map_from_file, journal_from_file));
+    EXPECT_EQ(journal_from_file->getJournalSize(), journal->getJournalSize());
+    testDynamicMap(map, map_from_file);
+
+    // from compacted snapshot
+    EXPECT_TRUE(journal->compact(*map));
+    EXPECT_EQ(journal->getJournalSize(), 0ul);
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::openJournal("/tmp/dynamic_map_journal_2d", map_from_file, journal_from_file));
+    EXPECT_EQ(journal_from_file->getGeneration(), journal->getGeneration());
+    testDynamicMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileAsyncSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+    cslibs_ndt_2d::dynamic_maps::GridmapAsyncSaver saver;
+
+    // the snapshot is written while the map is modified
+    std::shared_future<bool> result = cslibs_ndt_2d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_map_async_2d");
+    rng_t<1> rng_coord(-10.0, 10.0);
+    for (int i = 0 ; i < 100 ; ++ i)
+        map->insert(cslibs_math_2d::Point2d(rng_coord.get(), rng_coord.get()));
+    EXPECT_TRUE(result.get());
+
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::loadBinary("/tmp/dynamic_map_async_2d", map_from_file));
+    testDynamicMap(saver.getSnapshot(), map_from_file);
+
+    // the next snapshot takes over the changes only
+    EXPECT_TRUE(map->hasUnsavedBundles(saver.getSavedRevision()));
+    result = cslibs_ndt_2d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_map_async_2d");
+    EXPECT_FALSE(map->hasUnsavedBundles(saver.getSavedRevision()));
+    EXPECT_TRUE(result.get());
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::loadBinary("/tmp/dynamic_map_async_2d", map_from_file));
+    testDynamicMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileJournaledAsyncSerialization)
+{
+    using map_t     = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using journal_t = cslibs_ndt_2d::dynamic_maps::GridmapJournal;
+    const typename map_t::Ptr map = generateDynamicMap();
+    cslibs_ndt_2d::dynamic_maps::GridmapAsyncSaver saver;
+
+    // both consumers start from the whole map
+    typename journal_t::Ptr journal;
+    ASSERT_TRUE(cslibs_ndt_2d::dynamic_maps::createJournal(map, "/tmp/dynamic_map_journal_async_2d", journal, 1e3));
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_map_async_journaled_2d").get());
+
+    // each consumer takes over the changes, regardless of the order
+    rng_t<1> rng_coord(-10.0, 10.0);
+    for (int i = 0 ; i < 2 ; ++ i) {
+        for (int j = 0 ; j < 100 ; ++ j)
+            map->insert(cslibs_math_2d::Point2d(rng_coord.get(), rng_coord.get()));
+        if (i == 0) {
+            EXPECT_TRUE(journal->checkpoint(*map));
+            EXPECT_TRUE(map->hasUnsavedBundles(saver.getSavedRevision()));
+            EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_map_async_journaled_2d").get());
+        } else {
+            EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_map_async_journaled_2d").get());
+            EXPECT_TRUE(map->hasUnsavedBundles(journal->getSavedRevision()));
+            EXPECT_TRUE(journal->checkpoint(*map));
+        }
+        EXPECT_FALSE(map->hasUnsavedBundles(journal->getSavedRevision()));
+        EXPECT_FALSE(map->hasUnsavedBundles(saver.getSavedRevision()));
+
+        typename map_t::Ptr map_from_file;
+        typename journal_t::Ptr journal_from_file;
+        EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::openJournal("/tmp/dynamic_map_journal_async_2d", map_from_file, journal_from_file));
+        testDynamicMap(map, map_from_file);
+        EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::loadBinary("/tmp/dynamic_map_async_journaled_2d", map_from_file));
+        testDynamicMap(map, map_from_file);
+    }
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapSharedSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // publish, starting over from versions left by previous runs
+    cslibs_ndt::serialization::shared_map::Publisher::unlink("/cslibs_ndt_2d_test_map");
+    cslibs_ndt::serialization::shared_map::Publisher::Ptr publisher =
+            cslibs_ndt::serialization::shared_map::Publisher::create("/cslibs_ndt_2d_test_map");
+    ASSERT_NE(publisher, nullptr);
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::publishShared(map, *publisher));
+    EXPECT_EQ(publisher->getVersion(), 1ul);
+
+    // attach, served in place
+    const cslibs_ndt::serialization::shared_map::Subscriber::Ptr subscriber =
+            cslibs_ndt::serialization::shared_map::Subscriber::open("/cslibs_ndt_2d_test_map");
+    ASSERT_NE(subscriber, nullptr);
+    cslibs_ndt_2d::mapped_maps::Gridmap::Ptr map_shared;
+    uint64_t version = 0;
+    EXPECT_TRUE(cslibs_ndt_2d::mapped_maps::attachShared(*subscriber, map_shared, version));
+    ASSERT_NE(map_shared, nullptr);
+    EXPECT_EQ(version, 1ul);
+    EXPECT_EQ(map->getMinBundleIndex(), map_shared->getMinBundleIndex());
+    EXPECT_EQ(map->getMaxBundleIndex(), map_shared->getMaxBundleIndex());
+
+    cslibs_ndt_2d::mapped_maps::OccupancyGridmap::Ptr map_wrong_type;
+    EXPECT_FALSE(cslibs_ndt_2d::mapped_maps::attachShared(*subscriber, map_wrong_type, version));
+
+    // swap, the map attached before stays valid
+    const typename map_t::Ptr map_next = generateDynamicMap();
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::publishShared(map_next, *publisher));
+    EXPECT_EQ(subscriber->getVersion(), 2ul);
+    cslibs_ndt_2d::mapped_maps::Gridmap::Ptr map_shared_next;
+    EXPECT_TRUE(cslibs_ndt_2d::mapped_maps::attachShared(*subscriber, map_shared_next, version));
+    ASSERT_NE(map_shared_next, nullptr);
+    EXPECT_EQ(version, 2ul);
+
+    using db_t = typename map_t::distribution_bundle_t;
+    auto compare = [](const typename map_t::Ptr &map, const cslibs_ndt_2d::mapped_maps::Gridmap::Ptr &map_shared) {
+        map->traverse([&map, &map_shared](const typename map_t::index_t &bi, const db_t &b) {
+            EXPECT_NE(map_shared->getDistributionBundle(bi), nullptr);
+            const cslibs_math_2d::Point2d p(b.at(0)->data().getMean());
+            const double s = map->sample(p);
+            EXPECT_NEAR(s, map_shared->sample(p), 1e-6 * std::max(1.0, s));
+        });
+    };
+    compare(map, map_shared);
+    compare(map_next, map_shared_next);
+
+    // restart, the subscriber opened before sees the versions continue
+    publisher.reset();
+    EXPECT_EQ(subscriber->getVersion(), 2ul);
+    publisher = cslibs_ndt::serialization::shared_map::Publisher::create("/cslibs_ndt_2d_test_map");
+    ASSERT_NE(publisher, nullptr);
+    EXPECT_EQ(publisher->getVersion(), 2ul);
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::publishShared(map, *publisher));
+    EXPECT_EQ(subscriber->getVersion(), 3ul);
+    cslibs_ndt_2d::mapped_maps::Gridmap::Ptr map_shared_restarted;
+    EXPECT_TRUE(cslibs_ndt_2d::mapped_maps::attachShared(*subscriber, map_shared_restarted, version));
+    ASSERT_NE(map_shared_restarted, nullptr);
+    EXPECT_EQ(version, 3ul);
+    compare(map, map_shared_restarted);
+
+    publisher.reset();
+    cslibs_ndt::serialization::shared_map::Publisher::unlink("/cslibs_ndt_2d_test_map");
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapPointcloudStreaming)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using cloud_point_t = std::array<float, 3>;
+    rng_t<1> rng_coord(-10.0, 10.0);
+
+    // two scans, the second one taken at pose
+    const std::size_t scan_size = 1000;
+    std::vector<cloud_point_t> points(2 * scan_size);
+    for (cloud_point_t &p : points)
+        p = {{static_cast<float>(rng_coord.get()), static_cast<float>(rng_coord.get()), static_cast<float>(rng_coord.get())}};
+    const cslibs_math_2d::Transform2d pose(1.0, 2.0, 0.3);
+    auto poses = [&pose](const std::size_t chunk) {
+        return chunk == 0 ? cslibs_math_2d::Transform2d() : pose;
+    };
+
+    typename map_t::Ptr map(new map_t(cslibs_math_2d::Transform2d(), 1.0));
+    for (std::size_t i = 0 ; i < points.size() ; ++ i) {
+        const cslibs_math_2d::Point2d p(points[i][0], points[i][1]);
+        map->insert(i < scan_size ? p : pose * p);
+    }
+
+    {
+        std::ofstream out("/tmp/pointcloud_2d.pcd", std::ios::binary);
+        out << "VERSION 0.7\nFIELDS x y z\nSIZE 4 4 4\nTYPE F F F\nCOUNT 1 1 1\nWIDTH " << points.size()
+            << "\nHEIGHT 1\nPOINTS " << points.size() << "\nDATA binary\n";
+        out.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(cloud_point_t));
+    }
+
+    typename map_t::Ptr map_streamed(new map_t(cslibs_math_2d::Transform2d(), 1.0));
+    EXPECT_TRUE(cslibs_ndt_2d::serialization::insertPointcloud("/tmp/pointcloud_2d.pcd", *map_streamed, scan_size, poses));
+    testDynamicMap(map, map_streamed);
+}
+
 TEST(Test_cslibs_ndt_2d, testStaticGridmapFileBinarySerialization)
 {
     using map_t = cslibs_ndt_2d::static_maps::Gridmap;
@@ -410,6 +768,74 @@ TEST(Test_cslibs_ndt_2d, testStaticOccupancyGridmapFileBinarySerialization)
     testStaticOccMap(map, map_from_file);
 }
 
+TEST(Test_cslibs_ndt_2d, testDynamicGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinary(map, "/tmp/dynamic_map_compact_2d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_2d::dynamic_maps::loadBinary("/tmp/dynamic_map_compact_2d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testDynamicMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testDynamicOccupancyGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::dynamic_maps::saveBinary(map, "/tmp/dynamic_occ_map_compact_2d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_2d::dynamic_maps::loadBinary("/tmp/dynamic_occ_map_compact_2d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testDynamicOccMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testStaticGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_2d::static_maps::Gridmap;
+    const typename map_t::Ptr map = cslibs_ndt_2d::conversion::from(generateDynamicMap());
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::static_maps::saveBinary(map, "/tmp/static_map_compact_2d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_2d::static_maps::loadBinary("/tmp/static_map_compact_2d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testStaticMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_2d, testStaticOccupancyGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_2d::static_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = cslibs_ndt_2d::conversion::from(generateDynamicOccMap());
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_2d::static_maps::saveBinary(map, "/tmp/static_occ_map_compact_2d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_2d::static_maps::loadBinary("/tmp/static_occ_map_compact_2d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testStaticOccMap(map, map_from_file);
+}
+
 int main(int argc, char *argv[])
 {
     testing::InitGoogleTest(&argc, argv);
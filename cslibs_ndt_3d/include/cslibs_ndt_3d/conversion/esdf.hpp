@@ -0,0 +1,534 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_ESDF_HPP
+#define CSLIBS_NDT_3D_CONVERSION_ESDF_HPP
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt/common/index_hash.hpp>
+
+#include <cslibs_math_3d/linear/pose.hpp>
+#include <cslibs_math_3d/linear/point.hpp>
+
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/common/mod.hpp>
+
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+/**
+ * @brief Sparse euclidean distance field of a 3D NDT map, stored in blocks of voxels up to a truncation distance.
+ *        Voxels whose center samples at or above a threshold are obstacles, all other voxels in reach store
+ *        the distance to their closest obstacle, so queries are a hash lookup and an array access.
+ *        Changes of obstacles are propagated incrementally as lower and raise waves (dynamic brushfire
+ *        after Lau et al.), which only visit voxels within the truncation distance of the changes.
+ *        NDT maps provide no inside / outside information, obstacle voxels have a distance of zero.
+ */
+class EIGEN_ALIGN16 Esdf
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr         = std::shared_ptr<Esdf>;
+    using ConstPtr    = std::shared_ptr<const Esdf>;
+    using index_t     = std::array<int, 3>;
+    using point_t     = cslibs_math_3d::Point3d;
+    using pose_t      = cslibs_math_3d::Pose3d;
+    using transform_t = cslibs_math_3d::Transform3d;
+
+    static constexpr int BLOCK_SIZE = 8;
+
+    /**
+     * @param w_T_m                 map origin, voxels are aligned with the map frame
+     * @param voxel_size            edge length of the voxels
+     * @param truncation_distance   distances beyond are not stored
+     * @param threshold             minimum sample of an obstacle voxel
+     */
+    inline Esdf(const pose_t &w_T_m,
+                const double voxel_size,
+                const double truncation_distance,
+                const double threshold) :
+        w_T_m_(w_T_m),
+        m_T_w_(w_T_m.inverse()),
+        voxel_size_(voxel_size),
+        voxel_size_inv_(1.0 / voxel_size),
+        truncation_distance_(truncation_distance),
+        threshold_(threshold),
+        max_squared_distance_(static_cast<int>(std::floor(truncation_distance * truncation_distance /
+                                                          (voxel_size * voxel_size))))
+    {
+    }
+
+    inline pose_t getInitialOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline double getVoxelSize() const
+    {
+        return voxel_size_;
+    }
+
+    inline double getTruncationDistance() const
+    {
+        return truncation_distance_;
+    }
+
+    inline double getThreshold() const
+    {
+        return threshold_;
+    }
+
+    inline std::size_t getBlockCount() const
+    {
+        return blocks_.size();
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) + blocks_.size() * (sizeof(Block) + sizeof(index_t) + sizeof(void*));
+    }
+
+    /**
+     * @brief Distance of a point in world coordinates to the closest obstacle, limited to the truncation distance.
+     */
+    inline double distance(const point_t &p_w) const
+    {
+        return distance(toVoxelIndex(p_w));
+    }
+
+    inline double distance(const index_t &vi) const
+    {
+        const Voxel *v = get(vi);
+        return (v && v->squared_distance <= max_squared_distance_) ?
+                    std::sqrt(static_cast<double>(v->squared_distance)) * voxel_size_ : truncation_distance_;
+    }
+
+    inline bool isObstacle(const point_t &p_w) const
+    {
+        return isObstacle(toVoxelIndex(p_w));
+    }
+
+    inline bool isObstacle(const index_t &vi) const
+    {
+        const Voxel *v = get(vi);
+        return v && v->obstacle;
+    }
+
+    inline index_t toVoxelIndex(const point_t &p_w) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        return {{static_cast<int>(std::floor(p_m(0) * voxel_size_inv_)),
+                 static_cast<int>(std::floor(p_m(1) * voxel_size_inv_)),
+                 static_cast<int>(std::floor(p_m(2) * voxel_size_inv_))}};
+    }
+
+    /**
+     * @brief Center of a voxel in world coordinates.
+     */
+    inline point_t toPoint(const index_t &vi) const
+    {
+        return w_T_m_ * point_t((vi[0] + 0.5) * voxel_size_,
+                                (vi[1] + 0.5) * voxel_size_,
+                                (vi[2] + 0.5) * voxel_size_);
+    }
+
+    /**
+     * @brief Mark a voxel as obstacle or free, takes effect with the next call of update().
+     */
+    inline void setObstacle(const index_t &vi,
+                            const bool obstacle)
+    {
+        if (obstacle) {
+            Voxel &v = getAllocate(vi);
+            if (v.obstacle)
+                return;
+            v.obstacle         = true;
+            v.raise            = false;
+            v.squared_distance = 0;
+            v.parent           = vi;
+            open_.push(entry_t(0, vi));
+        } else {
+            Voxel *v = get(vi);
+            if (!v || !v->obstacle)
+                return;
+            v->obstacle = false;
+            v->raise    = true;
+            v->clear();
+            open_.push(entry_t(0, vi));
+        }
+    }
+
+    /**
+     * @brief Propagate all pending changes.
+     */
+    inline void update()
+    {
+        while (!open_.empty()) {
+            const entry_t e = open_.top();
+            open_.pop();
+
+            Voxel *v = get(e.second);
+            if (!v)
+                continue;
+            if (v->raise)
+                raise(e.second, *v);
+            else if (e.first <= v->squared_distance && v->hasParent() && isObstacle(v->parent))
+                lower(e.second, *v);
+        }
+    }
+
+    inline void clear()
+    {
+        blocks_.clear();
+        open_ = queue_t();
+    }
+
+private:
+    struct Voxel
+    {
+        int     squared_distance = std::numeric_limits<int>::max();
+        bool    obstacle         = false;
+        bool    raise            = false;
+        index_t parent           = {{0, 0, 0}};
+
+        inline bool hasParent() const
+        {
+            return squared_distance != std::numeric_limits<int>::max();
+        }
+
+        inline void clear()
+        {
+            squared_distance = std::numeric_limits<int>::max();
+        }
+    };
+
+    struct Block
+    {
+        std::array<Voxel, BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE> voxels;
+    };
+
+    using block_map_t = std::unordered_map<index_t, std::unique_ptr<Block>, cslibs_ndt::IndexHash<3>>;
+    using entry_t     = std::pair<int, index_t>;
+    using queue_t     = std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>>;
+
+    const transform_t   w_T_m_;
+    const transform_t   m_T_w_;
+    const double        voxel_size_;
+    const double        voxel_size_inv_;
+    const double        truncation_distance_;
+    const double        threshold_;
+    const int           max_squared_distance_;
+
+    block_map_t         blocks_;
+    queue_t             open_;
+
+    inline static index_t toBlockIndex(const index_t &vi)
+    {
+        return {{cslibs_math::common::div<int>(vi[0], BLOCK_SIZE),
+                 cslibs_math::common::div<int>(vi[1], BLOCK_SIZE),
+                 cslibs_math::common::div<int>(vi[2], BLOCK_SIZE)}};
+    }
+
+    inline static std::size_t toLocalIndex(const index_t &vi)
+    {
+        return static_cast<std::size_t>(cslibs_math::common::mod<int>(vi[0], BLOCK_SIZE) +
+                                        BLOCK_SIZE * (cslibs_math::common::mod<int>(vi[1], BLOCK_SIZE) +
+                                                      BLOCK_SIZE * cslibs_math::common::mod<int>(vi[2], BLOCK_SIZE)));
+    }
+
+    inline const Voxel* get(const index_t &vi) const
+    {
+        const auto it = blocks_.find(toBlockIndex(vi));
+        return it != blocks_.end() ? &(it->second->voxels[toLocalIndex(vi)]) : nullptr;
+    }
+
+    inline Voxel* get(const index_t &vi)
+    {
+        const auto it = blocks_.find(toBlockIndex(vi));
+        return it != blocks_.end() ? &(it->second->voxels[toLocalIndex(vi)]) : nullptr;
+    }
+
+    inline Voxel& getAllocate(const index_t &vi)
+    {
+        std::unique_ptr<Block> &b = blocks_[toBlockIndex(vi)];
+        if (!b)
+            b.reset(new Block);
+        return b->voxels[toLocalIndex(vi)];
+    }
+
+    template<typename Fn>
+    inline static void visitNeighbours(const index_t &vi, const Fn &fn)
+    {
+        for (int dx = -1 ; dx <= 1 ; ++dx)
+            for (int dy = -1 ; dy <= 1 ; ++dy)
+                for (int dz = -1 ; dz <= 1 ; ++dz)
+                    if (dx != 0 || dy != 0 || dz != 0)
+                        fn(index_t{{vi[0] + dx, vi[1] + dy, vi[2] + dz}});
+    }
+
+    /// voxels which were closest to a removed obstacle lose their distance and are queued for re-seeding
+    inline void raise(const index_t &vi, Voxel &v)
+    {
+        visitNeighbours(vi, [this](const index_t &ni) {
+            Voxel *n = get(ni);
+            if (!n || n->raise || !n->hasParent())
+                return;
+            open_.push(entry_t(n->squared_distance, ni));
+            if (!isObstacle(n->parent)) {
+                n->clear();
+                n->raise = true;
+            }
+        });
+        v.raise = false;
+    }
+
+    /// spread the obstacle of a voxel to its neighbours as long as it is the closest one
+    inline void lower(const index_t &vi, const Voxel &v)
+    {
+        const index_t parent = v.parent;
+        visitNeighbours(vi, [this, &parent](const index_t &ni) {
+            const int dx = ni[0] - parent[0];
+            const int dy = ni[1] - parent[1];
+            const int dz = ni[2] - parent[2];
+            const int d  = dx * dx + dy * dy + dz * dz;
+            if (d > max_squared_distance_)
+                return;
+
+            Voxel *n = get(ni);
+            if (n && (n->raise || d >= n->squared_distance))
+                return;
+            if (!n)
+                n = &getAllocate(ni);
+
+            n->squared_distance = d;
+            n->parent           = parent;
+            open_.push(entry_t(d, ni));
+        });
+    }
+};
+
+namespace impl {
+/**
+ * @brief Number of voxels along a bundle edge, zero if the voxel size does not divide the bundle resolution,
+ *        as the voxels of neighbouring bundles would overlap or leave gaps then.
+ */
+inline int chunkStep(const double bundle_resolution,
+                     const double voxel_size)
+{
+    const double ratio      = bundle_resolution / voxel_size;
+    const double chunk_step = std::round(ratio);
+    return chunk_step >= 1.0 && std::abs(ratio - chunk_step) <= 1e-6 * ratio ? static_cast<int>(chunk_step) : 0;
+}
+
+/**
+ * @brief Re-evaluate the obstacle voxels within the given bundles and propagate the changes.
+ * @param sample    sample of a bundle at a point in world coordinates
+ */
+template<typename src_map_t, typename sample_t>
+inline void update(const src_map_t &src,
+                   const std::vector<typename src_map_t::index_t> &bundles,
+                   Esdf &dst,
+                   const sample_t &sample)
+{
+    using index_t = typename src_map_t::index_t;
+
+    const int chunk_step = chunkStep(src.getBundleResolution(), dst.getVoxelSize());
+    if (chunk_step == 0) {
+        std::cerr << "[Esdf]: voxel size " << dst.getVoxelSize() << " does not divide the bundle resolution "
+                  << src.getBundleResolution() << "\n";
+        return;
+    }
+    for (const index_t &bi : bundles) {
+        const typename src_map_t::distribution_bundle_t *b = src.get(bi);
+        const index_t v0 = {{bi[0] * chunk_step, bi[1] * chunk_step, bi[2] * chunk_step}};
+        for (int i = 0 ; i < chunk_step ; ++i) {
+            for (int j = 0 ; j < chunk_step ; ++j) {
+                for (int k = 0 ; k < chunk_step ; ++k) {
+                    const index_t vi = {{v0[0] + i, v0[1] + j, v0[2] + k}};
+                    dst.setObstacle(vi, b && sample(*b, dst.toPoint(vi)) >= dst.getThreshold());
+                }
+            }
+        }
+    }
+    dst.update();
+}
+
+template<typename src_map_t, typename sample_t>
+inline void from(src_map_t &src,
+                 Esdf::Ptr &dst,
+                 const double sampling_resolution,
+                 const double truncation_distance,
+                 const double threshold,
+                 const sample_t &sample)
+{
+    if (chunkStep(src.getBundleResolution(), sampling_resolution) == 0) {
+        std::cerr << "[Esdf]: sampling resolution " << sampling_resolution << " does not divide the bundle resolution "
+                  << src.getBundleResolution() << "\n";
+        dst.reset();
+        return;
+    }
+    src.allocatePartiallyAllocatedBundles();
+
+    dst.reset(new Esdf(src.getInitialOrigin(), sampling_resolution, truncation_distance, threshold));
+
+    std::vector<typename src_map_t::index_t> bundles;
+    src.getBundleIndices(bundles);
+    update(src, bundles, *dst, sample);
+    src.clearDirtyBundles();
+}
+
+/**
+ * @brief Whether an existing field was built with the given parameters, it has to be rebuilt otherwise.
+ */
+inline bool matches(const Esdf &dst,
+                    const double sampling_resolution,
+                    const double truncation_distance,
+                    const double threshold)
+{
+    return dst.getVoxelSize() == sampling_resolution &&
+           dst.getTruncationDistance() == truncation_distance &&
+           dst.getThreshold() == threshold;
+}
+
+/**
+ * @brief Only the bundles changed since the last conversion and their direct neighbours,
+ *        which share distributions with them, are evaluated again.
+ */
+template<typename src_map_t, typename sample_t>
+inline void update(src_map_t &src,
+                   Esdf &dst,
+                   const sample_t &sample)
+{
+    using index_t     = typename src_map_t::index_t;
+    using index_set_t = typename src_map_t::index_set_t;
+
+    const std::vector<index_t> dirty(src.getDirtyBundles().begin(), src.getDirtyBundles().end());
+    src.allocatePartiallyAllocatedBundles(dirty);
+
+    index_set_t affected;
+    for (const index_t &bi : dirty)
+        for (int dx = -1 ; dx <= 1 ; ++dx)
+            for (int dy = -1 ; dy <= 1 ; ++dy)
+                for (int dz = -1 ; dz <= 1 ; ++dz)
+                    affected.insert({{bi[0] + dx, bi[1] + dy, bi[2] + dz}});
+
+    update(src, std::vector<index_t>(affected.begin(), affected.end()), dst, sample);
+    src.clearDirtyBundles();
+}
+
+inline double sample(const cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t &b,
+                     const cslibs_math_3d::Point3d &p)
+{
+    double s = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i)
+        s += b.at(i)->data().sampleNonNormalized(p);
+    return 0.125 * s;
+}
+
+inline double sample(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t &b,
+                     const cslibs_math_3d::Point3d &p,
+                     const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model)
+{
+    double s = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i) {
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t *d = b.at(i);
+        if (d && d->getDistribution())
+            s += d->getDistribution()->sampleNonNormalized(p) * d->getOccupancy(inverse_model);
+    }
+    return 0.125 * s;
+}
+}
+
+/**
+ * @brief Build the distance field of a map from scratch.
+ * @param sampling_resolution   voxel size, has to divide the bundle resolution, dst is reset otherwise
+ * @param truncation_distance   maximum distance stored
+ * @param threshold             minimum sample of obstacle voxels
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
+        Esdf::Ptr &dst,
+        const double sampling_resolution,
+        const double truncation_distance = 2.0,
+        const double threshold           = 0.169)
+{
+    if (!src)
+        return;
+
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t;
+    impl::from(*src, dst, sampling_resolution, truncation_distance, threshold,
+               [](const bundle_t &b, const cslibs_math_3d::Point3d &p) { return impl::sample(b, p); });
+}
+
+/**
+ * @brief Incrementally update the distance field with the bundles changed since the last conversion,
+ *        e.g. after inserting a scan. Builds the field from scratch if dst is not set or was built
+ *        with different parameters.
+ */
+inline void update(
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
+        Esdf::Ptr &dst,
+        const double sampling_resolution,
+        const double truncation_distance = 2.0,
+        const double threshold           = 0.169)
+{
+    if (!src)
+        return;
+    if (!dst || !impl::matches(*dst, sampling_resolution, truncation_distance, threshold))
+        return from(src, dst, sampling_resolution, truncation_distance, threshold);
+
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t;
+    impl::update(*src, *dst,
+                 [](const bundle_t &b, const cslibs_math_3d::Point3d &p) { return impl::sample(b, p); });
+}
+
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        Esdf::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double truncation_distance = 2.0,
+        const double threshold           = 0.169)
+{
+    if (!src || !inverse_model)
+        return;
+
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t;
+    impl::from(*src, dst, sampling_resolution, truncation_distance, threshold,
+               [&inverse_model](const bundle_t &b, const cslibs_math_3d::Point3d &p) {
+        return impl::sample(b, p, inverse_model);
+    });
+}
+
+inline void update(
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        Esdf::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double truncation_distance = 2.0,
+        const double threshold           = 0.169)
+{
+    if (!src || !inverse_model)
+        return;
+    if (!dst || !impl::matches(*dst, sampling_resolution, truncation_distance, threshold))
+        return from(src, dst, sampling_resolution, inverse_model, truncation_distance, threshold);
+
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t;
+    impl::update(*src, *dst,
+                 [&inverse_model](const bundle_t &b, const cslibs_math_3d::Point3d &p) {
+        return impl::sample(b, p, inverse_model);
+    });
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_ESDF_HPP
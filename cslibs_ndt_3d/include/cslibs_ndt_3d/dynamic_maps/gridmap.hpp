@@ -5,6 +5,8 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 
@@ -13,6 +15,8 @@
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/common/unsaved_bundles.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -42,6 +46,7 @@ public:
     using transform_t                       = cslibs_math_3d::Transform3d;
     using point_t                           = cslibs_math_3d::Point3d;
     using index_t                           = std::array<int, 3>;
+    using index_set_t                       = std::unordered_set<index_t, cslibs_ndt::IndexHash<3>>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
     using distribution_t                    = cslibs_ndt::Distribution<3>;
@@ -108,7 +113,9 @@ public:
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[5])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[6])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[7]))}},
-        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_))
+        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_)),
+        dirty_bundles_(other.dirty_bundles_),
+        unsaved_bundles_(other.unsaved_bundles_)
     {
     }
 
@@ -121,7 +128,9 @@ public:
         min_index_(other.min_index_),
         max_index_(other.max_index_),
         storage_(other.storage_),
-        bundle_storage_(other.bundle_storage_)
+        bundle_storage_(other.bundle_storage_),
+        dirty_bundles_(std::move(other.dirty_bundles_)),
+        unsaved_bundles_(std::move(other.unsaved_bundles_))
     {
     }
 
@@ -178,6 +187,7 @@ public:
     {
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle = getAllocate(bi);
+        markDirty(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -192,6 +202,7 @@ public:
                        index_t &bi)
     {
         distribution_bundle_t *bundle = getAllocate(bi);
+        markDirty(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -224,6 +235,7 @@ public:
 
         storage.traverse([this](const index_t& bi, const distribution_t &d) {
             distribution_bundle_t *bundle = getAllocate(bi);
+            markDirty(bi);
             bundle->at(0)->data() += d.data();
             bundle->at(1)->data() += d.data();
             bundle->at(2)->data() += d.data();
@@ -272,6 +284,11 @@ public:
     }
 
 
+    inline const distribution_bundle_t* get(const index_t &bi) const
+    {
+        return bundle_storage_->get(bi);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_index_;
@@ -282,6 +299,21 @@ public:
         return max_index_;
     }
 
+    /**
+     * @brief Get the distributions of all layers overlapping a point without allocating,
+     *        missing distributions are set to nullptr. Safe for concurrent readers.
+     * @param p             the point
+     * @param distributions the overlapping distributions, one per layer
+     */
+    inline void getDistributions(const point_t &p,
+                                 std::array<const distribution_t*, 8> &distributions) const
+    {
+        const index_t bi = toBundleIndex(p);
+        const std::array<index_t, 8> indices = toStorageIndices(bi);
+        for(std::size_t i = 0 ; i < 8 ; ++i)
+            distributions[i] = storage_[i]->get(indices[i]);
+    }
+
     inline const distribution_bundle_t* getDistributionBundle(const point_t &p) const
     {
         const index_t bi = toBundleIndex(p);
@@ -375,11 +407,60 @@ public:
                 (i[2] >= min_index_[2]  && i[2] <= max_index_[2]);
     }
 
+    /**
+     * @brief Bundles allocated or updated since the last call of clearDirtyBundles().
+     *        Distributions are shared by neighbouring bundles, the samples of the
+     *        direct neighbours of a dirty bundle change as well.
+     */
+    inline const index_set_t& getDirtyBundles() const
+    {
+        return dirty_bundles_;
+    }
+
+    inline void clearDirtyBundles()
+    {
+        dirty_bundles_.clear();
+    }
+
+    /**
+     * @brief Bundles allocated or updated since a consumer saved the map, tracked independently of the
+     *        dirty bundles. Every consumer, e.g. a journal or an asynchronous saver, keeps its own revision.
+     * @param saved revision returned by the previous call of the consumer, 0 initially
+     * @param bis   changed bundles
+     * @return revision to pass to the next call, once the bundles are saved
+     */
+    inline uint64_t getUnsavedBundles(const uint64_t saved,
+                                      std::vector<index_t> &bis)
+    {
+        return unsaved_bundles_.get(saved, bis);
+    }
+
+    inline bool hasUnsavedBundles(const uint64_t saved = 0) const
+    {
+        return unsaved_bundles_.has(saved);
+    }
+
+    /**
+     * @brief Regard all bundles as saved by every consumer, e.g. after loading the map.
+     */
+    inline void clearUnsavedBundles()
+    {
+        unsaved_bundles_.clear();
+    }
+
     inline void allocatePartiallyAllocatedBundles()
     {
         std::vector<index_t> bis;
         getBundleIndices(bis);
+        allocatePartiallyAllocatedBundles(bis);
+    }
 
+    /**
+     * @brief Allocate the neighbours of the given bundles only.
+     * @param bis   bundle indices, e.g. the dirty bundles
+     */
+    inline void allocatePartiallyAllocatedBundles(const std::vector<index_t> &bis)
+    {
         using neighborhood_t = cis::operations::clustering::GridNeighborhoodStatic<std::tuple_size<index_t>::value, 3>;
         static constexpr neighborhood_t grid{};
 
@@ -403,6 +484,87 @@ public:
         }
     }
 
+    /**
+     * @brief Allocate the given bundles with the distributions of the given storages, e.g. map tiles
+     *        loaded from disk. Distributions already present are kept.
+     */
+    inline void insertBundles(const std::vector<index_t>            &bis,
+                              const distribution_storage_array_t    &storages)
+    {
+        for (std::size_t i = 0 ; i < storage_.size() ; ++i) {
+            const distribution_storage_ptr_t &s = storage_[i];
+            storages[i]->traverse([&s](const index_t &index, const distribution_t &d) {
+                if (!s->get(index))
+                    s->insert(index, d);
+            });
+        }
+        /// loaded bundles are on disk already, only bundles allocated before keep their unsaved state
+        for (const index_t &bi : bis) {
+            if (!bundle_storage_->get(bi)) {
+                getAllocate(bi);
+                unsaved_bundles_.erase(bi);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the given bundles and the distributions no remaining bundle refers to, e.g. to unload
+     *        map tiles. The storages are rebuilt from the remaining bundles.
+     */
+    inline void eraseBundles(const std::vector<index_t> &bis)
+    {
+        if (bis.empty())
+            return;
+
+        const index_set_t erased(bis.begin(), bis.end());
+        distribution_storage_array_t      storage;
+        distribution_bundle_storage_ptr_t bundle_storage(new distribution_bundle_storage_t);
+
+        using cell_index_map_t = std::unordered_map<const distribution_t*, index_t>;
+        std::array<cell_index_map_t, std::tuple_size<distribution_storage_array_t>::value> cell_indices;
+        for (std::size_t i = 0 ; i < storage_.size() ; ++i) {
+            storage[i].reset(new distribution_storage_t);
+            cell_index_map_t &c = cell_indices[i];
+            storage_[i]->traverse([&c](const index_t &index, const distribution_t &d) {
+                c[&d] = index;
+            });
+        }
+
+        const index_t min_index = min_index_;
+        const index_t max_index = max_index_;
+        min_index_.fill(std::numeric_limits<int>::max());
+        max_index_.fill(std::numeric_limits<int>::min());
+        bool remaining = false;
+        bundle_storage_->traverse([this, &erased, &storage, &bundle_storage, &cell_indices, &remaining]
+                                  (const index_t &bi, const distribution_bundle_t &b) {
+            if (erased.count(bi) > 0)
+                return;
+
+            distribution_bundle_t bundle;
+            for (std::size_t i = 0 ; i < storage.size() ; ++i) {
+                const index_t &index = cell_indices[i].at(b.at(i));
+                distribution_t *d = storage[i]->get(index);
+                bundle[i] = d ? d : &(storage[i]->insert(index, *(b.at(i))));
+            }
+            bundle_storage->insert(bi, bundle);
+            updateIndices(bi);
+            remaining = true;
+        });
+
+        /// the bounds of an emptied map are kept, so that its extent stays valid
+        if (!remaining) {
+            min_index_ = min_index;
+            max_index_ = max_index;
+        }
+
+        storage_        = storage;
+        bundle_storage_ = bundle_storage;
+        for (const index_t &bi : bis) {
+            dirty_bundles_.erase(bi);
+            unsaved_bundles_.erase(bi);
+        }
+    }
+
 protected:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -414,6 +576,8 @@ protected:
     mutable index_t                                 max_index_;
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
+    mutable index_set_t                             dirty_bundles_;
+    mutable cslibs_ndt::UnsavedBundles<3>           unsaved_bundles_;
 
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
@@ -428,34 +592,20 @@ protected:
             distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
             auto allocate_bundle = [this, &bi]() {
-                const int divx = cslibs_math::common::div<int>(bi[0], 2);
-                const int divy = cslibs_math::common::div<int>(bi[1], 2);
-                const int divz = cslibs_math::common::div<int>(bi[2], 2);
-                const int modx = cslibs_math::common::mod<int>(bi[0], 2);
-                const int mody = cslibs_math::common::mod<int>(bi[1], 2);
-                const int modz = cslibs_math::common::mod<int>(bi[2], 2);
-
-                const index_t storage_0_index = {{divx,        divy,        divz}};
-                const index_t storage_1_index = {{divx + modx, divy,        divz}};
-                const index_t storage_2_index = {{divx,        divy + mody, divz}};
-                const index_t storage_3_index = {{divx + modx, divy + mody, divz}};
-                const index_t storage_4_index = {{divx,        divy,        divz + modz}};
-                const index_t storage_5_index = {{divx + modx, divy,        divz + modz}};
-                const index_t storage_6_index = {{divx,        divy + mody, divz + modz}};
-                const index_t storage_7_index = {{divx + modx, divy + mody, divz + modz}};
-
+                const std::array<index_t, 8> indices = toStorageIndices(bi);
 
                 distribution_bundle_t b;
-                b[0] = getAllocate(storage_[0], storage_0_index);
-                b[1] = getAllocate(storage_[1], storage_1_index);
-                b[2] = getAllocate(storage_[2], storage_2_index);
-                b[3] = getAllocate(storage_[3], storage_3_index);
-                b[4] = getAllocate(storage_[4], storage_4_index);
-                b[5] = getAllocate(storage_[5], storage_5_index);
-                b[6] = getAllocate(storage_[6], storage_6_index);
-                b[7] = getAllocate(storage_[7], storage_7_index);
+                b[0] = getAllocate(storage_[0], indices[0]);
+                b[1] = getAllocate(storage_[1], indices[1]);
+                b[2] = getAllocate(storage_[2], indices[2]);
+                b[3] = getAllocate(storage_[3], indices[3]);
+                b[4] = getAllocate(storage_[4], indices[4]);
+                b[5] = getAllocate(storage_[5], indices[5]);
+                b[6] = getAllocate(storage_[6], indices[6]);
+                b[7] = getAllocate(storage_[7], indices[7]);
 
                 updateIndices(bi);
+                markDirty(bi);
                 return &(bundle_storage_->insert(bi, b));
             };
             return bundle ? bundle : allocate_bundle();
@@ -463,12 +613,37 @@ protected:
         return get_allocate(bi);
     }
 
+    inline void markDirty(const index_t &bi) const
+    {
+        dirty_bundles_.insert(bi);
+        unsaved_bundles_.mark(bi);
+    }
+
     inline void updateIndices(const index_t &chunk_index) const
     {
         min_index_ = std::min(min_index_, chunk_index);
         max_index_ = std::max(max_index_, chunk_index);
     }
 
+    inline std::array<index_t, 8> toStorageIndices(const index_t &bi) const
+    {
+        const int divx = cslibs_math::common::div<int>(bi[0], 2);
+        const int divy = cslibs_math::common::div<int>(bi[1], 2);
+        const int divz = cslibs_math::common::div<int>(bi[2], 2);
+        const int modx = cslibs_math::common::mod<int>(bi[0], 2);
+        const int mody = cslibs_math::common::mod<int>(bi[1], 2);
+        const int modz = cslibs_math::common::mod<int>(bi[2], 2);
+
+        return {{index_t{{divx,        divy,        divz}},
+                 index_t{{divx + modx, divy,        divz}},
+                 index_t{{divx,        divy + mody, divz}},
+                 index_t{{divx + modx, divy + mody, divz}},
+                 index_t{{divx,        divy,        divz + modz}},
+                 index_t{{divx + modx, divy,        divz + modz}},
+                 index_t{{divx,        divy + mody, divz + modz}},
+                 index_t{{divx + modx, divy + mody, divz + modz}}}};
+    }
+
     inline index_t toBundleIndex(const point_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w;
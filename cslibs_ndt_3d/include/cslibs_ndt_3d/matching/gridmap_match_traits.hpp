@@ -4,10 +4,12 @@
 #include <cslibs_ndt/matching/parameter.hpp>
 #include <cslibs_ndt_3d/static_maps/gridmap.hpp>
 #include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
-#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
 #include <cslibs_ndt_3d/matching/jacobian.hpp>
 #include <cslibs_ndt_3d/matching/hessian.hpp>
 
+#include <array>
+#include <vector>
+
 namespace cslibs_ndt {
 namespace matching {
 
@@ -41,6 +43,7 @@ struct MatchTraits<MapT, typename std::enable_if<IsGridmap<MapT>::value>::type>
     }
 
     static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
                                 const point_t& point,
                                 const Jacobian& J,
                                 const Hessian& H,
@@ -70,173 +73,182 @@ struct MatchTraits<MapT, typename std::enable_if<IsGridmap<MapT>::value>::type>
             // this part should be vectorized, may also remove common factors...
             for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
             {
-                const auto J_iq     = J.get(i, q);
+                const auto J_iq     = J.get(i, point_prime.data());
                 const auto J_info   = (info * J_iq).eval();
 
                 g(i) += s * q_info * J_iq;
 
                 for (std::size_t j = 0; j < LINEAR_DIMS + ANGULAR_DIMS; ++j)
                 {
-                    h(i, j) -= s * q_info * H.get(i, j, q) +
-                            s * static_cast<double>((J.get(j, q).transpose()).eval() * J_info) -
-                            s * (q_info * J_iq).eval() * (-q_info * J.get(j, q)).eval();
+                    h(i, j) -= s * q_info * H.get(i, j, point_prime.data()) +
+                            s * static_cast<double>((J.get(j, point_prime.data()).transpose()).eval() * J_info) -
+                            s * (q_info * J_iq).eval() * (-q_info * J.get(j, point_prime.data())).eval();
                 }
             }
-            std::cout << "hessian  : " << h << "\n";
-            std::cout << "sub score: " << s << "\n";
-
             score += s;
         }
     }
 
-    static void computeGradientComplete(const MapT& map,
-                                        const distribution_bundle_t& bundle,
-                                        const Jacobian& J,
-                                        const Hessian& H,
-                                        const transform_t &t,
-                                        double& score,
-                                        gradient_t& g,
-                                        hessian_t& h)
+    /**
+     * @brief Source distribution for distribution to distribution matching.
+     */
+    struct EIGEN_ALIGN16 SourceDistribution
     {
-        auto process_bundle = [&bundle, &J, &H, &t, &score, &g, &h](const index_t &, const distribution_bundle_t &b)
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Eigen::Vector3d mean;
+        Eigen::Matrix3d covariance;
+    };
+    using source_distributions_t = std::vector<SourceDistribution, Eigen::aligned_allocator<SourceDistribution>>;
+
+    /**
+     * @brief Source distribution under the current transform and the partials of mean
+     *        and covariance, computed once per source and iteration and shared by all
+     *        destination distributions associated to it.
+     */
+    struct EIGEN_ALIGN16 TransformedSourceDistribution
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Eigen::Vector3d                                 mean;
+        Eigen::Matrix3d                                 covariance;
+        std::array<Eigen::Vector3d, 6>                  dq;     /// first order partials of the mean
+        std::array<Eigen::Matrix3d, 3>                  dC;     /// first order angular partials of the covariance
+        std::array<std::array<Eigen::Vector3d, 3>, 3>   ddq;    /// second order angular partials of the mean
+        std::array<std::array<Eigen::Matrix3d, 3>, 3>   ddC;    /// second order angular partials of the covariance
+    };
+
+    static void getSourceDistributions(const MapT& map,
+                                       source_distributions_t& sources)
+    {
+        for (const auto& storage : map.getStorages())
         {
-            computeGradient(b.data(), bundle.data(), J, H, t, score, g, h);
-        };
-        map.traverse(process_bundle);
+            storage->traverse([&sources](const index_t&, const typename MapT::distribution_t& dw)
+            {
+                const auto& d = dw.data();
+                if (!d.valid())
+                    return;
+
+                SourceDistribution s;
+                s.mean       = d.getMean();
+                s.covariance = d.getCovariance();
+                sources.emplace_back(s);
+            });
+        }
     }
 
-    static void computeGradientLayerByLayer(const MapT& map,
-                                            const distribution_bundle_t& bundle,
+    static void transformSourceDistribution(const SourceDistribution& s,
                                             const Jacobian& J,
                                             const Hessian& H,
-                                            const transform_t &t,
-                                            double& score,
-                                            gradient_t& g,
-                                            hessian_t& h)
+                                            const transform_t& t,
+                                            TransformedSourceDistribution& ts)
     {
-        /// I.      : get the different distributions from the layers
-        const std::size_t size = distribution_bundle_t::size();
-        typename distribution_bundle_t::data_t bundle_map;
-
-        for(std::size_t i = 0 ; i < size ; ++i) {
-            const auto &d = bundle[i]->data();
-            auto* bm = map.getDistributionBundle(cslibs_math_3d::Point3d(d.getMean()));
-            if(!bm) {
-                bundle_map[i] = nullptr;
-            } else {
-                bundle_map[i] = (*bm)[i];
+        /// mean: R * m + t, covariance: R * C * R^T
+        const Eigen::Matrix3d& R = J.rotation();
+        ts.mean       = (t * point_t(s.mean)).data();
+        ts.covariance = R * s.covariance * R.transpose();
+
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            const Eigen::Matrix3d& dR_i = J.angular()[i];
+            const Eigen::Matrix3d  X    = dR_i * s.covariance * R.transpose();
+            ts.dq[i]     = Eigen::Vector3d::Unit(i);
+            ts.dq[i + 3] = dR_i * s.mean;
+            ts.dC[i]     = X + X.transpose();
+
+            for (std::size_t j = 0; j < 3; ++j)
+            {
+                const Eigen::Matrix3d& ddR_ij = H.angular()[i][j];
+                const Eigen::Matrix3d  Y      = ddR_ij * s.covariance * R.transpose() +
+                                                dR_i * s.covariance * J.angular()[j].transpose();
+                ts.ddq[i][j] = ddR_ij * s.mean;
+                ts.ddC[i][j] = Y + Y.transpose();
             }
         }
-        computeGradient(bundle_map, bundle.data(),
-                        J, H, t,
-                        score, g, h);
     }
 
+    /**
+     * @brief Accumulate score, gradient and hessian of a source distribution against all
+     *        destination distributions overlapping its transformed mean, one per layer.
+     *        The map is only read, therefore calls may run concurrently.
+     */
     static void computeGradient(const MapT& map,
-                                const distribution_bundle_t& bundle,
+                                const SourceDistribution& s,
                                 const Jacobian& J,
                                 const Hessian& H,
-                                const transform_t &t,
+                                const transform_t& t,
+                                TransformedSourceDistribution& ts,
                                 double& score,
                                 gradient_t& g,
                                 hessian_t& h)
     {
-        /// I.      : get mean of dstributions
-        Eigen::Vector3d mean = Eigen::Vector3d::Zero();
-        std::size_t     valid = 0;
-        for(const auto &dw : bundle) {
-            const auto &d = dw->data();
-            if(d.valid()) {
-                mean += d.getMean();
-                ++valid;
-            }
-        }
-        mean /= static_cast<double>(valid);
-
-        /// II.     : get a bundle from the map
+        std::array<const typename MapT::distribution_t*, 8> distributions;
+        map.getDistributions(t * point_t(s.mean), distributions);
 
-        auto* bundle_map = map.getDistributionBundle(cslibs_math_3d::Point3d(mean));
-        if (!bundle_map)
-            return;
+        bool transformed = false;
+        for (const auto* dw : distributions)
+        {
+            if (!dw || !dw->data().valid())
+                continue;
 
-        computeGradient(bundle_map->data(), bundle.data(),
-                        J, H, t,
-                        score, g, h);
+            if (!transformed)
+            {
+                transformSourceDistribution(s, J, H, t, ts);
+                transformed = true;
+            }
+            computeGradient(ts, dw->data(), score, g, h);
+        }
     }
 
-    static void computeGradient(const typename distribution_bundle_t::data_t& bundle_map,
-                                const typename distribution_bundle_t::data_t& bundle,
-                                const Jacobian& J,
-                                const Hessian& H,
-                                const transform_t &t,
+    static void computeGradient(const TransformedSourceDistribution& ts,
+                                const typename MapT::distribution_t::distribution_t& d_map,
                                 double& score,
                                 gradient_t& g,
                                 hessian_t& h)
     {
-        const std::size_t size = distribution_bundle_t::size();
-
-        /// III.    : calculate the score using both bundles
-        const auto R = J.rotation();
-        for(std::size_t i = 0 ; i < size ; ++i) {
-            if(!bundle_map[i])
-                continue;
-
-            auto& d = bundle[i]->data();
-            auto& d_map = bundle_map[i]->data();
-
-            if (!d.valid() || !d_map.valid())
-                continue;
-
-            const auto mean      = t * d.getMean();
-            const auto mean_map  = d_map.getMean();
-            const auto cov       = d.getCovariance();
-            const auto cov_map   = d_map.getCovariance();
-            const auto cov_rot   = (R.transpose() * cov * R).eval();
-            const auto B_inv     = (cov_rot + cov_map);
-
-            if(B_inv.determinant() == 0.0)
-                continue;
+        const Eigen::Matrix3d B_inv = ts.covariance + d_map.getCovariance();
+        if (B_inv.determinant() == 0.0)
+            return;
 
-            const auto B = B_inv.inverse();
-            const auto q = (mean - mean_map).eval();
-            const auto q_info = (q.transpose() * B).eval();
-            const auto e = static_cast<double>(q_info * q);
-            const auto d2 = 1.0; // 0.05;
-            const auto s = std::exp(-0.5 * d2 * e);
-            const auto Bq = (B * q).eval();
+        const Eigen::Matrix3d B  = B_inv.inverse();
+        const Eigen::Vector3d q  = ts.mean - d_map.getMean();
+        const Eigen::Vector3d Bq = B * q;
+        const double          s  = std::exp(-0.5 * q.dot(Bq));
+        if (!std::isnormal(s) || s <= 1e-5)
+            return;
 
-            if (!std::isnormal(s) || s <= 1e-5)
-                continue;
+        /// s = exp(-0.5 * q^T B q), a_i = q^T B dq_i - 0.5 * q^T B dC_i B q = -ds/dp_i / s
+        std::array<Eigen::Vector3d, 6> BJ;
+        std::array<Eigen::Vector3d, 6> dCBq;
+        gradient_t a;
+        for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
+        {
+            BJ[i]   = B * ts.dq[i];
+            dCBq[i] = i < 3 ? Eigen::Vector3d::Zero().eval() : (ts.dC[i - 3] * Bq).eval();
+            a(i)    = Bq.dot(ts.dq[i]) - 0.5 * Bq.dot(dCBq[i]);
+        }
 
-            // this part should be vectorized, may also remove common factors...
-            for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
+        for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
+        {
+            const Eigen::Vector3d BdCBq_i = B * dCBq[i];
+            for (std::size_t j = i; j < LINEAR_DIMS + ANGULAR_DIMS; ++j)
             {
-                const auto J_iq       = J.get(i, q);
-                const auto Z_i        = J.get(i, cov_rot);
-                const auto q_info_Z_i = q_info * Z_i;
-
-                g(i) += s * d2 * 0.5 * ((q_info * J_iq).value() - (q_info_Z_i * Bq).value());
-
-                for (std::size_t j = 0; j < LINEAR_DIMS + ANGULAR_DIMS; ++j)
-                {
-                    const auto H_ij = H.get(i,j,q);
-                    const auto Z_ij = H.get(i,j,cov_rot);
-                    const auto Z_j  = J.get(j,cov_rot);
-
-                    h(i, j) -= s * d2 * ((J_iq.transpose() * B * J_iq).value() -
-                                         (2.0 * q_info_Z_i * J_iq).value() +
-                                         (q_info * H_ij).value() -
-                                         (q_info_Z_i * B * Z_j * Bq).value() -
-                                         (0.5 * q_info * Z_ij * Bq).value() -
-                                         (d2 * 0.25 * e * e));
-                }
+                double da_ij = ts.dq[j].dot(BJ[i])
+                             - dCBq[j].dot(BJ[i])
+                             - BJ[j].dot(dCBq[i])
+                             + BdCBq_i.dot(dCBq[j]);
+                if (i >= 3 && j >= 3)
+                    da_ij += Bq.dot(ts.ddq[i - 3][j - 3]) - 0.5 * Bq.dot(ts.ddC[i - 3][j - 3] * Bq);
+
+                const double h_ij = s * (a(i) * a(j) - da_ij);
+                h(i, j) += h_ij;
+                if (i != j)
+                    h(j, i) += h_ij;
             }
-
-            std::cout << "hessian  : " << h << "\n";
-            std::cout << "sub score: " << s << "\n";
-
-            score += s;
         }
+
+        g     += s * a;
+        score += s;
     }
 };
 
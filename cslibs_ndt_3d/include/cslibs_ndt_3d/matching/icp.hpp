@@ -2,12 +2,94 @@
 #define CSLIBS_NDT_3D_ICP_HPP
 
 #include <cslibs_math_3d/linear/pointcloud.hpp>
+#include <cslibs_ndt/common/index_hash.hpp>
+#include <cslibs_ndt/common/parallel.hpp>
 #include <cslibs_ndt_3d/matching/icp_params.hpp>
 #include <cslibs_ndt_3d/matching/icp_result.hpp>
 
+#include <unordered_map>
+#include <vector>
+
 namespace cslibs_ndt_3d {
 namespace matching {
 namespace impl {
+/**
+ * @brief Hashed voxel index over a point cloud for fixed radius nearest neighbour queries.
+ *        The voxel size equals the maximum search distance, therefore only the 27 neighbouring
+ *        voxels of a query point have to be visited.
+ */
+class NearestNeighbourGrid {
+public:
+    using point_t  = cslibs_math_3d::Point3d;
+    using points_t = cslibs_math_3d::Pointcloud3d::points_t;
+    using index_t  = std::array<int, 3>;
+    using voxel_t  = std::vector<std::size_t>;
+    using grid_t   = std::unordered_map<index_t, voxel_t, cslibs_ndt::IndexHash<3>>;
+
+    inline NearestNeighbourGrid(const points_t &points,
+                                const double    max_distance) :
+        points_(points),
+        resolution_inv_(max_distance > 0.0 ? 1.0 / max_distance : 0.0),
+        max_distance2_(max_distance * max_distance)
+    {
+        if (max_distance <= 0.0)
+            return;
+
+        grid_.reserve(points.size());
+        for (std::size_t i = 0 ; i < points.size() ; ++i)
+            grid_[toIndex(points[i])].emplace_back(i);
+    }
+
+    /**
+     * @brief Find the closest point within the maximum search distance.
+     * @param p             the query point
+     * @param min_distance  squared distance to the closest point
+     * @return index of the closest point or std::numeric_limits<std::size_t>::max()
+     */
+    inline std::size_t nearest(const point_t &p,
+                               double        &min_distance) const
+    {
+        std::size_t index = std::numeric_limits<std::size_t>::max();
+        min_distance = std::numeric_limits<double>::max();
+        if (grid_.empty())
+            return index;
+
+        const index_t i = toIndex(p);
+        for (int dx = -1 ; dx <= 1 ; ++dx) {
+            for (int dy = -1 ; dy <= 1 ; ++dy) {
+                for (int dz = -1 ; dz <= 1 ; ++dz) {
+                    const auto it = grid_.find({{i[0] + dx, i[1] + dy, i[2] + dz}});
+                    if (it == grid_.end())
+                        continue;
+
+                    for (const std::size_t d : it->second) {
+                        const double dist = cslibs_math::linear::distance2(points_[d], p);
+                        if (dist < min_distance &&
+                                dist < max_distance2_) {
+                            index = d;
+                            min_distance = dist;
+                        }
+                    }
+                }
+            }
+        }
+        return index;
+    }
+
+private:
+    const points_t &points_;
+    const double    resolution_inv_;
+    const double    max_distance2_;
+    grid_t          grid_;
+
+    inline index_t toIndex(const point_t &p) const
+    {
+        return {{static_cast<int>(std::floor(p(0) * resolution_inv_)),
+                 static_cast<int>(std::floor(p(1) * resolution_inv_)),
+                 static_cast<int>(std::floor(p(2) * resolution_inv_))}};
+    }
+};
+
 struct icp {
 inline static void apply(const cslibs_math_3d::Pointcloud3d::ConstPtr &src,
                          const cslibs_math_3d::Pointcloud3d::ConstPtr &dst,
@@ -45,32 +127,52 @@ inline static void apply(const cslibs_math_3d::Pointcloud3d::ConstPtr &src,
     }
     dst_mean /= static_cast<double>(dst_size);
 
-    Eigen::Matrix3d &S = r.icpCovariance();
+    /// the destination cloud does not change, so it is indexed only once
+    const NearestNeighbourGrid dst_grid(dst_points, params.maxDistanceICP());
 
-    for(std::size_t i = 0 ; i < max_iterations ; ++i) {
-        std::fill(indices.begin(), indices.end(), std::numeric_limits<std::size_t>::max());
-        assigned = 0u;
+    /// per block sums, independent of the number of threads running them
+    static constexpr std::size_t POINTS_PER_BLOCK = 256;
+    const std::size_t num_blocks = (src_size + POINTS_PER_BLOCK - 1) / POINTS_PER_BLOCK;
+    cslibs_math_3d::Pointcloud3d::points_t  block_src_means(num_blocks);
+    std::vector<std::size_t>                block_assigned(num_blocks);
 
-        cslibs_math_3d::Point3d src_mean;
+    Eigen::Matrix3d &S = r.icpCovariance();
 
+    auto finish = [&r, &transform](const std::size_t iterations, const ICPTermination termination)
+    {
+        r.ICPTransform()   = transform;
+        r.icpIterations()  = iterations;
+        r.icpTermination() = termination;
+    };
+
+    for(std::size_t i = 0 ; i < max_iterations ; ++i) {
         /// associate
-        for(std::size_t s = 0 ; s < src_size ; ++s) {
-            cslibs_math_3d::Point3d &sp = src_points_transformed[s];
-            sp = transform * src_points[s];
-            std::size_t &index = indices[s];
-            src_mean += sp;
-
-            double      min_distance = std::numeric_limits<double>::max();
-            for(std::size_t d = 0 ; d < dst_size ; ++d) {
-                const cslibs_math_3d::Point3d &dp = dst_points[d];
-                const double dist = cslibs_math::linear::distance2(dp, sp);
-                if(dist < min_distance &&
-                        dist < max_distance) {
-                    index = d;
-                    min_distance = dist;
+        cslibs_ndt::parallel(num_blocks, 1, [&](const std::size_t blocks_begin, const std::size_t blocks_end)
+        {
+            for(std::size_t b = blocks_begin ; b < blocks_end ; ++b) {
+                cslibs_math_3d::Point3d &mean  = block_src_means[b];
+                std::size_t             &count = block_assigned[b];
+                mean  = cslibs_math_3d::Point3d();
+                count = 0u;
+
+                const std::size_t end = std::min((b + 1) * POINTS_PER_BLOCK, src_size);
+                for(std::size_t s = b * POINTS_PER_BLOCK ; s < end ; ++s) {
+                    cslibs_math_3d::Point3d &sp = src_points_transformed[s];
+                    sp = transform * src_points[s];
+                    mean += sp;
+
+                    double min_distance;
+                    indices[s] = dst_grid.nearest(sp, min_distance);
+                    count += min_distance < max_distance ? 1u : 0u;
                 }
             }
-            assigned += min_distance < max_distance ? 1u : 0u;
+        });
+
+        cslibs_math_3d::Point3d src_mean;
+        assigned = 0u;
+        for(std::size_t b = 0 ; b < num_blocks ; ++b) {
+            src_mean += block_src_means[b];
+            assigned += block_assigned[b];
         }
         src_mean /= static_cast<double>(src_size);
 
@@ -96,8 +198,7 @@ inline static void apply(const cslibs_math_3d::Pointcloud3d::ConstPtr &src,
 
         if(dt.translation().length2() < trans_eps ||
                 sq(q.angle(cslibs_math_3d::Quaternion())) < rot_eps) {
-            r.icpIterations()  = i;
-            r.icpTermination() = ICPTermination::DELTA_EPS;
+            finish(i, ICPTermination::DELTA_EPS);
             return;
         }
         if(static_cast<double>(assigned) / static_cast<double>(src_size)
@@ -108,8 +209,7 @@ inline static void apply(const cslibs_math_3d::Pointcloud3d::ConstPtr &src,
 
     }
 
-    r.icpIterations() = params.maxIterations();
-    r.icpTermination() = ICPTermination::MAX_ITERATIONS;
+    finish(max_iterations, ICPTermination::MAX_ITERATIONS);
 }
 };
 }
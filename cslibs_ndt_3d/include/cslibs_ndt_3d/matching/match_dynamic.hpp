@@ -48,40 +48,14 @@ inline void match(const cslibs_math_3d::Pointcloud3d::ConstPtr          &src,
                   const cslibs_math_3d::Transform3d                     &initial_transform,
                   cslibs_ndt_3d::matching::ResultWithICP                &r)
 {
-    using ndt_t         = cslibs_ndt_3d::dynamic_maps::Gridmap;
-    using voxel_grid_t  = cslibs_ndt::matching::VoxelGrid<3>;
-    using voxel_t       = cslibs_ndt::matching::Voxel<3>;
+    using ndt_t          = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using voxel_filter_t = cslibs_ndt::matching::VoxelFilter<3>;
 
-    auto create_voxeled_cloud = [resolution](const cslibs_math_3d::Pointcloud3d::ConstPtr &src)
-    {
-        const voxel_t::index_t min_index = voxel_t::getIndex(src->min(), resolution);
-        const voxel_t::index_t max_index = voxel_t::getIndex(src->max(), resolution);
-        const voxel_t::size_t  size      = {{static_cast<size_t>(max_index[0] - min_index[0] + 1),
-                                             static_cast<size_t>(max_index[1] - min_index[1] + 1),
-                                             static_cast<size_t>(max_index[2] - min_index[2] + 1)}};
-
-        voxel_grid_t::Ptr voxel_grid(new voxel_grid_t::type);
-        voxel_grid->set<cis::option::tags::array_offset>(min_index[0], min_index[1], min_index[2]);
-        voxel_grid->set<cis::option::tags::array_size>(size[0], size[1], size[2]);
-
-        const cslibs_math_3d::Pointcloud3d::points_t &pts = src->getPoints();
-        for(const auto &p : pts) {
-            voxel_grid->insert(voxel_t::getIndex(p, resolution), voxel_t(p));
-        }
-
-        cslibs_math_3d::Pointcloud3d::Ptr voxeled_cloud(new cslibs_math_3d::Pointcloud3d);
-        auto traverse = [&voxeled_cloud](const voxel_t::index_t, voxel_t &voxel )
-        {
-            voxeled_cloud->insert(voxel.mean());
-        };
-        voxel_grid->traverse(traverse);
-        return voxeled_cloud;
-
-    };
+    const voxel_filter_t voxel_filter(resolution);
 
     /// here we voxel the input clouds, to apply icp up front
-    cslibs_ndt_3d::matching::impl::icp::apply(create_voxeled_cloud(src),
-                                              create_voxeled_cloud(dst),
+    cslibs_ndt_3d::matching::impl::icp::apply(voxel_filter.apply(src),
+                                              voxel_filter.apply(dst),
                                               params,
                                               initial_transform,
                                               r);
@@ -28,6 +28,8 @@ struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value
     using point_t = cslibs_math_3d::Point3d;
     using transform_t = cslibs_math_3d::Transform3d;
     using parameter_t = cslibs_ndt::matching::OccupancyParameter;
+    using index_t     = typename MapT::index_t;
+    using mask_t      = typename parameter_t::occupancy_mask_t;
 
     static transform_t makeTransform(const Eigen::Vector3d& linear,
                                      const Eigen::Vector3d& angular)
@@ -37,8 +39,44 @@ struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value
                 angular.x(), angular.y(), angular.z()};
     }
 
+    /**
+     * @brief Classify the bundles touched by the initially transformed cloud once,
+     *        computeGradient then skips low occupancy bundles by a single lookup.
+     */
+    template<typename points_t>
+    static parameter_t prepare(const MapT& map,
+                               const points_t& points_prime,
+                               const parameter_t& param)
+    {
+        parameter_t prepared(param);
+        prepared.occupancyMask().reset();
+        if (param.occupancyThreshold() <= 0.0)
+            return prepared;
+
+        std::vector<index_t> indices;
+        indices.reserve(points_prime.size());
+        for (const point_t& p : points_prime)
+        {
+            index_t bi;
+            if (map.getBundleIndex(p, bi))
+                indices.emplace_back(bi);
+        }
+
+        auto occupancy = [&map, &param](const index_t& bi)
+        {
+            auto* bundle = map.getDistributionBundle(bi);
+            return bundle ? getOccupancy(*bundle, param) : 0.0;
+        };
+
+        std::shared_ptr<mask_t> mask(new mask_t);
+        if (mask->build(indices, occupancy, param.occupancyThreshold()))
+            prepared.occupancyMask() = mask;
+        return prepared;
+    }
+
     // todo: deduplicate code, make model configureable...
     static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
                                 const point_t& point,
                                 const Jacobian& J,
                                 const Hessian& H,
@@ -50,21 +88,24 @@ struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value
         static constexpr double d1 = 0.95;
         static constexpr double d2 = 1 - d1;
 
-        auto* bundle = map.getDistributionBundle(point);
-        if (!bundle)
+        index_t bi;
+        if (!map.getBundleIndex(point, bi))
             return;
 
-        // check occupancy value
-        if (param.occupancyThreshold() > 0.0)
-        {
-            double occupancy = 0.0;
-            for (auto* distribution_wrapper : *bundle)
-                occupancy += distribution_wrapper->getOccupancy(param.inverseModel());
-            occupancy /= 8.0;
+        // check occupancy value, only bundles missing in the mask are evaluated here
+        const std::uint8_t state = param.occupancyMask() ? param.occupancyMask()->get(bi)
+                                                         : static_cast<std::uint8_t>(mask_t::UNKNOWN);
+        if (state == mask_t::FREE)
+            return;
 
-            if (occupancy < param.occupancyThreshold())
-                return;
-        }
+        auto* bundle = map.getDistributionBundle(bi);
+        if (!bundle)
+            return;
+
+        if (state == mask_t::UNKNOWN &&
+                param.occupancyThreshold() > 0.0 &&
+                getOccupancy(*bundle, param) < param.occupancyThreshold())
+            return;
 
         for (auto* distribution_wrapper : *bundle)
         {
@@ -84,22 +125,33 @@ struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value
             // this part should be vectorized, may also remove common factors...
             for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
             {
-                const auto J_iq = J.get(i, q);
+                const auto J_iq = J.get(i, point_prime.data());
                 const auto J_info = (info * J_iq).eval();
 
                 g(i) += s * q_info * J_iq;
 
                 for (std::size_t j = 0; j < LINEAR_DIMS + ANGULAR_DIMS; ++j)
                 {
-                    h(i, j) -= s * q_info * H.get(i, j, q) +
-                               s * static_cast<double>((J.get(j, q).transpose()).eval() * J_info) -
-                               s * (q_info * J_iq).value() * (-q_info * J.get(j, q)).value();
+                    h(i, j) -= s * q_info * H.get(i, j, point_prime.data()) +
+                               s * static_cast<double>((J.get(j, point_prime.data()).transpose()).eval() * J_info) -
+                               s * (q_info * J_iq).value() * (-q_info * J.get(j, point_prime.data())).value();
                 }
             }
 
             score += s;
         }
     }
+
+private:
+    template<typename bundle_t>
+    static double getOccupancy(const bundle_t& bundle,
+                               const parameter_t& param)
+    {
+        double occupancy = 0.0;
+        for (auto* distribution_wrapper : bundle)
+            occupancy += distribution_wrapper->getOccupancy(param.inverseModel());
+        return occupancy / 8.0;
+    }
 };
 
 }
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cslibs_ndt/matching/match_traits.hpp>
+#include <cslibs_ndt/matching/parameter.hpp>
+#include <cslibs_ndt_3d/matching/gridmap_match_traits.hpp>
+#include <cslibs_ndt_3d/matching/jacobian.hpp>
+#include <cslibs_ndt_3d/matching/hessian.hpp>
+
+namespace cslibs_ndt {
+namespace matching {
+
+/**
+ * @brief Matching of 3d point clouds against 3d gridmaps constrained to SE(2).
+ *        Only x, y and yaw are estimated, z, roll and pitch are kept from the
+ *        initial transform. The partials are the {tx, ty, yaw} subset of the
+ *        full 3d Jacobian and Hessian, the solver works on a 3x3 system.
+ *
+ *        cslibs_ndt::matching::match<iterator_t, ndt_t, PlanarMatchTraits<ndt_t>>(...)
+ */
+template<typename MapT>
+struct PlanarMatchTraits<MapT, typename std::enable_if<IsGridmap<MapT>::value>::type>
+{
+    static constexpr int LINEAR_DIMS  = 2;
+    static constexpr int ANGULAR_DIMS = 1;
+
+    /// maps the planar partial index onto the partial index of the 3d derivatives
+    inline static std::size_t partial(const std::size_t i)
+    {
+        return i < 2 ? i : static_cast<std::size_t>(cslibs_ndt_3d::matching::Jacobian::yaw);
+    }
+
+    class EIGEN_ALIGN16 Jacobian {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        using point_t = Eigen::Vector3d;
+
+        inline const point_t get(const std::size_t pi,
+                                 const point_t &p) const
+        {
+            assert(pi < 3);
+            return jacobian_.get(partial(pi), p);
+        }
+
+        inline static void get(const Eigen::Matrix<double, 1, 1> &angular,
+                               Jacobian &j)
+        {
+            cslibs_ndt_3d::matching::Jacobian::get(Eigen::Vector3d(0.0, 0.0, angular(0)), j.jacobian_);
+        }
+
+    private:
+        cslibs_ndt_3d::matching::Jacobian jacobian_;
+    };
+
+    class EIGEN_ALIGN16 Hessian {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        using point_t = Eigen::Vector3d;
+
+        inline const point_t get(const std::size_t pi,
+                                 const std::size_t pj,
+                                 const point_t &p) const
+        {
+            assert(pi < 3);
+            assert(pj < 3);
+            return hessian_.get(partial(pi), partial(pj), p);
+        }
+
+        inline static void get(const Eigen::Matrix<double, 1, 1> &angular,
+                               Hessian &h)
+        {
+            cslibs_ndt_3d::matching::Hessian::get(Eigen::Vector3d(0.0, 0.0, angular(0)), h.hessian_);
+        }
+
+    private:
+        cslibs_ndt_3d::matching::Hessian hessian_;
+    };
+
+    using gradient_t            = Eigen::Matrix<double, 3, 1>;
+    using hessian_t             = Eigen::Matrix<double, 3, 3>;
+
+    using point_t               = cslibs_math_3d::Point3d;
+    using transform_t           = cslibs_math_3d::Transform3d;
+    using parameter_t           = cslibs_ndt::matching::Parameter;
+    using distribution_bundle_t = typename MapT::distribution_bundle_t;
+    using index_t               = typename MapT::index_t;
+
+    /// the estimate is applied on top of the initial transform, z, roll and pitch therefore stay untouched
+    static transform_t makeTransform(const Eigen::Vector2d& linear,
+                                     const Eigen::Matrix<double, 1, 1>& angular)
+    {
+        return transform_t{
+            linear.x(), linear.y(), 0.0,
+                    0.0, 0.0, angular(0)};
+    }
+
+    static void computeGradient(const MapT& map,
+                                const point_t& point_prime,
+                                const point_t& point,
+                                const Jacobian& J,
+                                const Hessian& H,
+                                const parameter_t& param,
+                                double& score,
+                                gradient_t& g,
+                                hessian_t& h)
+    {
+        auto* bundle = map.getDistributionBundle(point);
+        if (!bundle)
+            return;
+
+        for (auto* distribution_wrapper : *bundle)
+        {
+            auto& d = distribution_wrapper->data();
+            if (d.getN() < 4)
+                continue;
+
+            const auto info   = d.getInformationMatrix();
+            const auto q      = (point.data() - d.getMean()).eval();
+            const auto q_info = (q.transpose() * info).eval();
+            const auto e      = -0.5 * double(q_info * q);
+            const auto s      = std::exp(e);
+            if (!std::isnormal(s) || s <= 1e-5)
+                continue;
+
+            std::array<Eigen::Vector3d, 3> J_p;
+            for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
+                J_p[i] = J.get(i, point_prime.data());
+
+            for (std::size_t i = 0; i < LINEAR_DIMS + ANGULAR_DIMS; ++i)
+            {
+                const auto J_info   = (info * J_p[i]).eval();
+                const double q_J_i  = static_cast<double>(q_info * J_p[i]);
+
+                g(i) += s * q_J_i;
+
+                for (std::size_t j = 0; j < LINEAR_DIMS + ANGULAR_DIMS; ++j)
+                {
+                    h(i, j) -= s * static_cast<double>(q_info * H.get(i, j, point_prime.data())) +
+                            s * static_cast<double>(J_p[j].transpose() * J_info) -
+                            s * q_J_i * static_cast<double>(-q_info * J_p[j]);
+                }
+            }
+
+            score += s;
+        }
+    }
+};
+
+}
+}
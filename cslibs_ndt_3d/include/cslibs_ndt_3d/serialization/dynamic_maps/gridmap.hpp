@@ -3,8 +3,13 @@
 
 #include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
 
+#include <cslibs_ndt/serialization/async_saver.hpp>
+#include <cslibs_ndt/serialization/bundles.hpp>
 #include <cslibs_ndt/serialization/filesystem.hpp>
+#include <cslibs_ndt/serialization/lazy_map.hpp>
+#include <cslibs_ndt/serialization/shared_map.hpp>
 #include <cslibs_ndt/serialization/storage.hpp>
+#include <cslibs_ndt_3d/serialization/map_file.hpp>
 
 #include <cslibs_math_3d/serialization/transform.hpp>
 #include <cslibs_math/serialization/array.hpp>
@@ -17,8 +22,13 @@
 
 namespace cslibs_ndt_3d {
 namespace dynamic_maps {
+/**
+ * @brief Write the map into a directory, with compact set indices are written as Morton ordered
+ *        delta and varint streams and the bundle list is derived from the storages (see indices.hpp).
+ */
 inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map,
-                       const std::string &path)
+                       const std::string &path,
+                       const bool compact = false)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 8>;
@@ -44,17 +54,20 @@ inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map,
     /// step three: we have our filesystem, now we write out the distributions file by file
     /// meta file
     const path_t path_file = path_t("map.yaml");
+    std::vector<index_t> indices;
+    map->getBundleIndices(indices);
     {
         std::ofstream out((path_root / path_file).string(), std::fstream::trunc);
         YAML::Emitter yaml(out);
         YAML::Node n;
-        std::vector<index_t> indices;
-        map->getBundleIndices(indices);
         n["origin"]     = map->getInitialOrigin();
         n["resolution"] = map->getResolution();
         n["min_index"]  = map->getMinBundleIndex();
         n["max_index"]  = map->getMaxBundleIndex();
-        n["bundles"]    = indices;
+        if (compact)
+            n["encoding"] = "compact";
+        else
+            n["bundles"]  = indices;
         yaml << n;
     }
 
@@ -68,16 +81,18 @@ inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map,
                                   map->getStorages()[6],
                                   map->getStorages()[7]}};
 
+    std::array<std::vector<index_t>, 8> cells;
     std::array<std::thread, 8> threads;
     std::atomic_bool success(true);
     for (std::size_t i = 0 ; i < 8 ; ++i)
-        threads[i] = std::thread([&storages, &paths, i, &success](){
-            success = success && binary_t::save(storages[i], paths[i]);
+        threads[i] = std::thread([&storages, &paths, &cells, i, compact, &success](){
+            success = success && (compact ? binary_t::saveCompact(storages[i], paths[i], cells[i]) :
+                                            binary_t::save(storages[i], paths[i]));
         });
     for (std::size_t i = 0 ; i < 8 ; ++i)
         threads[i].join();
 
-    return success;
+    return success && (!compact || cslibs_ndt::serialization::indices::saveBundles<3>(cells, indices, path_root / path_t("bundles.bin")));
 }
 
 inline bool loadBinary(const std::string &path,
@@ -121,50 +136,26 @@ inline bool loadBinary(const std::string &path,
     const double                      resolution = n["resolution"].as<double>();
     const index_t                     min_index  = n["min_index"].as<index_t>();
     const index_t                     max_index  = n["max_index"].as<index_t>();
-    const std::vector<index_t>        indices    = n["bundles"].as<std::vector<index_t>>();
+    const bool                        compact    = n["encoding"] && n["encoding"].as<std::string>() == "compact";
+    std::vector<index_t>              indices    = compact ? std::vector<index_t>() : n["bundles"].as<std::vector<index_t>>();
 
+    std::array<std::vector<index_t>, 8> cells;
     std::array<std::thread, 8> threads;
     std::atomic_bool success(true);
     for (std::size_t i = 0 ; i < 8 ; ++i)
-        threads[i] = std::thread([&storages, &paths, i, &success](){
-            success = success && binary_t::load(paths[i], storages[i]);
+        threads[i] = std::thread([&storages, &paths, &cells, i, compact, &success](){
+            success = success && (compact ? binary_t::loadCompact(paths[i], storages[i], cells[i]) :
+                                            binary_t::load(paths[i], storages[i]));
         });
     for (std::size_t i = 0 ; i < 8 ; ++i)
         threads[i].join();
 
     if (!success)
         return false;
+    if (compact && !cslibs_ndt::serialization::indices::loadBundles<3>(path_root / path_t("bundles.bin"), cells, indices))
+        return false;
 
-    auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t b;
-        const int divx = cslibs_math::common::div<int>(bi[0], 2);
-        const int divy = cslibs_math::common::div<int>(bi[1], 2);
-        const int divz = cslibs_math::common::div<int>(bi[2], 2);
-        const int modx = cslibs_math::common::mod<int>(bi[0], 2);
-        const int mody = cslibs_math::common::mod<int>(bi[1], 2);
-        const int modz = cslibs_math::common::mod<int>(bi[2], 2);
-
-        const index_t storage_0_index = {{divx,        divy,        divz}};
-        const index_t storage_1_index = {{divx + modx, divy,        divz}};
-        const index_t storage_2_index = {{divx,        divy + mody, divz}};
-        const index_t storage_3_index = {{divx + modx, divy + mody, divz}};
-        const index_t storage_4_index = {{divx,        divy,        divz + modz}};
-        const index_t storage_5_index = {{divx + modx, divy,        divz + modz}};
-        const index_t storage_6_index = {{divx,        divy + mody, divz + modz}};
-        const index_t storage_7_index = {{divx + modx, divy + mody, divz + modz}};
-
-        b[0] = storages[0]->get(storage_0_index);
-        b[1] = storages[1]->get(storage_1_index);
-        b[2] = storages[2]->get(storage_2_index);
-        b[3] = storages[3]->get(storage_3_index);
-        b[4] = storages[4]->get(storage_4_index);
-        b[5] = storages[5]->get(storage_5_index);
-        b[6] = storages[6]->get(storage_6_index);
-        b[7] = storages[7]->get(storage_7_index);
-        bundles->insert(bi, b);
-    };
-    for (const index_t &index : indices)
-        allocate_bundle(index);
+    cslibs_ndt::serialization::allocateBundles<cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t>(indices, storages, *bundles);
 
     map.reset(new cslibs_ndt_3d::dynamic_maps::Gridmap(origin,
                                                        resolution,
@@ -175,6 +166,111 @@ inline bool loadBinary(const std::string &path,
 
     return true;
 }
+
+using GridmapLazy = cslibs_ndt::serialization::LazyMap<cslibs_ndt_3d::dynamic_maps::Gridmap,
+                                                       cslibs_ndt::binary<cslibs_ndt::Distribution, 3, 3>,
+                                                       3>;
+
+/**
+ * @brief Read only the meta data of a map written by saveBinary(), storages are read on first access
+ *        or in the background if prefetch is set, see LazyMap.
+ */
+inline bool loadBinaryLazy(const std::string &path,
+                           GridmapLazy::Ptr &map,
+                           const bool prefetch = false)
+{
+    using path_t  = boost::filesystem::path;
+    using index_t = cslibs_ndt_3d::dynamic_maps::Gridmap::index_t;
+
+    path_t path_root(path);
+    if (!cslibs_ndt::common::serialization::check_directory(path_root) ||
+            !cslibs_ndt::common::serialization::check_file(path_root / path_t("map.yaml")))
+        return false;
+
+    YAML::Node n = YAML::LoadFile((path_root / path_t("map.yaml")).string());
+    const bool compact = n["encoding"] && n["encoding"].as<std::string>() == "compact";
+    map = GridmapLazy::open(path_root,
+                            n["origin"].as<cslibs_math_3d::Transform3d>(),
+                            n["resolution"].as<double>(),
+                            n["min_index"].as<index_t>(),
+                            n["max_index"].as<index_t>(),
+                            compact,
+                            compact ? std::vector<index_t>() : n["bundles"].as<std::vector<index_t>>());
+    if (map && prefetch)
+        map->prefetch();
+    return static_cast<bool>(map);
+}
+
+using GridmapAsyncSaver = cslibs_ndt::serialization::AsyncSaver<cslibs_ndt_3d::dynamic_maps::Gridmap>;
+
+/**
+ * @brief Write a snapshot of the map by saveBinary() in a background thread, the map can be modified meanwhile.
+ */
+inline std::shared_future<bool> saveBinaryAsync(GridmapAsyncSaver &saver,
+                                                cslibs_ndt_3d::dynamic_maps::Gridmap &map,
+                                                const std::string &path,
+                                                const bool compact = false)
+{
+    return saver.save(map, [path, compact](const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &snapshot) {
+        return saveBinary(snapshot, path, compact);
+    });
+}
+
+/**
+ * @brief Write the map into a single file, which can be served memory mapped by mapped_maps::loadMapped().
+ */
+inline bool saveMapped(const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map,
+                       const std::string &path)
+{
+    if (!map)
+        return false;
+
+    return cslibs_ndt::serialization::map_file::save<3>(*map,
+                                                        cslibs_ndt::serialization::map_file::GRIDMAP,
+                                                        cslibs_ndt_3d::serialization::encodeOrigin(map->getInitialOrigin()),
+                                                        path);
+}
+
+/**
+ * @brief Publish the map into shared memory, replacing the version published before.
+ *        Other processes attach by mapped_maps::attachShared().
+ */
+inline bool publishShared(const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map,
+                          cslibs_ndt::serialization::shared_map::Publisher &publisher)
+{
+    if (!map)
+        return false;
+
+    return publisher.publish<3>(*map,
+                                cslibs_ndt::serialization::map_file::GRIDMAP,
+                                cslibs_ndt_3d::serialization::encodeOrigin(map->getInitialOrigin()));
+}
+
+/**
+ * @brief Decode a file written by saveMapped() into a dynamic map, e.g. to continue mapping.
+ */
+inline bool loadMapped(const std::string &path,
+                       cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &map)
+{
+    using map_t  = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using file_t = cslibs_ndt::serialization::map_file::MappedMap<3>;
+
+    const file_t::Ptr file = file_t::open(path, cslibs_ndt::serialization::map_file::GRIDMAP);
+    if (!file)
+        return false;
+
+    map_t::distribution_storage_array_t      storages;
+    map_t::distribution_bundle_storage_ptr_t bundles(new map_t::distribution_bundle_storage_t);
+    file->decode<map_t>(storages, bundles);
+
+    map.reset(new map_t(cslibs_ndt_3d::serialization::decodeOrigin(file->getHeader()),
+                        file->getHeader().resolution,
+                        file->getMinBundleIndex(),
+                        file->getMaxBundleIndex(),
+                        bundles,
+                        storages));
+    return true;
+}
 }
 }
 
@@ -0,0 +1,80 @@
+#ifndef CSLIBS_NDT_3D_SERIALIZATION_DYNAMIC_MAPS_JOURNAL_HPP
+#define CSLIBS_NDT_3D_SERIALIZATION_DYNAMIC_MAPS_JOURNAL_HPP
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/serialization/map_file.hpp>
+
+#include <cslibs_ndt/serialization/journal.hpp>
+
+namespace cslibs_ndt_3d {
+namespace dynamic_maps {
+using GridmapJournal          = cslibs_ndt::serialization::journal::Journal<Gridmap, 3>;
+using OccupancyGridmapJournal = cslibs_ndt::serialization::journal::Journal<OccupancyGridmap, 3>;
+
+/**
+ * @brief Start journaled saving of the map into a directory with an initial snapshot,
+ *        continued by journal->checkpoint(*map) and journal->compact(*map).
+ */
+inline bool createJournal(const Gridmap::Ptr &map,
+                          const std::string &path,
+                          GridmapJournal::Ptr &journal,
+                          const double compaction_ratio = 1.0)
+{
+    journal = map ? GridmapJournal::create(*map, serialization::encodeOrigin(map->getInitialOrigin()), path, compaction_ratio) :
+                    GridmapJournal::Ptr();
+    return static_cast<bool>(journal);
+}
+
+inline bool createJournal(const OccupancyGridmap::Ptr &map,
+                          const std::string &path,
+                          OccupancyGridmapJournal::Ptr &journal,
+                          const double compaction_ratio = 1.0)
+{
+    journal = map ? OccupancyGridmapJournal::create(*map, serialization::encodeOrigin(map->getInitialOrigin()), path, compaction_ratio) :
+                    OccupancyGridmapJournal::Ptr();
+    return static_cast<bool>(journal);
+}
+
+/**
+ * @brief Recover a journaled map from its snapshot and the checkpoints appended since, to continue mapping.
+ */
+inline bool openJournal(const std::string &path,
+                        Gridmap::Ptr &map,
+                        GridmapJournal::Ptr &journal,
+                        const double compaction_ratio = 1.0)
+{
+    journal = GridmapJournal::open(path, compaction_ratio);
+    if (!journal)
+        return false;
+
+    map.reset(new Gridmap(serialization::decodeOrigin(journal->getOrigin()), journal->getResolution()));
+    if (!journal->restore(*map)) {
+        map.reset();
+        journal.reset();
+        return false;
+    }
+    return true;
+}
+
+inline bool openJournal(const std::string &path,
+                        OccupancyGridmap::Ptr &map,
+                        OccupancyGridmapJournal::Ptr &journal,
+                        const double compaction_ratio = 1.0)
+{
+    journal = OccupancyGridmapJournal::open(path, compaction_ratio);
+    if (!journal)
+        return false;
+
+    map.reset(new OccupancyGridmap(serialization::decodeOrigin(journal->getOrigin()), journal->getResolution()));
+    if (!journal->restore(*map)) {
+        map.reset();
+        journal.reset();
+        return false;
+    }
+    return true;
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_SERIALIZATION_DYNAMIC_MAPS_JOURNAL_HPP
@@ -0,0 +1,29 @@
+#ifndef CSLIBS_NDT_3D_SERIALIZATION_MAP_FILE_HPP
+#define CSLIBS_NDT_3D_SERIALIZATION_MAP_FILE_HPP
+
+#include <cslibs_ndt/serialization/map_file.hpp>
+
+#include <cslibs_math_3d/linear/transform.hpp>
+
+namespace cslibs_ndt_3d {
+namespace serialization {
+inline std::array<double, 6> encodeOrigin(const cslibs_math_3d::Transform3d &origin)
+{
+    return {{origin.tx(), origin.ty(), origin.tz(), origin.roll(), origin.pitch(), origin.yaw()}};
+}
+
+inline cslibs_math_3d::Transform3d decodeOrigin(const cslibs_ndt::serialization::map_file::Header &header)
+{
+    return cslibs_math_3d::Transform3d(cslibs_math_3d::Vector3d(header.origin[0], header.origin[1], header.origin[2]),
+                                       cslibs_math_3d::Quaternion(header.origin[3], header.origin[4], header.origin[5]));
+}
+
+inline cslibs_math_3d::Transform3d decodeOrigin(const std::array<double, 6> &origin)
+{
+    return cslibs_math_3d::Transform3d(cslibs_math_3d::Vector3d(origin[0], origin[1], origin[2]),
+                                       cslibs_math_3d::Quaternion(origin[3], origin[4], origin[5]));
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_SERIALIZATION_MAP_FILE_HPP
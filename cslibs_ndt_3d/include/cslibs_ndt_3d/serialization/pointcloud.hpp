@@ -0,0 +1,48 @@
+#ifndef CSLIBS_NDT_3D_SERIALIZATION_POINTCLOUD_HPP
+#define CSLIBS_NDT_3D_SERIALIZATION_POINTCLOUD_HPP
+
+#include <cslibs_ndt/serialization/pointcloud.hpp>
+
+#include <cslibs_math_3d/linear/pose.hpp>
+#include <cslibs_math_3d/linear/point.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cslibs_ndt_3d {
+namespace serialization {
+using chunk_pose_t = std::function<cslibs_math_3d::Pose3d(const std::size_t chunk)>;
+
+/**
+ * @brief Insert a binary PLY, PCD or raw float32 point cloud file into a map chunk by chunk, so the
+ *        cloud is never held in memory as a whole, see cslibs_ndt::serialization::pointcloud. Points with
+ *        non-finite coordinates are skipped.
+ * @param map           map providing insert(points_begin, points_end, points_origin), e.g. a dynamic map
+ * @param chunk_size    number of points read and inserted at once
+ * @param poses         origin of every chunk, e.g. the sensor pose of every scan, identity if not set
+ * @return false if the file cannot be read completely, chunks read before are inserted
+ */
+template <typename map_t>
+inline bool insertPointcloud(const std::string &path,
+                             map_t &map,
+                             const std::size_t chunk_size = 1ul << 16,
+                             const chunk_pose_t &poses = chunk_pose_t())
+{
+    using point_t = cslibs_math_3d::Point3d;
+    using chunk_t = std::vector<cslibs_ndt::serialization::pointcloud::point_t>;
+
+    std::vector<point_t, Eigen::aligned_allocator<point_t>> points;
+    return cslibs_ndt::serialization::pointcloud::stream(path, chunk_size,
+                                                         [&map, &poses, &points](const chunk_t &chunk, const std::size_t i) {
+        points.clear();
+        for (const auto &p : chunk)
+            points.emplace_back(p[0], p[1], p[2]);
+        if (!points.empty())
+            map.insert(points.begin(), points.end(), poses ? poses(i) : cslibs_math_3d::Pose3d());
+    });
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_SERIALIZATION_POINTCLOUD_HPP
@@ -3,6 +3,7 @@
 
 #include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
 
+#include <cslibs_ndt/serialization/bundles.hpp>
 #include <cslibs_ndt/serialization/filesystem.hpp>
 #include <cslibs_ndt/serialization/storage.hpp>
 
@@ -17,8 +18,13 @@
 
 namespace cslibs_ndt_3d {
 namespace static_maps {
+/**
+ * @brief Write the map into a directory, with compact set indices are written as Morton ordered
+ *        delta and varint streams and the bundle list is derived from the storages (see indices.hpp).
+ */
 inline bool saveBinary(const cslibs_ndt_3d::static_maps::OccupancyGridmap::Ptr &map,
-                       const std::string &path)
+                       const std::string &path,
+                       const bool compact = false)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 8>;
@@ -44,17 +50,20 @@ inline bool saveBinary(const cslibs_ndt_3d::static_maps::OccupancyGridmap::Ptr &
     /// step three: we have our filesystem, now we write out the distributions file by file
     /// meta file
     const path_t path_file = path_t("map.yaml");
+    std::vector<index_t> indices;
+    map->getBundleIndices(indices);
     {
         std::ofstream out((path_root / path_file).string(), std::fstream::trunc);
         YAML::Emitter yaml(out);
         YAML::Node n;
-        std::vector<index_t> indices;
-        map->getBundleIndices(indices);
         n["origin"]     = map->getInitialOrigin();
         n["resolution"] = map->getResolution();
         n["size"]       = map->getSize();
         n["min_index"]  = map->getMinBundleIndex();
-        n["bundles"]    = indices;
+        if (compact)
+            n["encoding"] = "compact";
+        else
+            n["bundles"]  = indices;
         yaml << n;
     }
 
@@ -68,16 +77,18 @@ inline bool saveBinary(const cslibs_ndt_3d::static_maps::OccupancyGridmap::Ptr &
                                   map->getStorages()[6],
                                   map->getStorages()[7]}};
 
+    std::array<std::vector<index_t>, 8> cells;
     std::array<std::thread, 8> threads;
     std::atomic_bool success(true);
     for (std::size_t i = 0 ; i < 8 ; ++i)
-        threads[i] = std::thread([&storages, &paths, i, &success](){
-            success = success && binary_t::save(storages[i], paths[i]);
+        threads[i] = std::thread([&storages, &paths, &cells, i, compact, &success](){
+            success = success && (compact ? binary_t::saveCompact(storages[i], paths[i], cells[i]) :
+                                            binary_t::save(storages[i], paths[i]));
         });
     for (std::size_t i = 0 ; i < 8 ; ++i)
         threads[i].join();
 
-    return success;
+    return success && (!compact || cslibs_ndt::serialization::indices::saveBundles<3>(cells, indices, path_root / path_t("bundles.bin")));
 }
 
 inline bool loadBinary(const std::string &path,
@@ -121,20 +132,23 @@ inline bool loadBinary(const std::string &path,
     const cslibs_math_3d::Transform3d origin     = n["origin"].as<cslibs_math_3d::Transform3d>();
     const double                      resolution = n["resolution"].as<double>();
     const size_t                      size       = n["size"].as<size_t>();
-    const std::vector<index_t>        indices    = n["bundles"].as<std::vector<index_t>>();
+    const bool                        compact    = n["encoding"] && n["encoding"].as<std::string>() == "compact";
+    std::vector<index_t>              indices    = compact ? std::vector<index_t>() : n["bundles"].as<std::vector<index_t>>();
     const index_t                     min_index  = n["min_index"].as<index_t>();
 
     bundles->template set<cslibs_indexed_storage::option::tags::array_size>(size[0] * 2, size[1] * 2, size[2] * 2);
     bundles->template set<cslibs_indexed_storage::option::tags::array_offset>(min_index[0], min_index[1], min_index[2]);
 
+    std::array<std::vector<index_t>, 8> cells;
     std::array<std::thread, 8> threads;
     std::atomic_bool success(true);
     const index_t os = {{min_index[0] / 2, min_index[1] / 2, min_index[2] / 2}};
     for (std::size_t i = 0 ; i < 8 ; ++i) {
         const std::size_t off   = (i > 1ul) ? 1ul : 0ul;
         const size_t sz = {{size[0] + off, size[1] + off, size[2] + off}};
-        threads[i] = std::thread([&storages, &paths, i, &sz, &os, &success](){
-            success = success && binary_t::load(paths[i], storages[i], sz, os);
+        threads[i] = std::thread([&storages, &paths, &cells, i, sz, &os, compact, &success](){
+            success = success && (compact ? binary_t::loadCompact(paths[i], storages[i], sz, os, cells[i]) :
+                                            binary_t::load(paths[i], storages[i], sz, os));
         });
     }
     for (std::size_t i = 0 ; i < 8 ; ++i)
@@ -142,37 +156,10 @@ inline bool loadBinary(const std::string &path,
 
     if (!success)
         return false;
+    if (compact && !cslibs_ndt::serialization::indices::loadBundles<3>(path_root / path_t("bundles.bin"), cells, indices))
+        return false;
 
-    auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_3d::static_maps::OccupancyGridmap::distribution_bundle_t b;
-        const int divx = cslibs_math::common::div<int>(bi[0], 2);
-        const int divy = cslibs_math::common::div<int>(bi[1], 2);
-        const int divz = cslibs_math::common::div<int>(bi[2], 2);
-        const int modx = cslibs_math::common::mod<int>(bi[0], 2);
-        const int mody = cslibs_math::common::mod<int>(bi[1], 2);
-        const int modz = cslibs_math::common::mod<int>(bi[2], 2);
-
-        const index_t storage_0_index = {{divx,        divy,        divz}};
-        const index_t storage_1_index = {{divx + modx, divy,        divz}};
-        const index_t storage_2_index = {{divx,        divy + mody, divz}};
-        const index_t storage_3_index = {{divx + modx, divy + mody, divz}};
-        const index_t storage_4_index = {{divx,        divy,        divz + modz}};
-        const index_t storage_5_index = {{divx + modx, divy,        divz + modz}};
-        const index_t storage_6_index = {{divx,        divy + mody, divz + modz}};
-        const index_t storage_7_index = {{divx + modx, divy + mody, divz + modz}};
-
-        b[0] = storages[0]->get(storage_0_index);
-        b[1] = storages[1]->get(storage_1_index);
-        b[2] = storages[2]->get(storage_2_index);
-        b[3] = storages[3]->get(storage_3_index);
-        b[4] = storages[4]->get(storage_4_index);
-        b[5] = storages[5]->get(storage_5_index);
-        b[6] = storages[6]->get(storage_6_index);
-        b[7] = storages[7]->get(storage_7_index);
-        bundles->insert(bi, b);
-    };
-    for (const index_t &index : indices)
-        allocate_bundle(index);
+    cslibs_ndt::serialization::allocateBundles<cslibs_ndt_3d::static_maps::OccupancyGridmap::distribution_bundle_t>(indices, storages, *bundles);
 
     map.reset(new cslibs_ndt_3d::static_maps::OccupancyGridmap(origin,
                                                                resolution,
@@ -367,6 +367,25 @@ public:
         return valid(bi) ? getAllocate(bi) : nullptr;
     }
 
+    /**
+     * @brief Get the distributions of all layers overlapping a point without allocating,
+     *        missing distributions are set to nullptr. Safe for concurrent readers.
+     * @param p             the point
+     * @param distributions the overlapping distributions, one per layer
+     */
+    inline void getDistributions(const point_t &p,
+                                 std::array<const distribution_t*, 8> &distributions) const
+    {
+        index_t bi;
+        if(!toBundleIndex(p, bi)) {
+            distributions.fill(nullptr);
+            return;
+        }
+        const std::array<index_t, 8> indices = toStorageIndices(bi);
+        for(std::size_t i = 0 ; i < 8 ; ++i)
+            distributions[i] = storage_[i]->get(indices[i]);
+    }
+
     inline const distribution_bundle_t* getDistributionBundle(const point_t &p) const
     {
         index_t bi;
@@ -514,30 +533,16 @@ protected:
 
             auto allocate_bundle = [this, &bi]() {
                 distribution_bundle_t b;
-                const int divx = cslibs_math::common::div<int>(bi[0], 2);
-                const int divy = cslibs_math::common::div<int>(bi[1], 2);
-                const int divz = cslibs_math::common::div<int>(bi[2], 2);
-                const int modx = cslibs_math::common::mod<int>(bi[0], 2);
-                const int mody = cslibs_math::common::mod<int>(bi[1], 2);
-                const int modz = cslibs_math::common::mod<int>(bi[2], 2);
-
-                const index_t storage_0_index = {{divx,        divy,        divz}};
-                const index_t storage_1_index = {{divx + modx, divy,        divz}};
-                const index_t storage_2_index = {{divx,        divy + mody, divz}};
-                const index_t storage_3_index = {{divx + modx, divy + mody, divz}};
-                const index_t storage_4_index = {{divx,        divy,        divz + modz}};
-                const index_t storage_5_index = {{divx + modx, divy,        divz + modz}};
-                const index_t storage_6_index = {{divx,        divy + mody, divz + modz}};
-                const index_t storage_7_index = {{divx + modx, divy + mody, divz + modz}};
-
-                b[0] = getAllocate(storage_[0], storage_0_index);
-                b[1] = getAllocate(storage_[1], storage_1_index);
-                b[2] = getAllocate(storage_[2], storage_2_index);
-                b[3] = getAllocate(storage_[3], storage_3_index);
-                b[4] = getAllocate(storage_[4], storage_4_index);
-                b[5] = getAllocate(storage_[5], storage_5_index);
-                b[6] = getAllocate(storage_[6], storage_6_index);
-                b[7] = getAllocate(storage_[7], storage_7_index);
+                const std::array<index_t, 8> indices = toStorageIndices(bi);
+
+                b[0] = getAllocate(storage_[0], indices[0]);
+                b[1] = getAllocate(storage_[1], indices[1]);
+                b[2] = getAllocate(storage_[2], indices[2]);
+                b[3] = getAllocate(storage_[3], indices[3]);
+                b[4] = getAllocate(storage_[4], indices[4]);
+                b[5] = getAllocate(storage_[5], indices[5]);
+                b[6] = getAllocate(storage_[6], indices[6]);
+                b[7] = getAllocate(storage_[7], indices[7]);
 
                 return &(bundle_storage_->insert(bi, b));
             };
@@ -546,6 +551,25 @@ protected:
         return get_allocate(bi);
     }
 
+    inline std::array<index_t, 8> toStorageIndices(const index_t &bi) const
+    {
+        const int divx = cslibs_math::common::div<int>(bi[0], 2);
+        const int divy = cslibs_math::common::div<int>(bi[1], 2);
+        const int divz = cslibs_math::common::div<int>(bi[2], 2);
+        const int modx = cslibs_math::common::mod<int>(bi[0], 2);
+        const int mody = cslibs_math::common::mod<int>(bi[1], 2);
+        const int modz = cslibs_math::common::mod<int>(bi[2], 2);
+
+        return {{index_t{{divx,        divy,        divz}},
+                 index_t{{divx + modx, divy,        divz}},
+                 index_t{{divx,        divy + mody, divz}},
+                 index_t{{divx + modx, divy + mody, divz}},
+                 index_t{{divx,        divy,        divz + modz}},
+                 index_t{{divx + modx, divy,        divz + modz}},
+                 index_t{{divx,        divy + mody, divz + modz}},
+                 index_t{{divx + modx, divy + mody, divz + modz}}}};
+    }
+
     inline index_t toBundleIndex(const point_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w;
@@ -474,6 +474,16 @@ public:
         return valid(bi) ? getAllocate(bi) : nullptr;
     }
 
+    /**
+     * @brief Bundle index of a point given in world coordinates.
+     * @return false if the point lies outside of the map
+     */
+    inline bool getBundleIndex(const point_t &p,
+                               index_t &bi) const
+    {
+        return toBundleIndex(p, bi);
+    }
+
     inline const distribution_bundle_t* getDistributionBundle(const point_t &p) const
     {
         index_t bi;
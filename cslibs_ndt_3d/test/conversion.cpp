@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/conversion/esdf.hpp>
+
+#include <random>
+
+using map_t   = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using esdf_t  = cslibs_ndt_3d::conversion::Esdf;
+using point_t = cslibs_math_3d::Point3d;
+
+const double RESOLUTION          = 1.0;
+const double SAMPLING_RESOLUTION = 0.1;
+const double TRUNCATION_DISTANCE = 1.0;
+const double THRESHOLD           = 0.169;
+
+/// floor and two walls of a corridor
+void insertCorridor(const map_t::Ptr &map,
+                    const double x0,
+                    const double x1,
+                    const std::size_t n,
+                    std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> u(x0, x1);
+    std::uniform_real_distribution<double> v(0.0, 3.0);
+    std::normal_distribution<double>       noise(0.0, 0.05);
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        map->insert(point_t(u(rng), v(rng), noise(rng)));
+        map->insert(point_t(u(rng), noise(rng), v(rng)));
+        map->insert(point_t(u(rng), 3.0 + noise(rng), v(rng)));
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testEsdfIncremental)
+{
+    std::mt19937 rng(42);
+    map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    insertCorridor(map, 0.0, 6.0, 20000, rng);
+
+    esdf_t::Ptr incremental;
+    cslibs_ndt_3d::conversion::from(map, incremental, SAMPLING_RESOLUTION, TRUNCATION_DISTANCE, THRESHOLD);
+    ASSERT_NE(incremental, nullptr);
+    EXPECT_TRUE(map->getDirtyBundles().empty());
+
+    /// extend the corridor and update only the changed part
+    insertCorridor(map, 5.0, 8.0, 10000, rng);
+    EXPECT_FALSE(map->getDirtyBundles().empty());
+    const esdf_t *previous = incremental.get();
+    cslibs_ndt_3d::conversion::update(map, incremental, SAMPLING_RESOLUTION, TRUNCATION_DISTANCE, THRESHOLD);
+    EXPECT_EQ(incremental.get(), previous);
+    EXPECT_TRUE(map->getDirtyBundles().empty());
+
+    esdf_t::Ptr full;
+    cslibs_ndt_3d::conversion::from(map, full, SAMPLING_RESOLUTION, TRUNCATION_DISTANCE, THRESHOLD);
+    ASSERT_NE(full, nullptr);
+
+    std::uniform_real_distribution<double> x(-1.0, 9.0);
+    std::uniform_real_distribution<double> yz(-1.0, 4.0);
+    for (std::size_t i = 0 ; i < 10000 ; ++i) {
+        const point_t p(x(rng), yz(rng), yz(rng));
+        const double d = incremental->distance(p);
+        EXPECT_NEAR(d, full->distance(p), SAMPLING_RESOLUTION);
+        EXPECT_GE(d, 0.0);
+        EXPECT_LE(d, TRUNCATION_DISTANCE);
+    }
+
+    /// the floor is an obstacle, the center of the corridor is out of reach
+    EXPECT_LE(full->distance(point_t(3.05, 1.55, 0.05)), SAMPLING_RESOLUTION);
+    EXPECT_EQ(full->distance(point_t(3.05, 1.55, 1.55)), TRUNCATION_DISTANCE);
+}
+
+TEST(Test_cslibs_ndt_3d, testEsdfParameters)
+{
+    std::mt19937 rng(42);
+    map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    insertCorridor(map, 0.0, 6.0, 5000, rng);
+
+    /// voxels have to tile the bundles
+    esdf_t::Ptr esdf;
+    cslibs_ndt_3d::conversion::from(map, esdf, 0.3, TRUNCATION_DISTANCE, THRESHOLD);
+    EXPECT_EQ(esdf, nullptr);
+
+    cslibs_ndt_3d::conversion::from(map, esdf, SAMPLING_RESOLUTION, TRUNCATION_DISTANCE, THRESHOLD);
+    ASSERT_NE(esdf, nullptr);
+
+    /// changed parameters rebuild the field instead of being ignored
+    insertCorridor(map, 5.0, 8.0, 1000, rng);
+    cslibs_ndt_3d::conversion::update(map, esdf, 0.25, TRUNCATION_DISTANCE, 2.0 * THRESHOLD);
+    ASSERT_NE(esdf, nullptr);
+    EXPECT_EQ(esdf->getVoxelSize(), 0.25);
+    EXPECT_EQ(esdf->getThreshold(), 2.0 * THRESHOLD);
+    EXPECT_TRUE(map->getDirtyBundles().empty());
+}
+
+int main(int argc, char *argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
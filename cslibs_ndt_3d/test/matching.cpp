@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/matching/match.hpp>
+#include <cslibs_ndt/matching/matcher.hpp>
+#include <cslibs_ndt/matching/occupancy_mask.hpp>
+#include <cslibs_ndt_3d/matching/gridmap_match_traits.hpp>
+#include <cslibs_ndt_3d/matching/planar_gridmap_match_traits.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+
+#include <array>
+#include <random>
+
+using map_t       = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using point_t     = cslibs_math_3d::Point3d;
+using transform_t = cslibs_math_3d::Transform3d;
+using points_t    = std::vector<point_t>;
+
+/// counts the point evaluations of the optimizer
+struct CountingMatchTraits : public cslibs_ndt::matching::MatchTraits<map_t>
+{
+    using base_t = cslibs_ndt::matching::MatchTraits<map_t>;
+
+    static std::size_t evaluations;
+
+    static void computeGradient(const map_t& map,
+                                const point_t& point_prime,
+                                const point_t& point,
+                                const Jacobian& J,
+                                const Hessian& H,
+                                const parameter_t& param,
+                                double& score,
+                                gradient_t& g,
+                                hessian_t& h)
+    {
+        ++evaluations;
+        base_t::computeGradient(map, point_prime, point, J, H, param, score, g, h);
+    }
+};
+std::size_t CountingMatchTraits::evaluations = 0;
+
+/// floor and two walls of a 10 m x 10 m room, constrains all six degrees of freedom
+points_t sampleScene(const std::size_t num_points,
+                     const unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> side(0.0, 10.0);
+    std::uniform_real_distribution<double> height(0.0, 3.0);
+    std::normal_distribution<double>       noise(0.0, 0.02);
+
+    points_t points;
+    points.reserve(num_points);
+    for (std::size_t i = 0 ; i < num_points ; ++i) {
+        switch (i % 3) {
+        case 0:
+            points.emplace_back(point_t(side(rng), side(rng), noise(rng)));
+            break;
+        case 1:
+            points.emplace_back(point_t(noise(rng), side(rng), height(rng)));
+            break;
+        default:
+            points.emplace_back(point_t(side(rng), noise(rng), height(rng)));
+            break;
+        }
+    }
+    return points;
+}
+
+TEST(Test_cslibs_ndt_3d, benchmarkSubsampling)
+{
+    const points_t dst = sampleScene(30000, 0u);
+    const points_t src = sampleScene(30000, 1u);
+
+    map_t map(map_t::pose_t(), 1.0);
+    for (const point_t &p : dst)
+        map.insert(p);
+
+    const transform_t initial_transform(0.2, -0.15, 0.1, 0.02, -0.02, 0.05);
+
+    for (const double start : {1.0, 0.5, 0.25, 0.1}) {
+        cslibs_ndt::matching::Parameter param;
+        param.maxIterations()    = 100;
+        param.subsamplingStart() = start;
+
+        CountingMatchTraits::evaluations = 0;
+        const auto r = cslibs_ndt::matching::match<points_t::const_iterator, map_t, CountingMatchTraits>(
+                    src.begin(), src.end(), map, param, initial_transform);
+
+        /// both clouds sample the same scene, the ground truth is the identity
+        const transform_t &t = r.transform();
+        const double error_translation = std::max(std::abs(t.tx()), std::max(std::abs(t.ty()), std::abs(t.tz())));
+        const double error_rotation    = std::max(std::abs(t.roll()), std::max(std::abs(t.pitch()), std::abs(t.yaw())));
+
+        /// a subset is evaluated at least in the first iteration
+        if (start < 1.0)
+            EXPECT_LT(CountingMatchTraits::evaluations, (r.iterations() + 1) * src.size());
+
+        EXPECT_LT(error_translation, 0.05);
+        EXPECT_LT(error_rotation,    0.01);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testSubsamplingWithoutGrowth)
+{
+    const points_t dst = sampleScene(30000, 0u);
+    const points_t src = sampleScene(30000, 1u);
+
+    map_t map(map_t::pose_t(), 1.0);
+    for (const point_t &p : dst)
+        map.insert(p);
+
+    cslibs_ndt::matching::Parameter param;
+    param.maxIterations()     = 100;
+    param.subsamplingStart()  = 0.1;
+    param.subsamplingGrowth() = 1.0;
+
+    /// a fraction which does not grow disables subsampling, every iteration evaluates all points
+    CountingMatchTraits::evaluations = 0;
+    cslibs_ndt::matching::match<points_t::const_iterator, map_t, CountingMatchTraits>(
+                src.begin(), src.end(), map, param, transform_t(0.2, -0.15, 0.1, 0.02, -0.02, 0.05));
+    EXPECT_GT(CountingMatchTraits::evaluations, 0ul);
+    EXPECT_EQ(CountingMatchTraits::evaluations % src.size(), 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testStepPolicy)
+{
+    const points_t dst = sampleScene(30000, 0u);
+    const points_t src = sampleScene(30000, 1u);
+
+    map_t map(map_t::pose_t(), 1.0);
+    for (const point_t &p : dst)
+        map.insert(p);
+
+    const transform_t initial_transform(0.3, -0.25, 0.15, 0.03, -0.03, 0.08);
+
+    using policy_t = cslibs_ndt::matching::StepPolicy;
+    const std::array<policy_t, 3> policies = {{policy_t::HEURISTIC, policy_t::LEVENBERG_MARQUARDT, policy_t::MORE_THUENTE}};
+
+    std::array<cslibs_ndt::matching::Result<transform_t>, 3> results;
+    for (std::size_t i = 0 ; i < policies.size() ; ++i) {
+        cslibs_ndt::matching::Parameter param;
+        param.maxIterations() = 100;
+        param.stepPolicy()    = policies[i];
+
+        results[i] = cslibs_ndt::matching::match(src.begin(), src.end(), map, param, initial_transform);
+
+        const transform_t &t = results[i].transform();
+        const double error_translation = std::max(std::abs(t.tx()), std::max(std::abs(t.ty()), std::abs(t.tz())));
+        const double error_rotation    = std::max(std::abs(t.roll()), std::max(std::abs(t.pitch()), std::abs(t.yaw())));
+        EXPECT_LT(error_translation, 0.05);
+        EXPECT_LT(error_rotation,    0.01);
+    }
+
+    /// the line search converges in no more iterations than the fixed step to the same pose
+    const auto &fixed = results[0];
+    const auto &line  = results[2];
+    EXPECT_LE(line.iterations(), fixed.iterations());
+    EXPECT_NEAR(line.transform().tx(),    fixed.transform().tx(),    0.01);
+    EXPECT_NEAR(line.transform().ty(),    fixed.transform().ty(),    0.01);
+    EXPECT_NEAR(line.transform().tz(),    fixed.transform().tz(),    0.01);
+    EXPECT_NEAR(line.transform().roll(),  fixed.transform().roll(),  0.005);
+    EXPECT_NEAR(line.transform().pitch(), fixed.transform().pitch(), 0.005);
+    EXPECT_NEAR(line.transform().yaw(),   fixed.transform().yaw(),   0.005);
+}
+
+TEST(Test_cslibs_ndt_3d, testPlanarMatching)
+{
+    /// ground truth, z, roll and pitch are known and passed with the initial transform
+    const transform_t ground_truth(0.25, -0.2, 0.1, 0.02, -0.015, 0.06);
+    const transform_t initial_transform(0.0, 0.0, 0.1, 0.02, -0.015, 0.0);
+
+    const points_t dst = sampleScene(30000, 0u);
+    points_t src = sampleScene(30000, 1u);
+    const transform_t ground_truth_inverse = ground_truth.inverse();
+    for (point_t &p : src)
+        p = ground_truth_inverse * p;
+
+    map_t map(map_t::pose_t(), 1.0);
+    for (const point_t &p : dst)
+        map.insert(p);
+
+    cslibs_ndt::matching::Parameter param;
+    param.maxIterations() = 100;
+
+    using traits_t = cslibs_ndt::matching::PlanarMatchTraits<map_t>;
+    const auto r = cslibs_ndt::matching::match<points_t::const_iterator, map_t, traits_t>(
+                src.begin(), src.end(), map, param, initial_transform);
+
+    const transform_t &t = r.transform();
+    EXPECT_NEAR(t.tx(),  ground_truth.tx(),  0.05);
+    EXPECT_NEAR(t.ty(),  ground_truth.ty(),  0.05);
+    EXPECT_NEAR(t.yaw(), ground_truth.yaw(), 0.01);
+
+    /// the estimate is applied in the plane, the remaining degrees of freedom must not move
+    EXPECT_NEAR(t.tz(),    initial_transform.tz(),    1e-9);
+    EXPECT_NEAR(t.roll(),  initial_transform.roll(),  1e-9);
+    EXPECT_NEAR(t.pitch(), initial_transform.pitch(), 1e-9);
+}
+
+TEST(Test_cslibs_ndt_3d, testIncrementalMatcher)
+{
+    const points_t dst = sampleScene(30000, 0u);
+    points_t src = sampleScene(30000, 1u);
+
+    const transform_t ground_truth(0.2, -0.15, 0.1, 0.02, -0.02, 0.05);
+    const transform_t ground_truth_inverse = ground_truth.inverse();
+    for (point_t &p : src)
+        p = ground_truth_inverse * p;
+
+    cslibs_ndt::matching::Parameter param;
+    param.maxIterations() = 100;
+
+    map_t::Ptr map(new map_t(map_t::pose_t(), 1.0));
+    cslibs_ndt::matching::Matcher<map_t> matcher(param, map, true);
+    matcher.insert(dst.begin(), dst.end(), transform_t());
+
+    const point_t probe(5.0, 5.0, 0.0);
+    ASSERT_NE(map->getDistributionBundle(probe), nullptr);
+    const std::size_t n = map->getDistributionBundle(probe)->at(0)->data().getN();
+
+    const auto r = matcher.match(src.begin(), src.end());
+    ASSERT_EQ(r.termination(), cslibs_ndt::matching::Termination::DELTA_EPSILON);
+
+    const transform_t &t = r.transform();
+    EXPECT_NEAR(t.tx(),    ground_truth.tx(),    0.05);
+    EXPECT_NEAR(t.ty(),    ground_truth.ty(),    0.05);
+    EXPECT_NEAR(t.tz(),    ground_truth.tz(),    0.05);
+    EXPECT_NEAR(t.roll(),  ground_truth.roll(),  0.01);
+    EXPECT_NEAR(t.pitch(), ground_truth.pitch(), 0.01);
+    EXPECT_NEAR(t.yaw(),   ground_truth.yaw(),   0.01);
+    EXPECT_NEAR(matcher.getPose().tx(), t.tx(), 1e-9);
+
+    /// the converged scan is inserted at the estimated pose
+    EXPECT_GT(map->getDistributionBundle(probe)->at(0)->data().getN(), n);
+}
+
+TEST(Test_cslibs_ndt_3d, testOccupancyMask)
+{
+    using mask_t  = cslibs_ndt::matching::OccupancyMask<3>;
+    using index_t = mask_t::index_t;
+
+    /// far apart bundles, e.g. of outliers, are masked without covering the space in between
+    const std::vector<index_t> indices = {{{0, 0, 0}}, {{100000, -100000, 100000}}, {{0, 0, 0}}, {{1, 0, 0}}};
+    std::size_t evaluations = 0;
+    auto occupancy = [&evaluations](const index_t &bi) {
+        ++evaluations;
+        return bi[0] == 0 ? 0.1 : 0.9;
+    };
+
+    mask_t mask;
+    EXPECT_FALSE(mask.build(std::vector<index_t>(), occupancy, 0.5));
+    EXPECT_TRUE(mask.empty());
+
+    ASSERT_TRUE(mask.build(indices, occupancy, 0.5));
+    EXPECT_EQ(evaluations, 3ul);
+    EXPECT_EQ(mask.size(),  3ul);
+    EXPECT_EQ(mask.get(index_t{{0, 0, 0}}),                mask_t::FREE);
+    EXPECT_EQ(mask.get(index_t{{1, 0, 0}}),                mask_t::OCCUPIED);
+    EXPECT_EQ(mask.get(index_t{{100000, -100000, 100000}}), mask_t::OCCUPIED);
+    EXPECT_EQ(mask.get(index_t{{2, 0, 0}}),                mask_t::UNKNOWN);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
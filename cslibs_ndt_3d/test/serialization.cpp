@@ -4,12 +4,22 @@
 #include <cslibs_ndt_3d/serialization/dynamic_maps/occupancy_gridmap.hpp>
 #include <cslibs_ndt_3d/serialization/static_maps/gridmap.hpp>
 #include <cslibs_ndt_3d/serialization/static_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/serialization/dynamic_maps/journal.hpp>
+#include <cslibs_ndt_3d/serialization/dynamic_maps/tiles.hpp>
+#include <cslibs_ndt_3d/mapped_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/mapped_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/serialization/pointcloud.hpp>
 
 #include <cslibs_ndt_3d/conversion/gridmap.hpp>
 #include <cslibs_ndt_3d/conversion/occupancy_gridmap.hpp>
 
+#include <cslibs_ndt/serialization/storage.hpp>
+
 #include <cslibs_math/random/random.hpp>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <limits>
 
 const std::size_t MIN_NUM_SAMPLES = 10;
 const std::size_t MAX_NUM_SAMPLES = 100;
@@ -420,6 +430,500 @@ TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileBinarySerialization)
     testDynamicOccMap(map, map_from_file);
 }
 
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileLazySerialization)
+{
+    using map_t  = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    using lazy_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmapLazy;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+    auto count = [](const typename map_t::distribution_storage_ptr_t &storage) {
+        std::size_t n = 0;
+        storage->traverse([&n](const typename map_t::index_t &, const typename map_t::distribution_t &) { ++n; });
+        return n;
+    };
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveBinary(map, "/tmp/dynamic_occ_map_lazy_3d", true));
+
+    // from file, storages read in the background
+    typename lazy_t::Ptr lazy;
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::loadBinaryLazy("/tmp/dynamic_occ_map_lazy_3d", lazy, true));
+    for (std::size_t i = 0 ; i < lazy_t::NUM_STORAGES ; ++i) {
+        const typename map_t::distribution_storage_ptr_t storage = lazy->getStorage(i);
+        ASSERT_NE(storage, nullptr);
+        EXPECT_TRUE(lazy->isLoaded(i));
+        EXPECT_EQ(count(storage), count(map->getStorages()[i]));
+    }
+    testDynamicOccMap(map, lazy->getMap());
+
+    typename lazy_t::Ptr lazy_missing;
+    EXPECT_FALSE(cslibs_ndt_3d::dynamic_maps::loadBinaryLazy("/tmp/dynamic_occ_map_lazy_3d_missing", lazy_missing));
+}
+
+TEST(Test_cslibs_ndt_3d, testStorageFileBinarySerialization)
+{
+    using binary_t  = cslibs_ndt::binary<cslibs_ndt::Distribution, 3, 3>;
+    using storage_t = binary_t::kd_storage_t;
+    using index_t   = binary_t::index_t;
+    rng_t<1> rng_coord(-10.0, 10.0);
+
+    const int num_cells = 1 << 17;
+    std::shared_ptr<storage_t> storage(new storage_t);
+    for (int i = 0 ; i < num_cells ; ++ i) {
+        cslibs_ndt::Distribution<3> d;
+        for (int j = 0 ; j < i % 5 ; ++ j)
+            d.data().add(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()));
+        storage->insert({{i % 64, (i / 64) % 64, i / 4096}}, d);
+    }
+
+    // element wise, as written before the block writer
+    {
+        std::ofstream out("/tmp/storage_binary_3d_elementwise", std::ios::binary | std::ios::trunc);
+        storage->traverse([&out](const index_t &i, const cslibs_ndt::Distribution<3> &d) {
+            for (const int k : i)
+                cslibs_math::serialization::io<int>::write(k, out);
+            cslibs_ndt::write(d, out);
+        });
+    }
+
+    // to file
+    EXPECT_TRUE(binary_t::save(storage, "/tmp/storage_binary_3d"));
+
+    // from file
+    std::shared_ptr<storage_t> storage_from_file;
+    EXPECT_TRUE(binary_t::load("/tmp/storage_binary_3d", storage_from_file));
+
+    std::shared_ptr<storage_t> storage_elementwise;
+    EXPECT_TRUE(binary_t::load("/tmp/storage_binary_3d_elementwise", storage_elementwise));
+
+    // tests
+    std::size_t count = 0;
+    storage->traverse([&storage_from_file, &storage_elementwise, &count](const index_t &i, const cslibs_ndt::Distribution<3> &d) {
+        for (const std::shared_ptr<storage_t> &s : {storage_from_file, storage_elementwise}) {
+            const cslibs_ndt::Distribution<3> *l = s->get(i);
+            ASSERT_NE(l, nullptr);
+            EXPECT_EQ(d.data().getN(), l->data().getN());
+            for (std::size_t j = 0 ; j < 3 ; ++ j)
+                EXPECT_EQ(d.data().getMean()(j), l->data().getMean()(j));
+            for (std::size_t j = 0 ; j < 9 ; ++ j)
+                EXPECT_EQ(d.data().getCorrelated()(j), l->data().getCorrelated()(j));
+        }
+        ++ count;
+    });
+    EXPECT_EQ(count, static_cast<std::size_t>(num_cells));
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicGridmapParallelBundleAllocation)
+{
+    using map_t            = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using index_t          = map_t::index_t;
+    using bundle_t         = map_t::distribution_bundle_t;
+    using bundle_storage_t = map_t::distribution_bundle_storage_t;
+    rng_t<1> rng_coord(-20.0, 20.0);
+
+    const typename map_t::Ptr map(new map_t(cslibs_math_3d::Transform3d(), 1.0));
+    for (int i = 0 ; i < (1 << 17) ; ++ i)
+        map->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()));
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveBinary(map, "/tmp/dynamic_map_bundles_3d"));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_map_bundles_3d", map_from_file));
+    testDynamicMap(map, map_from_file);
+
+    // bundle reconstruction only, one by one as done before
+    std::vector<index_t> indices;
+    map_from_file->getBundleIndices(indices);
+    const map_t::distribution_storage_array_t &storages = map_from_file->getStorages();
+
+    bundle_storage_t bundles_serial;
+    for (const index_t &bi : indices) {
+        bundle_t b;
+        for (std::size_t j = 0 ; j < 8 ; ++ j)
+            b[j] = storages[j]->get(cslibs_ndt::serialization::indices::storageIndex<3>(bi, j));
+        bundles_serial.insert(bi, b);
+    }
+
+    bundle_storage_t bundles_parallel;
+    cslibs_ndt::serialization::allocateBundles<bundle_t>(indices, storages, bundles_parallel);
+
+    for (const index_t &bi : indices) {
+        const bundle_t *s = bundles_serial.get(bi);
+        const bundle_t *p = bundles_parallel.get(bi);
+        ASSERT_NE(p, nullptr);
+        for (std::size_t j = 0 ; j < 8 ; ++ j)
+            EXPECT_EQ(s->at(j), p->at(j));
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicGridmapFileMappedSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveMapped(map, "/tmp/dynamic_map_mapped_3d.bin"));
+
+    // from file, decoded
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::loadMapped("/tmp/dynamic_map_mapped_3d.bin", map_from_file));
+    testDynamicMap(map, map_from_file);
+
+    // from file, served in place
+    cslibs_ndt_3d::mapped_maps::Gridmap::Ptr map_mapped;
+    EXPECT_TRUE(cslibs_ndt_3d::mapped_maps::loadMapped("/tmp/dynamic_map_mapped_3d.bin", map_mapped));
+    ASSERT_NE(map_mapped, nullptr);
+    EXPECT_EQ(map->getMinBundleIndex(), map_mapped->getMinBundleIndex());
+    EXPECT_EQ(map->getMaxBundleIndex(), map_mapped->getMaxBundleIndex());
+    EXPECT_NEAR(map->getResolution(), map_mapped->getResolution(), 1e-9);
+
+    cslibs_ndt_3d::mapped_maps::OccupancyGridmap::Ptr map_wrong_type;
+    EXPECT_FALSE(cslibs_ndt_3d::mapped_maps::loadMapped("/tmp/dynamic_map_mapped_3d.bin", map_wrong_type));
+
+    using db_t = typename map_t::distribution_bundle_t;
+    map->traverse([&map, &map_mapped](const typename map_t::index_t &bi, const db_t &b) {
+        EXPECT_NE(map_mapped->getDistributionBundle(bi), nullptr);
+        const cslibs_math_3d::Point3d p(b.at(0)->data().getMean());
+        const double s = map->sample(p);
+        EXPECT_NEAR(s, map_mapped->sample(p), 1e-6 * std::max(1.0, s));
+        EXPECT_NEAR(map->sampleNonNormalized(p), map_mapped->sampleNonNormalized(p), 1e-6);
+    });
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileMappedSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveMapped(map, "/tmp/dynamic_occ_map_mapped_3d.bin"));
+
+    // from file, decoded
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::loadMapped("/tmp/dynamic_occ_map_mapped_3d.bin", map_from_file));
+    testDynamicOccMap(map, map_from_file);
+
+    // from file, served in place
+    cslibs_ndt_3d::mapped_maps::OccupancyGridmap::Ptr map_mapped;
+    EXPECT_TRUE(cslibs_ndt_3d::mapped_maps::loadMapped("/tmp/dynamic_occ_map_mapped_3d.bin", map_mapped));
+    ASSERT_NE(map_mapped, nullptr);
+
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    using db_t = typename map_t::distribution_bundle_t;
+    map->traverse([&map, &map_mapped, &ivm](const typename map_t::index_t &bi, const db_t &b) {
+        EXPECT_NE(map_mapped->getDistributionBundle(bi), nullptr);
+        for (std::size_t i = 0 ; i < db_t::size() ; ++ i) {
+            if (!b.at(i)->getDistribution())
+                continue;
+            const cslibs_math_3d::Point3d p(b.at(i)->getDistribution()->getMean());
+            const double s = map->sample(p, ivm);
+            EXPECT_NEAR(s, map_mapped->sample(p, ivm), 1e-6 * std::max(1.0, s));
+            EXPECT_NEAR(map->sampleNonNormalized(p, ivm), map_mapped->sampleNonNormalized(p, ivm), 1e-6);
+        }
+    });
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileTiledSerialization)
+{
+    using map_t   = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    using tiles_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmapTiles;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveTiled(map, "/tmp/dynamic_occ_map_tiled_3d", 4));
+
+    // from file, everything
+    typename map_t::Ptr map_from_file(new map_t(map->getInitialOrigin(), map->getResolution()));
+    typename tiles_t::Ptr tiles;
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::openTiled("/tmp/dynamic_occ_map_tiled_3d", *map_from_file, tiles));
+    EXPECT_GT(cslibs_ndt_3d::dynamic_maps::loadTiles(tiles, cslibs_math_3d::Point3d(-100.0, -100.0, -100.0), cslibs_math_3d::Point3d(100.0, 100.0, 100.0), *map_from_file), 0ul);
+    testDynamicOccMap(map, map_from_file);
+
+    // unload a part, only bundles of other tiles remain
+    const cslibs_math_3d::Point3d min = cslibs_math_3d::Point3d(-100.0, -100.0, -100.0);
+    const cslibs_math_3d::Point3d max = cslibs_math_3d::Point3d(0.0, 100.0, 100.0);
+    EXPECT_GT(cslibs_ndt_3d::dynamic_maps::unloadTiles(tiles, min, max, *map_from_file), 0ul);
+    const std::array<typename map_t::index_t, 2> box = cslibs_ndt_3d::dynamic_maps::toBundleBox(*map_from_file, min, max);
+    std::vector<typename map_t::index_t> unloaded = tiles->getTiles(box[0], box[1]);
+    std::vector<typename map_t::index_t> bis;
+    map_from_file->getBundleIndices(bis);
+    for (const typename map_t::index_t &bi : bis)
+        EXPECT_EQ(std::find(unloaded.begin(), unloaded.end(), tiles_t::toTileIndex(bi, tiles->getTileSize())), unloaded.end());
+
+    // reload asynchronously
+    cslibs_ndt_3d::dynamic_maps::prefetchTiles(tiles, min, max, *map_from_file).wait();
+    EXPECT_EQ(tiles->apply(*map_from_file), unloaded.size());
+    testDynamicOccMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileJournaledSerialization)
+{
+    using map_t     = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    using journal_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmapJournal;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // initial snapshot
+    typename journal_t::Ptr journal;
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::createJournal(map, "/tmp/dynamic_occ_map_journal_3d", journal, 1e3));
+    EXPECT_FALSE(map->hasUnsavedBundles(journal->getSavedRevision()));
+    EXPECT_EQ(journal->getJournalSize(), 0ul);
+
+    // checkpoints only append the changes
+    rng_t<1> rng_coord(-10.0, 10.0);
+    for (int i = 0 ; i < 3 ; ++ i) {
+        for (int j = 0 ; j < 100 ; ++ j)
+            map->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()),
+                        cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()));
+        EXPECT_TRUE(map->hasUnsavedBundles(journal->getSavedRevision()));
+        const std::size_t size = journal->getJournalSize();
+        EXPECT_TRUE(journal->checkpoint(*map));
+        EXPECT_GT(journal->getJournalSize(), size);
+        EXPECT_FALSE(map->hasUnsavedBundles(journal->getSavedRevision()));
+    }
+
+    // from snapshot and journal
+    typename map_t::Ptr map_from_file;
+    typename journal_t::Ptr journal_from_file;
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::openJournal("/tmp/dynamic_occ_map_journal_3d", map_from_file, journal_from_file));
+    EXPECT_EQ(journal_from_file->getJournalSize(), journal->getJournalSize());
+    testDynamicOccMap(map, map_from_file);
+
+    // from compacted snapshot
+    EXPECT_TRUE(journal->compact(*map));
+    EXPECT_EQ(journal->getJournalSize(), 0ul);
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::openJournal("/tmp/dynamic_occ_map_journal_3d", map_from_file, journal_from_file));
+    EXPECT_EQ(journal_from_file->getGeneration(), journal->getGeneration());
+    testDynamicOccMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileAsyncSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+    cslibs_ndt_3d::dynamic_maps::OccupancyGridmapAsyncSaver saver;
+
+    // the snapshot is written while the map is modified
+    std::shared_future<bool> result = cslibs_ndt_3d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_occ_map_async_3d");
+    rng_t<1> rng_coord(-10.0, 10.0);
+    for (int i = 0 ; i < 100 ; ++ i)
+        map->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()),
+                    cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()));
+    EXPECT_TRUE(result.get());
+
+    typename map_t::Ptr map_from_file;
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_occ_map_async_3d", map_from_file));
+    testDynamicOccMap(saver.getSnapshot(), map_from_file);
+
+    // the next snapshot takes over the changes only
+    EXPECT_TRUE(map->hasUnsavedBundles(saver.getSavedRevision()));
+    result = cslibs_ndt_3d::dynamic_maps::saveBinaryAsync(saver, *map, "/tmp/dynamic_occ_map_async_3d");
+    EXPECT_FALSE(map->hasUnsavedBundles(saver.getSavedRevision()));
+    EXPECT_TRUE(result.get());
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_occ_map_async_3d", map_from_file));
+    testDynamicOccMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapSharedSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // publish, starting over from versions left by previous runs
+    cslibs_ndt::serialization::shared_map::Publisher::unlink("/cslibs_ndt_3d_test_occ_map");
+    cslibs_ndt::serialization::shared_map::Publisher::Ptr publisher =
+            cslibs_ndt::serialization::shared_map::Publisher::create("/cslibs_ndt_3d_test_occ_map");
+    ASSERT_NE(publisher, nullptr);
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::publishShared(map, *publisher));
+    EXPECT_EQ(publisher->getVersion(), 1ul);
+
+    // attach, served in place
+    const cslibs_ndt::serialization::shared_map::Subscriber::Ptr subscriber =
+            cslibs_ndt::serialization::shared_map::Subscriber::open("/cslibs_ndt_3d_test_occ_map");
+    ASSERT_NE(subscriber, nullptr);
+    cslibs_ndt_3d::mapped_maps::OccupancyGridmap::Ptr map_shared;
+    uint64_t version = 0;
+    EXPECT_TRUE(cslibs_ndt_3d::mapped_maps::attachShared(*subscriber, map_shared, version));
+    ASSERT_NE(map_shared, nullptr);
+    EXPECT_EQ(version, publisher->getVersion());
+
+    // swap, the map attached before stays valid
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::publishShared(generateDynamicOccMap(), *publisher));
+    EXPECT_EQ(subscriber->getVersion(), version + 1);
+
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    using db_t = typename map_t::distribution_bundle_t;
+    map->traverse([&map, &map_shared, &ivm](const typename map_t::index_t &bi, const db_t &b) {
+        EXPECT_NE(map_shared->getDistributionBundle(bi), nullptr);
+        for (std::size_t i = 0 ; i < db_t::size() ; ++ i) {
+            if (!b.at(i)->getDistribution())
+                continue;
+            const cslibs_math_3d::Point3d p(b.at(i)->getDistribution()->getMean());
+            const double s = map->sample(p, ivm);
+            EXPECT_NEAR(s, map_shared->sample(p, ivm), 1e-6 * std::max(1.0, s));
+        }
+    });
+
+    cslibs_ndt_3d::mapped_maps::OccupancyGridmap::Ptr map_shared_next;
+    EXPECT_TRUE(cslibs_ndt_3d::mapped_maps::attachShared(*subscriber, map_shared_next, version));
+    EXPECT_EQ(version, 2ul);
+
+    publisher.reset();
+    cslibs_ndt::serialization::shared_map::Publisher::unlink("/cslibs_ndt_3d_test_occ_map");
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicGridmapPointcloudStreaming)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using cloud_point_t = std::array<float, 3>;
+    rng_t<1> rng_coord(-10.0, 10.0);
+
+    // two scans, the second one taken at pose
+    const std::size_t scan_size = 1000;
+    std::vector<cloud_point_t> points(2 * scan_size);
+    for (cloud_point_t &p : points)
+        p = {{static_cast<float>(rng_coord.get()), static_cast<float>(rng_coord.get()), static_cast<float>(rng_coord.get())}};
+    const cslibs_math_3d::Transform3d pose(cslibs_math_3d::Vector3d(1.0, 2.0, 3.0),
+                                           cslibs_math_3d::Quaternion(0.1, 0.2, 0.3));
+    auto poses = [&pose](const std::size_t chunk) {
+        return chunk == 0 ? cslibs_math_3d::Transform3d() : pose;
+    };
+
+    typename map_t::Ptr map(new map_t(cslibs_math_3d::Transform3d(), 1.0));
+    for (std::size_t i = 0 ; i < points.size() ; ++ i) {
+        const cslibs_math_3d::Point3d p(points[i][0], points[i][1], points[i][2]);
+        map->insert(i < scan_size ? p : pose * p);
+    }
+
+    const std::size_t size = points.size() * sizeof(cloud_point_t);
+    {
+        std::ofstream out("/tmp/pointcloud_3d.ply", std::ios::binary);
+        out << "ply\nformat binary_little_endian 1.0\nelement vertex " << points.size()
+            << "\nproperty float x\nproperty float y\nproperty float z\nend_header\n";
+        out.write(reinterpret_cast<const char*>(points.data()), size);
+    }
+    {
+        std::ofstream out("/tmp/pointcloud_3d.pcd", std::ios::binary);
+        out << "VERSION 0.7\nFIELDS x y z\nSIZE 4 4 4\nTYPE F F F\nCOUNT 1 1 1\nWIDTH " << points.size()
+            << "\nHEIGHT 1\nPOINTS " << points.size() << "\nDATA binary\n";
+        out.write(reinterpret_cast<const char*>(points.data()), size);
+    }
+    {
+        std::ofstream out("/tmp/pointcloud_3d.bin", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(points.data()), size);
+    }
+
+    for (const std::string path : {"/tmp/pointcloud_3d.ply", "/tmp/pointcloud_3d.pcd", "/tmp/pointcloud_3d.bin"}) {
+        typename map_t::Ptr map_streamed(new map_t(cslibs_math_3d::Transform3d(), 1.0));
+        EXPECT_TRUE(cslibs_ndt_3d::serialization::insertPointcloud(path, *map_streamed, scan_size, poses));
+        testDynamicMap(map, map_streamed);
+    }
+
+    typename map_t::Ptr map_missing(new map_t(cslibs_math_3d::Transform3d(), 1.0));
+    EXPECT_FALSE(cslibs_ndt_3d::serialization::insertPointcloud("/tmp/pointcloud_3d_missing.ply", *map_missing));
+
+    // invalid returns are skipped
+    std::vector<cloud_point_t> points_invalid = points;
+    points_invalid.push_back({{std::numeric_limits<float>::quiet_NaN(), 0.f, 0.f}});
+    points_invalid.push_back({{0.f, std::numeric_limits<float>::infinity(), 0.f}});
+    points_invalid.push_back({{0.f, 0.f, -std::numeric_limits<float>::infinity()}});
+    {
+        std::ofstream out("/tmp/pointcloud_3d_invalid.xyz", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(points_invalid.data()), points_invalid.size() * sizeof(cloud_point_t));
+    }
+    typename map_t::Ptr map_invalid(new map_t(cslibs_math_3d::Transform3d(), 1.0));
+    EXPECT_TRUE(cslibs_ndt_3d::serialization::insertPointcloud("/tmp/pointcloud_3d_invalid.xyz", *map_invalid, scan_size, poses));
+    testDynamicMap(map, map_invalid);
+
+    // raw files with other extensions have to be opened explicitly
+    {
+        std::ofstream out("/tmp/pointcloud_3d.raw", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(points.data()), size);
+    }
+    EXPECT_EQ(cslibs_ndt::serialization::pointcloud::Reader::open("/tmp/pointcloud_3d.raw"), nullptr);
+    const cslibs_ndt::serialization::pointcloud::Reader::Ptr reader =
+            cslibs_ndt::serialization::pointcloud::Reader::openRaw("/tmp/pointcloud_3d.raw");
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(reader->size(), points.size());
+}
+
+/// appends a value in the given byte order
+template <typename T>
+void writeValue(std::ostream &out,
+                const T value,
+                const bool big_endian)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    const uint16_t one = 1;
+    if (big_endian == (*reinterpret_cast<const uint8_t*>(&one) == 1))
+        std::reverse(bytes, bytes + sizeof(T));
+    out.write(bytes, sizeof(T));
+}
+
+TEST(Test_cslibs_ndt_3d, testPointcloudFormats)
+{
+    using reader_t      = cslibs_ndt::serialization::pointcloud::Reader;
+    using cloud_point_t = cslibs_ndt::serialization::pointcloud::point_t;
+
+    /// georeferenced coordinates, which float would round to decimeters, z is stored as integer
+    const std::vector<cloud_point_t> points = {{{5000000.123456, -4000000.654321,  250.0}},
+                                               {{-12.25,          7.5,             -3.0}},
+                                               {{4000000.5,       3.0,           1024.0}}};
+
+    auto read = [&points](const std::string &path) {
+        const reader_t::Ptr reader = reader_t::open(path);
+        ASSERT_NE(reader, nullptr);
+        ASSERT_EQ(reader->size(), points.size());
+
+        /// chunks do not divide the size
+        std::vector<cloud_point_t> read_points, chunk;
+        while (reader->read(chunk, 2))
+            read_points.insert(read_points.end(), chunk.begin(), chunk.end());
+        EXPECT_EQ(reader->remaining(), 0ul);
+        ASSERT_EQ(read_points.size(), points.size());
+        for (std::size_t i = 0 ; i < points.size() ; ++ i)
+            for (std::size_t j = 0 ; j < 3 ; ++ j)
+                EXPECT_EQ(read_points[i][j], points[i][j]);
+    };
+
+    /// big endian, properties around x, y and z and an element after the vertices
+    {
+        std::ofstream out("/tmp/pointcloud_formats_3d.ply", std::ios::binary);
+        out << "ply\nformat binary_big_endian 1.0\ncomment mixed types\nelement vertex " << points.size()
+            << "\nproperty uchar intensity\nproperty double x\nproperty short ring\nproperty double y"
+            << "\nproperty int z\nproperty float time\nelement face 1\nproperty list uchar int vertex_indices"
+            << "\nend_header\n";
+        for (const cloud_point_t &p : points) {
+            writeValue<uint8_t>(out, 200, true);
+            writeValue<double>(out, p[0], true);
+            writeValue<int16_t>(out, -7, true);
+            writeValue<double>(out, p[1], true);
+            writeValue<int32_t>(out, static_cast<int32_t>(p[2]), true);
+            writeValue<float>(out, 0.5f, true);
+        }
+        writeValue<uint8_t>(out, 3, true);
+        for (int32_t i = 0 ; i < 3 ; ++ i)
+            writeValue<int32_t>(out, i, true);
+    }
+    read("/tmp/pointcloud_formats_3d.ply");
+
+    /// fields with counts around x, y and z
+    {
+        std::ofstream out("/tmp/pointcloud_formats_3d.pcd", std::ios::binary);
+        out << "# .PCD v0.7\nVERSION 0.7\nFIELDS intensity x y z normal\nSIZE 2 8 8 2 4\nTYPE U F F I F"
+            << "\nCOUNT 1 1 1 1 3\nWIDTH " << points.size() << "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS "
+            << points.size() << "\nDATA binary\n";
+        for (const cloud_point_t &p : points) {
+            writeValue<uint16_t>(out, 1000, false);
+            writeValue<double>(out, p[0], false);
+            writeValue<double>(out, p[1], false);
+            writeValue<int16_t>(out, static_cast<int16_t>(p[2]), false);
+            for (std::size_t i = 0 ; i < 3 ; ++ i)
+                writeValue<float>(out, 1.0f, false);
+        }
+    }
+    read("/tmp/pointcloud_formats_3d.pcd");
+}
+
 TEST(Test_cslibs_ndt_3d, testStaticGridmapFileBinarySerialization)
 {
     using map_t = cslibs_ndt_3d::static_maps::Gridmap;
@@ -454,6 +958,74 @@ TEST(Test_cslibs_ndt_3d, testStaticOccupancyGridmapFileBinarySerialization)
     testStaticOccMap(map, map_from_file);
 }
 
+TEST(Test_cslibs_ndt_3d, testDynamicGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    const typename map_t::Ptr map = generateDynamicMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveBinary(map, "/tmp/dynamic_map_compact_3d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_map_compact_3d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testDynamicMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testDynamicOccupancyGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = generateDynamicOccMap();
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::dynamic_maps::saveBinary(map, "/tmp/dynamic_occ_map_compact_3d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_occ_map_compact_3d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testDynamicOccMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testStaticGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_3d::static_maps::Gridmap;
+    const typename map_t::Ptr map = cslibs_ndt_3d::conversion::from(generateDynamicMap());
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::static_maps::saveBinary(map, "/tmp/static_map_compact_3d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_3d::static_maps::loadBinary("/tmp/static_map_compact_3d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testStaticMap(map, map_from_file);
+}
+
+TEST(Test_cslibs_ndt_3d, testStaticOccupancyGridmapFileCompactSerialization)
+{
+    using map_t = cslibs_ndt_3d::static_maps::OccupancyGridmap;
+    const typename map_t::Ptr map = cslibs_ndt_3d::conversion::from(generateDynamicOccMap());
+
+    // to file
+    EXPECT_TRUE(cslibs_ndt_3d::static_maps::saveBinary(map, "/tmp/static_occ_map_compact_3d", true));
+
+    // from file
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_3d::static_maps::loadBinary("/tmp/static_occ_map_compact_3d", map_from_file);
+
+    // tests
+    EXPECT_TRUE(success);
+    testStaticOccMap(map, map_from_file);
+}
+
 int main(int argc, char *argv[])
 {
     testing::InitGoogleTest(&argc, argv);